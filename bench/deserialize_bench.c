@@ -0,0 +1,479 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deserialize/memory.h"
+#include "deserialize/obj.h"
+#include "deserialize/off.h"
+#include "deserialize/ply.h"
+#include "deserialize/stl.h"
+#include "parallel.h"
+#include "timer.h"
+
+#define DEFAULT_TRIANGLE_COUNT 1000000
+#define DEFAULT_REPETITIONS 3
+
+// Free space ensured before formatting, which is enough for every line of the generators
+#define BUFFER_PRINTF_RESERVE 256
+
+// Generated file content, null terminated like the buffers of file.c
+typedef struct Buffer {
+    char *items;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+// Height field over a grid of quads with 2 triangles each, the last row may be incomplete
+typedef struct Grid {
+    size_t triangle_count;
+    size_t columns;
+    size_t rows;
+} Grid;
+
+typedef void (*Generator)(const Grid *grid, Buffer *buffer);
+
+typedef struct Format {
+    const char *name;
+    Generator generate;
+    MemoryDeserializer deserialize;
+} Format;
+
+typedef struct Result {
+    double seconds;  // Fastest of all repetitions
+    size_t bytes;
+} Result;
+
+static Grid grid_create(size_t triangle_count);
+static size_t grid_vertex_count(const Grid *grid);
+static void grid_vertex(const Grid *grid, size_t index, float position[3]);
+static void grid_normal(const Grid *grid, size_t index, float normal[3]);
+static void grid_triangle(const Grid *grid, size_t triangle, uint32_t indices[3]);
+
+static void generate_stl_binary(const Grid *grid, Buffer *buffer);
+static void generate_stl_ascii(const Grid *grid, Buffer *buffer);
+static void generate_off(const Grid *grid, Buffer *buffer);
+static void generate_coff(const Grid *grid, Buffer *buffer);
+static void generate_noff(const Grid *grid, Buffer *buffer);
+static void generate_obj(const Grid *grid, Buffer *buffer);
+static void generate_obj_normals(const Grid *grid, Buffer *buffer);
+static void generate_ply_ascii(const Grid *grid, Buffer *buffer);
+static void generate_ply_little_endian(const Grid *grid, Buffer *buffer);
+static void generate_ply_big_endian(const Grid *grid, Buffer *buffer);
+static void generate_off_variant(const Grid *grid, const char *keyword, Buffer *buffer);
+static void generate_obj_variant(const Grid *grid, bool use_normals, Buffer *buffer);
+static void generate_ply_binary(const Grid *grid, bool big_endian, Buffer *buffer);
+
+static void buffer_reserve(Buffer *buffer, size_t additional);
+static void buffer_printf(Buffer *buffer, const char *format, ...);
+static void buffer_write_u32(Buffer *buffer, uint32_t value, bool big_endian);
+static void buffer_write_f32(Buffer *buffer, float value, bool big_endian);
+static void buffer_write_u8(Buffer *buffer, uint8_t value);
+
+static Result run(const Format *format, const Grid *grid, size_t repetitions);
+static size_t parse_count(const char *arg, const char *name);
+
+static const Format formats[] = {
+    {"stl_binary", generate_stl_binary, stl_deserialize},
+    {"stl_ascii", generate_stl_ascii, stl_deserialize},
+    {"off", generate_off, off_deserialize},
+    {"coff", generate_coff, off_deserialize},
+    {"noff", generate_noff, off_deserialize},
+    {"obj", generate_obj, obj_deserialize},
+    {"obj_normals", generate_obj_normals, obj_deserialize},
+    {"ply_ascii", generate_ply_ascii, ply_deserialize},
+    {"ply_binary_little_endian", generate_ply_little_endian, ply_deserialize},
+    {"ply_binary_big_endian", generate_ply_big_endian, ply_deserialize},
+};
+
+// Generate a synthetic mesh in every supported format and variant for each of the given triangle counts,
+// time the deserializer of the format on it and write the results as JSON to stdout.
+// Progress goes to stderr, so the JSON can be redirected into a file.
+int main(int argc, const char **argv) {
+    size_t job_count = 0;
+    size_t repetitions = DEFAULT_REPETITIONS;
+    size_t triangle_counts[argc];
+    size_t size_count = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            job_count = parse_count(argv[++i], "job count");
+        } else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--repetitions") == 0) && i + 1 < argc) {
+            repetitions = parse_count(argv[++i], "repetition count");
+        } else if (argv[i][0] != '-') {
+            triangle_counts[size_count++] = parse_count(argv[i], "triangle count");
+        } else {
+            fprintf(stderr, "[USAGE] %s [-j JOBS] [-r REPETITIONS] [TRIANGLE_COUNT ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!size_count) triangle_counts[size_count++] = DEFAULT_TRIANGLE_COUNT;
+
+    parallel_set_job_count(job_count);
+
+    printf("{\n");
+    printf("  \"jobs\": %zu,\n", parallel_get_job_count());
+    printf("  \"repetitions\": %zu,\n", repetitions);
+    printf("  \"results\": [");
+
+    size_t format_count = sizeof(formats) / sizeof(formats[0]);
+    for (size_t i_size = 0; i_size < size_count; ++i_size) {
+        Grid grid = grid_create(triangle_counts[i_size]);
+
+        for (size_t i_format = 0; i_format < format_count; ++i_format) {
+            const Format *format = &formats[i_format];
+            Result result = run(format, &grid, repetitions);
+
+            double megabytes_per_second = result.bytes / 1e6 / result.seconds;
+            double triangles_per_second = grid.triangle_count / result.seconds;
+            fprintf(stderr, "%-26s %12zu triangles %10.1f MB/s %14.0f triangles/s\n", format->name,
+                    grid.triangle_count, megabytes_per_second, triangles_per_second);
+
+            printf("%s\n    {\"format\": \"%s\", \"triangles\": %zu, \"bytes\": %zu, \"seconds\": %.6f, ",
+                   i_size || i_format ? "," : "", format->name, grid.triangle_count, result.bytes, result.seconds);
+            printf("\"megabytes_per_second\": %.3f, \"triangles_per_second\": %.0f}", megabytes_per_second,
+                   triangles_per_second);
+            fflush(stdout);
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
+
+// ****************************************************************************
+// Grid
+// ****************************************************************************
+
+Grid grid_create(size_t triangle_count) {
+    // Square grid, so the vertices of a triangle are close in memory for every format
+    size_t quad_count = (triangle_count + 1) / 2;
+    size_t columns = (size_t)ceil(sqrt((double)quad_count));
+    if (columns < 1) columns = 1;
+
+    return (Grid){
+        .triangle_count = triangle_count,
+        .columns = columns,
+        .rows = (quad_count + columns - 1) / columns,
+    };
+}
+
+size_t grid_vertex_count(const Grid *grid) { return (grid->columns + 1) * (grid->rows + 1); }
+
+void grid_vertex(const Grid *grid, size_t index, float position[3]) {
+    size_t column = index % (grid->columns + 1);
+    size_t row = index / (grid->columns + 1);
+
+    position[0] = 0.01f * column;
+    position[1] = 0.01f * row;
+    position[2] = 0.1f * sinf(0.05f * column) * cosf(0.05f * row);
+}
+
+void grid_normal(const Grid *grid, size_t index, float normal[3]) {
+    // The surface is flat enough, every normal points upwards
+    (void)grid;
+    (void)index;
+    normal[0] = 0.0f;
+    normal[1] = 0.0f;
+    normal[2] = 1.0f;
+}
+
+void grid_triangle(const Grid *grid, size_t triangle, uint32_t indices[3]) {
+    size_t quad = triangle / 2;
+    size_t column = quad % grid->columns;
+    size_t row = quad / grid->columns;
+
+    // Counter clockwise when looking from above
+    uint32_t bottom_left = row * (grid->columns + 1) + column;
+    uint32_t bottom_right = bottom_left + 1;
+    uint32_t top_left = bottom_left + grid->columns + 1;
+    uint32_t top_right = top_left + 1;
+
+    if (triangle % 2 == 0) {
+        indices[0] = bottom_left;
+        indices[1] = bottom_right;
+        indices[2] = top_right;
+    } else {
+        indices[0] = bottom_left;
+        indices[1] = top_right;
+        indices[2] = top_left;
+    }
+}
+
+// ****************************************************************************
+// Generators
+// ****************************************************************************
+
+void generate_stl_binary(const Grid *grid, Buffer *buffer) {
+    // The header must not start with "solid", which marks ascii files
+    buffer_reserve(buffer, 84 + 50 * grid->triangle_count);
+    memset(buffer->items, ' ', 80);
+    memcpy(buffer->items, "print3 deserialize_bench", 24);
+    buffer->length = 80;
+    buffer_write_u32(buffer, grid->triangle_count, false);
+
+    for (size_t i = 0; i < grid->triangle_count; ++i) {
+        uint32_t indices[3];
+        grid_triangle(grid, i, indices);
+
+        float normal[3];
+        grid_normal(grid, indices[0], normal);
+        for (size_t k = 0; k < 3; ++k) buffer_write_f32(buffer, normal[k], false);
+
+        for (size_t i_vertex = 0; i_vertex < 3; ++i_vertex) {
+            float position[3];
+            grid_vertex(grid, indices[i_vertex], position);
+            for (size_t k = 0; k < 3; ++k) buffer_write_f32(buffer, position[k], false);
+        }
+
+        buffer_write_u8(buffer, 0);
+        buffer_write_u8(buffer, 0);
+    }
+}
+
+void generate_stl_ascii(const Grid *grid, Buffer *buffer) {
+    buffer_printf(buffer, "solid deserialize_bench\n");
+
+    for (size_t i = 0; i < grid->triangle_count; ++i) {
+        uint32_t indices[3];
+        grid_triangle(grid, i, indices);
+
+        float n[3];
+        grid_normal(grid, indices[0], n);
+        buffer_printf(buffer, "facet normal %g %g %g\n outer loop\n", n[0], n[1], n[2]);
+
+        for (size_t i_vertex = 0; i_vertex < 3; ++i_vertex) {
+            float p[3];
+            grid_vertex(grid, indices[i_vertex], p);
+            buffer_printf(buffer, "  vertex %.6f %.6f %.6f\n", p[0], p[1], p[2]);
+        }
+
+        buffer_printf(buffer, " endloop\nendfacet\n");
+    }
+
+    buffer_printf(buffer, "endsolid deserialize_bench\n");
+}
+
+void generate_off(const Grid *grid, Buffer *buffer) { generate_off_variant(grid, "OFF", buffer); }
+
+void generate_coff(const Grid *grid, Buffer *buffer) { generate_off_variant(grid, "COFF", buffer); }
+
+void generate_noff(const Grid *grid, Buffer *buffer) { generate_off_variant(grid, "NOFF", buffer); }
+
+void generate_off_variant(const Grid *grid, const char *keyword, Buffer *buffer) {
+    bool use_colors = strchr(keyword, 'C') != NULL;
+    bool use_normals = strchr(keyword, 'N') != NULL;
+
+    size_t vertex_count = grid_vertex_count(grid);
+    buffer_printf(buffer, "%s\n%zu %zu 0\n", keyword, vertex_count, grid->triangle_count);
+
+    for (size_t i = 0; i < vertex_count; ++i) {
+        float p[3];
+        grid_vertex(grid, i, p);
+        buffer_printf(buffer, "%.6f %.6f %.6f", p[0], p[1], p[2]);
+
+        if (use_normals) {
+            float n[3];
+            grid_normal(grid, i, n);
+            buffer_printf(buffer, " %g %g %g", n[0], n[1], n[2]);
+        }
+
+        if (use_colors) {
+            buffer_printf(buffer, " %u %u %u 255", (unsigned)(i % 256), (unsigned)(i / 256 % 256), 128u);
+        }
+
+        buffer_printf(buffer, "\n");
+    }
+
+    for (size_t i = 0; i < grid->triangle_count; ++i) {
+        uint32_t t[3];
+        grid_triangle(grid, i, t);
+        buffer_printf(buffer, "3 %u %u %u\n", t[0], t[1], t[2]);
+    }
+}
+
+void generate_obj(const Grid *grid, Buffer *buffer) { generate_obj_variant(grid, false, buffer); }
+
+void generate_obj_normals(const Grid *grid, Buffer *buffer) { generate_obj_variant(grid, true, buffer); }
+
+void generate_obj_variant(const Grid *grid, bool use_normals, Buffer *buffer) {
+    size_t vertex_count = grid_vertex_count(grid);
+    buffer_printf(buffer, "# print3 deserialize_bench\n");
+
+    for (size_t i = 0; i < vertex_count; ++i) {
+        float p[3];
+        grid_vertex(grid, i, p);
+        buffer_printf(buffer, "v %.6f %.6f %.6f\n", p[0], p[1], p[2]);
+    }
+
+    if (use_normals) {
+        for (size_t i = 0; i < vertex_count; ++i) {
+            float n[3];
+            grid_normal(grid, i, n);
+            buffer_printf(buffer, "vn %g %g %g\n", n[0], n[1], n[2]);
+        }
+    }
+
+    // One based indices, the normal of a vertex has the same index
+    for (size_t i = 0; i < grid->triangle_count; ++i) {
+        uint32_t t[3];
+        grid_triangle(grid, i, t);
+        if (use_normals) {
+            buffer_printf(buffer, "f %u//%u %u//%u %u//%u\n", t[0] + 1, t[0] + 1, t[1] + 1, t[1] + 1, t[2] + 1,
+                          t[2] + 1);
+        } else {
+            buffer_printf(buffer, "f %u %u %u\n", t[0] + 1, t[1] + 1, t[2] + 1);
+        }
+    }
+}
+
+void generate_ply_ascii(const Grid *grid, Buffer *buffer) {
+    size_t vertex_count = grid_vertex_count(grid);
+    buffer_printf(buffer,
+                  "ply\nformat ascii 1.0\nelement vertex %zu\nproperty float x\nproperty float y\nproperty float z\n"
+                  "element face %zu\nproperty list uchar int vertex_indices\nend_header\n",
+                  vertex_count, grid->triangle_count);
+
+    for (size_t i = 0; i < vertex_count; ++i) {
+        float p[3];
+        grid_vertex(grid, i, p);
+        buffer_printf(buffer, "%.6f %.6f %.6f\n", p[0], p[1], p[2]);
+    }
+
+    for (size_t i = 0; i < grid->triangle_count; ++i) {
+        uint32_t t[3];
+        grid_triangle(grid, i, t);
+        buffer_printf(buffer, "3 %u %u %u\n", t[0], t[1], t[2]);
+    }
+}
+
+void generate_ply_little_endian(const Grid *grid, Buffer *buffer) { generate_ply_binary(grid, false, buffer); }
+
+void generate_ply_big_endian(const Grid *grid, Buffer *buffer) { generate_ply_binary(grid, true, buffer); }
+
+void generate_ply_binary(const Grid *grid, bool big_endian, Buffer *buffer) {
+    size_t vertex_count = grid_vertex_count(grid);
+    buffer_printf(buffer,
+                  "ply\nformat %s 1.0\nelement vertex %zu\nproperty float x\nproperty float y\nproperty float z\n"
+                  "element face %zu\nproperty list uchar int vertex_indices\nend_header\n",
+                  big_endian ? "binary_big_endian" : "binary_little_endian", vertex_count, grid->triangle_count);
+
+    buffer_reserve(buffer, 12 * vertex_count + 13 * grid->triangle_count);
+    for (size_t i = 0; i < vertex_count; ++i) {
+        float p[3];
+        grid_vertex(grid, i, p);
+        for (size_t k = 0; k < 3; ++k) buffer_write_f32(buffer, p[k], big_endian);
+    }
+
+    for (size_t i = 0; i < grid->triangle_count; ++i) {
+        uint32_t t[3];
+        grid_triangle(grid, i, t);
+        buffer_write_u8(buffer, 3);
+        for (size_t k = 0; k < 3; ++k) buffer_write_u32(buffer, t[k], big_endian);
+    }
+}
+
+// ****************************************************************************
+// Buffer
+// ****************************************************************************
+
+void buffer_reserve(Buffer *buffer, size_t additional) {
+    // Keep space for the null termination character
+    size_t required = buffer->length + additional + 1;
+    if (required <= buffer->capacity) return;
+
+    buffer->capacity = required > 2 * buffer->capacity ? required : 2 * buffer->capacity;
+    buffer->items = realloc(buffer->items, buffer->capacity);
+    if (!buffer->items) {
+        fprintf(stderr, "[ERR] Could not allocate a buffer of size %zu.\n", buffer->capacity);
+        exit(1);
+    }
+}
+
+void buffer_printf(Buffer *buffer, const char *format, ...) {
+    // Format into the free space and only grow and format again if it was too small
+    buffer_reserve(buffer, BUFFER_PRINTF_RESERVE);
+    size_t available = buffer->capacity - buffer->length;
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(&buffer->items[buffer->length], available, format, args);
+    va_end(args);
+
+    if ((size_t)n >= available) {
+        buffer_reserve(buffer, n);
+        va_start(args, format);
+        vsnprintf(&buffer->items[buffer->length], n + 1, format, args);
+        va_end(args);
+    }
+    buffer->length += n;
+}
+
+void buffer_write_u32(Buffer *buffer, uint32_t value, bool big_endian) {
+    buffer_reserve(buffer, 4);
+    for (size_t i = 0; i < 4; ++i) {
+        size_t shift = big_endian ? 8 * (3 - i) : 8 * i;
+        buffer->items[buffer->length++] = (char)(value >> shift);
+    }
+}
+
+void buffer_write_f32(Buffer *buffer, float value, bool big_endian) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    buffer_write_u32(buffer, bits, big_endian);
+}
+
+void buffer_write_u8(Buffer *buffer, uint8_t value) {
+    buffer_reserve(buffer, 1);
+    buffer->items[buffer->length++] = (char)value;
+}
+
+// ****************************************************************************
+// Measurement
+// ****************************************************************************
+
+Result run(const Format *format, const Grid *grid, size_t repetitions) {
+    Buffer buffer = {0};
+    format->generate(grid, &buffer);
+    buffer.items[buffer.length] = '\0';
+
+    Result result = {.seconds = INFINITY, .bytes = buffer.length};
+    for (size_t i = 0; i < repetitions; ++i) {
+        Scene scene = {0};
+
+        double start = timer_now();
+        format->deserialize(buffer.items, buffer.length, (Color){0, 121, 241, 255}, &scene, NULL);
+        double seconds = timer_now() - start;
+        if (seconds < result.seconds) result.seconds = seconds;
+
+        // A deserializer which drops triangles would look fast
+        size_t triangle_count = 0;
+        for (size_t i_obj = 0; i_obj < scene.objects.length; ++i_obj) {
+            triangle_count += object_triangle_count(scene.objects.items[i_obj]);
+        }
+        if (triangle_count != grid->triangle_count) {
+            fprintf(stderr, "[ERR] %s yields %zu triangles but %zu were generated.\n", format->name, triangle_count,
+                    grid->triangle_count);
+            exit(1);
+        }
+
+        scene_free_members(&scene);
+    }
+
+    free(buffer.items);
+    return result;
+}
+
+size_t parse_count(const char *arg, const char *name) {
+    char *peak;
+    long long count = strtoll(arg, &peak, 10);
+    if (peak == arg || *peak != '\0' || count < 1) {
+        fprintf(stderr, "[ERR] The %s must be a positive number. %s was given.\n", name, arg);
+        exit(1);
+    }
+
+    return count;
+}
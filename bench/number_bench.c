@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deserialize/number.h"
+#include "timer.h"
+
+#define REPETITIONS 10
+
+typedef float (*FloatParser)(const char *str, char **end);
+
+typedef struct ScanResult {
+    size_t count;
+    double sum;
+    double seconds;
+} ScanResult;
+
+static char *read_file(const char *filename, size_t *size);
+static ScanResult scan(const char *buffer, FloatParser parser);
+static size_t count_mismatches(const char *buffer);
+
+// Parse every number of the given text files with strtof and str_to_f32 and compare the throughput
+int main(int argc, const char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "[USAGE] %s FILE ...\n", argv[0]);
+        fprintf(stderr, "        e.g. %s examples/bottle.stl examples/cow.obj examples/ant.ply examples/box.off\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-32s %10s %14s %15s %8s %10s\n", "file", "numbers", "strtof MB/s", "str_to_f32 MB/s", "speedup", "mismatches");
+
+    for (int i = 1; i < argc; ++i) {
+        size_t size;
+        char *buffer = read_file(argv[i], &size);
+
+        ScanResult reference = scan(buffer, strtof);
+        ScanResult fast = scan(buffer, str_to_f32);
+
+        double megabytes = REPETITIONS * size / 1e6;
+        printf("%-32s %10zu %14.1f %15.1f %7.2fx %10zu\n", argv[i], reference.count, megabytes / reference.seconds,
+               megabytes / fast.seconds, reference.seconds / fast.seconds, count_mismatches(buffer));
+
+        free(buffer);
+    }
+
+    return 0;
+}
+
+char *read_file(const char *filename, size_t *size) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "[ERR] Could not open file \"%s\".\n", filename);
+        exit(1);
+    }
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *buffer = malloc(*size + 1);
+    if (!buffer || fread(buffer, 1, *size, fp) != *size) {
+        fprintf(stderr, "[ERR] Could not read the content of file \"%s\".\n", filename);
+        exit(1);
+    }
+    buffer[*size] = '\0';
+
+    fclose(fp);
+    return buffer;
+}
+
+ScanResult scan(const char *buffer, FloatParser parser) {
+    ScanResult result = {0};
+
+    double start = timer_now();
+    for (int repetition = 0; repetition < REPETITIONS; ++repetition) {
+        result.count = 0;
+
+        // Try to parse a number at every position, skip a character where there is none
+        const char *ptr = buffer;
+        while (*ptr) {
+            char *peak;
+            float value = parser(ptr, &peak);
+            if (peak == ptr) {
+                ++ptr;
+                continue;
+            }
+
+            result.sum += value;
+            result.count++;
+            ptr = peak;
+        }
+    }
+    result.seconds = timer_now() - start;
+
+    return result;
+}
+
+size_t count_mismatches(const char *buffer) {
+    size_t mismatches = 0;
+
+    const char *ptr = buffer;
+    while (*ptr) {
+        char *reference_peak;
+        char *fast_peak;
+        float reference = strtof(ptr, &reference_peak);
+        float fast = str_to_f32(ptr, &fast_peak);
+
+        if (reference_peak != fast_peak || memcmp(&reference, &fast, sizeof(float))) {
+            mismatches++;
+        }
+
+        ptr = reference_peak == ptr ? ptr + 1 : reference_peak;
+    }
+
+    return mismatches;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deserialize/stdin.h"
+#include "timer.h"
+
+#define DEFAULT_TRIANGLE_COUNT 1000000
+
+typedef struct Timing {
+    double write_seconds;
+    double read_seconds;
+    size_t bytes;
+} Timing;
+
+static float *generate_vertices(size_t triangle_count);
+static Timing run_text(const float *vertices, size_t triangle_count, Scene *scene);
+static Timing run_binary(const float *vertices, size_t triangle_count, Scene *scene);
+static void print_timing(const char *protocol, Timing timing, size_t triangle_count);
+
+// Send the same triangles through the text and the binary stdin protocol and compare the throughput.
+// A temporary file stands in for the pipe, the producer side is measured as well.
+int main(int argc, const char **argv) {
+    size_t triangle_count = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_TRIANGLE_COUNT;
+    if (!triangle_count) {
+        fprintf(stderr, "[USAGE] %s [TRIANGLE_COUNT]\n", argv[0]);
+        return 1;
+    }
+
+    float *vertices = generate_vertices(triangle_count);
+
+    Scene text_scene = {0};
+    Scene binary_scene = {0};
+    Timing text = run_text(vertices, triangle_count, &text_scene);
+    Timing binary = run_binary(vertices, triangle_count, &binary_scene);
+
+    printf("%-8s %12s %12s %14s %16s\n", "protocol", "size MB", "write s", "read s", "read tri/s");
+    print_timing("text", text, triangle_count);
+    print_timing("binary", binary, triangle_count);
+    printf("speedup of reading: %.2fx\n", text.read_seconds / binary.read_seconds);
+
+    // Both protocols must deliver the exact same floats
+    size_t size = 9 * triangle_count * sizeof(float);
+    bool equal = binary_scene.objects.items[0].vertices.length == 9 * triangle_count &&
+                 text_scene.objects.items[0].vertices.length == 9 * triangle_count &&
+                 memcmp(binary_scene.objects.items[0].vertices.items, vertices, size) == 0 &&
+                 memcmp(text_scene.objects.items[0].vertices.items, vertices, size) == 0;
+    printf("identical vertices: %s\n", equal ? "yes" : "no");
+
+    scene_free_members(&text_scene);
+    scene_free_members(&binary_scene);
+    free(vertices);
+
+    return equal ? 0 : 1;
+}
+
+float *generate_vertices(size_t triangle_count) {
+    float *vertices = malloc(9 * triangle_count * sizeof(float));
+    if (!vertices) {
+        fprintf(stderr, "[ERR] Could not allocate %zu triangles.\n", triangle_count);
+        exit(1);
+    }
+
+    // Fixed linear congruential generator, so every run sends the same numbers
+    unsigned long long state = 42;
+    for (size_t i = 0; i < 9 * triangle_count; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        vertices[i] = (float)(state >> 40) / (1 << 24) * 200.0f - 100.0f;
+    }
+
+    return vertices;
+}
+
+Timing run_text(const float *vertices, size_t triangle_count, Scene *scene) {
+    Timing timing = {0};
+
+    FILE *fp = tmpfile();
+    if (!fp) {
+        fprintf(stderr, "[ERR] Could not create a temporary file.\n");
+        exit(1);
+    }
+
+    // %.9g round trips every float
+    double start = timer_now();
+    fprintf(fp, "0 121 241 255\n");
+    for (size_t i = 0; i < triangle_count; ++i) {
+        const float *v = &vertices[9 * i];
+        fprintf(fp, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7],
+                v[8]);
+    }
+    fprintf(fp, "end\n");
+    fflush(fp);
+    timing.write_seconds = timer_now() - start;
+    timing.bytes = ftell(fp);
+
+    rewind(fp);
+    start = timer_now();
+    stdin_add_to_scene(fp, scene);
+    timing.read_seconds = timer_now() - start;
+
+    fclose(fp);
+    return timing;
+}
+
+Timing run_binary(const float *vertices, size_t triangle_count, Scene *scene) {
+    Timing timing = {0};
+
+    FILE *fp = tmpfile();
+    if (!fp) {
+        fprintf(stderr, "[ERR] Could not create a temporary file.\n");
+        exit(1);
+    }
+
+    // The benchmark runs on little endian hosts, so the floats are written as they are in memory
+    double start = timer_now();
+    unsigned char header[12] = {'P', '3', 'T', 'F', 0, 121, 241, 255};
+    for (size_t i = 0; i < 4; ++i) {
+        header[8 + i] = (triangle_count >> (8 * i)) & 0xff;
+    }
+    fwrite(header, 1, sizeof(header), fp);
+    fwrite(vertices, sizeof(float), 9 * triangle_count, fp);
+    fflush(fp);
+    timing.write_seconds = timer_now() - start;
+    timing.bytes = ftell(fp);
+
+    rewind(fp);
+    start = timer_now();
+    stdin_add_binary_to_scene(fp, scene);
+    timing.read_seconds = timer_now() - start;
+
+    fclose(fp);
+    return timing;
+}
+
+void print_timing(const char *protocol, Timing timing, size_t triangle_count) {
+    printf("%-8s %12.1f %12.3f %14.3f %16.0f\n", protocol, timing.bytes / 1e6, timing.write_seconds,
+           timing.read_seconds, triangle_count / timing.read_seconds);
+}
@@ -0,0 +1,87 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+
+#include "shm.h"
+#include "timer.h"
+
+#define RING_CAPACITY (1 << 24)
+#define GRID_SIZE 256  // Quads per side of one surface, every step emits 2 * GRID_SIZE^2 triangles
+#define DEFAULT_STEP_COUNT 100
+#define STEP_NANOSECONDS 20000000
+
+static void generate_surface(size_t step, float *vertices);
+static void add_quad(const float *corners, float *vertices);
+
+// Emit one surface of a travelling wave per step through the ring, like a solver would do after every time step.
+// Start it first, then run: print3 SHM:print3_example
+int main(int argc, const char **argv) {
+    const char *name = argc > 1 ? argv[1] : "print3_example";
+    size_t step_count = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_STEP_COUNT;
+
+    size_t triangle_count = 2 * GRID_SIZE * GRID_SIZE;
+    float *vertices = malloc(9 * triangle_count * sizeof(float));
+    if (!vertices) {
+        fprintf(stderr, "[ERR] Could not allocate %zu triangles.\n", triangle_count);
+        return 1;
+    }
+
+    ShmRing *ring = shm_ring_create(name, RING_CAPACITY);
+    printf("[INFO] Created the ring \"%s\", waiting for the viewer.\n", name);
+
+    double busy_seconds = 0.0;
+    size_t written = 0;
+    for (size_t step = 0; step < step_count; ++step) {
+        generate_surface(step, vertices);
+
+        double start = timer_now();
+        unsigned char color[4] = {step * 255 / step_count, 121, 241, 255};
+        if (!shm_ring_write_object(ring, vertices, triangle_count, color)) {
+            printf("[INFO] The viewer closed the ring.\n");
+            break;
+        }
+        busy_seconds += timer_now() - start;
+        written += triangle_count;
+
+        thrd_sleep(&(struct timespec){.tv_nsec = STEP_NANOSECONDS}, NULL);
+    }
+
+    printf("[INFO] Wrote %zu triangles, %.0f triangles/s while writing.\n", written, written / busy_seconds);
+
+    shm_ring_close(ring);
+    shm_ring_free(ring);
+    free(vertices);
+
+    return 0;
+}
+
+void generate_surface(size_t step, float *vertices) {
+    float phase = 0.1f * step;
+    float height = 2.0f * step;
+
+    for (size_t i = 0; i < GRID_SIZE; ++i) {
+        for (size_t j = 0; j < GRID_SIZE; ++j) {
+            float corners[12];
+            for (size_t k = 0; k < 4; ++k) {
+                float x = (float)(i + (k == 1 || k == 2)) / GRID_SIZE * 100.0f;
+                float y = (float)(j + (k >= 2)) / GRID_SIZE * 100.0f;
+                corners[3 * k + 0] = x;
+                corners[3 * k + 1] = y;
+                corners[3 * k + 2] = height + sinf(0.1f * x + phase) * cosf(0.1f * y);
+            }
+
+            add_quad(corners, &vertices[18 * (i * GRID_SIZE + j)]);
+        }
+    }
+}
+
+void add_quad(const float *corners, float *vertices) {
+    static const int order[6] = {0, 1, 2, 0, 2, 3};
+    for (size_t i = 0; i < 6; ++i) {
+        for (size_t k = 0; k < 3; ++k) {
+            vertices[3 * i + k] = corners[3 * order[i] + k];
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef PRINT3_H_
+#define PRINT3_H_
+
+// Public interface of the print3 library.
+// Link against the libprint3 target, which also provides the include directories of the headers below.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "deserialize/file.h"
+#include "scene.h"
+#include "viewer.h"
+
+// Show the triangles in a viewer window and return when the window is closed.
+// Every triangle consists of 9 floats (v1x v1y v1z v2x v2y v2z v3x v3y v3z).
+// The vertices are borrowed from the caller and not copied.
+void print3_show(const float *triangles, size_t triangle_count, Color color);
+
+// Show a scene in a viewer window with the default options and return when the window is closed
+void print3_show_scene(const Scene *scene);
+
+#endif
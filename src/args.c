@@ -11,9 +11,11 @@ static void handle_help(int argc, const char **argv);
 static void set_defaults(Args *args);
 static int parse_options(int argc, const char **argv, int start, Args *args);
 static void parse_inputs(int argc, const char **argv, int start, Args *args);
+static void check_stats_inputs(const char *prog, const Args *args);
 static void define_window_title(Args *args);
 static void warn_on_unusual_args(const Args *args);
 static Color parse_color(int argc, const char **argv, int offset, int channels);
+static size_t parse_count(int argc, const char **argv, int offset, const char *name);
 static void usage(FILE *stream, const char *prog_name);
 
 void args_parse(int argc, const char **argv, Args *args) {
@@ -23,6 +25,7 @@ void args_parse(int argc, const char **argv, Args *args) {
 
     int iarg = parse_options(argc, argv, 1, args);
     parse_inputs(argc, argv, iarg, args);
+    check_stats_inputs(argv[0], args);
 
     define_window_title(args);
 
@@ -37,10 +40,19 @@ void args_free_member(Args *args) {
 void args_print(const Args *args) {
     printf("Input arguments:\n");
     printf("- stdin object count: %d\n", args->stdin_object_count);
+    printf("- stream stdin: %d\n", args->stream_stdin);
+    printf("- binary stdin: %d\n", args->binary_stdin);
+    printf("- shared memory: %s\n", args->shm_name ? args->shm_name : "none");
     printf("- file count: %d\n", args->files.length);
     for (int i = 0; i < args->files.length; ++i) {
         printf("  - file[%d] = %s\n", i, args->files.items[i]);
     }
+    printf("- job count: %zu\n", args->job_count);
+    printf("- cache: %d\n", args->cache);
+    printf("- clear cache: %d\n", args->clear_cache);
+    printf("- cache directory: %s\n", args->cache_directory ? args->cache_directory : "default");
+    printf("- stats: %d\n", args->stats);
+    printf("- trace: %s\n", args->trace_path ? args->trace_path : "none");
 
     printf("\nViewer arguments:\n");
     printf("- window title: %s\n", args->viewer.window_title);
@@ -49,6 +61,7 @@ void args_print(const Args *args) {
     printf("- background color: r=%d g=%d b=%d a=%d\n", args->viewer.background.r, args->viewer.background.g,
            args->viewer.background.b, args->viewer.background.a);
     printf("- both sides: %d\n", args->viewer.render_facets_both_sides);
+    printf("- benchmark: %s\n", args->viewer.benchmark_path ? args->viewer.benchmark_path : "none");
 }
 
 void handle_help(int argc, const char **argv) {
@@ -62,16 +75,23 @@ void handle_help(int argc, const char **argv) {
 
 void set_defaults(Args *args) {
     args->stdin_object_count = 0;
+    args->stream_stdin = false;
+    args->binary_stdin = false;
+    args->shm_name = NULL;
 
     args->fallback_color = BLUE;
 
-    args->viewer.initial_window_width = 1600;
-    args->viewer.initial_window_height = 900;
+    args->job_count = 0;
 
-    args->viewer.true_no_hud = false;
-    args->viewer.background = WHITE;
-    args->viewer.render_facets_both_sides = false;
-    args->viewer.edge_color = (Color){0, 0, 0, 0};
+    args->cache = false;
+    args->clear_cache = false;
+    args->cache_directory = NULL;
+
+    args->stats = false;
+    args->trace_path = NULL;
+
+    // The window title is defined after the inputs are known
+    args->viewer = viewer_get_default_options();
 }
 
 int parse_options(int argc, const char **argv, int start, Args *args) {
@@ -107,6 +127,74 @@ int parse_options(int argc, const char **argv, int start, Args *args) {
             continue;
         }
 
+        if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            args->job_count = parse_count(argc, argv, i + 1, "job count");
+            i += 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--stream") == 0) {
+            args->stream_stdin = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-bi") == 0 || strcmp(argv[i], "--binary-stdin") == 0) {
+            args->binary_stdin = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-ca") == 0 || strcmp(argv[i], "--cache") == 0) {
+            args->cache = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-cc") == 0 || strcmp(argv[i], "--clear-cache") == 0) {
+            args->clear_cache = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-cd") == 0 || strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "[ERR] An argument must be provided for the cache directory but none is given.\n");
+                usage(stderr, prog);
+                exit(1);
+            }
+            args->cache_directory = argv[i + 1];
+            i += 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-bm") == 0 || strcmp(argv[i], "--benchmark") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "[ERR] An argument must be provided for the benchmark report but none is given.\n");
+                usage(stderr, prog);
+                exit(1);
+            }
+            args->viewer.benchmark_path = argv[i + 1];
+            i += 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-st") == 0 || strcmp(argv[i], "--stats") == 0) {
+            args->stats = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-tr") == 0 || strcmp(argv[i], "--trace") == 0) {
+#if !defined(PRINT3_TRACE)
+            fprintf(stderr, "[ERR] Tracing is not available in this build. Configure it with -DPRINT3_TRACE=ON.\n");
+            exit(1);
+#endif
+            if (i + 1 >= argc) {
+                fprintf(stderr, "[ERR] An argument must be provided for the trace file but none is given.\n");
+                usage(stderr, prog);
+                exit(1);
+            }
+            args->trace_path = argv[i + 1];
+            i += 1;
+            continue;
+        }
+
         return i;
     }
 
@@ -116,14 +204,47 @@ int parse_options(int argc, const char **argv, int start, Args *args) {
 void parse_inputs(int argc, const char **argv, int start, Args *args) {
     for (int i = start; i < argc; ++i) {
         if (strcmp(argv[i], "STDIN") == 0) {
+            if (args->stream_stdin) {
+                fprintf(stderr, "[ERR] \"STDIN\" inputs can not be combined with streaming stdin.\n");
+                usage(stderr, argv[0]);
+                exit(1);
+            }
+
             args->stdin_object_count++;
             continue;
         }
 
+        if (strncmp(argv[i], "SHM:", 4) == 0) {
+            // The viewer shows a single stream while it is running
+            if (args->stream_stdin || args->shm_name) {
+                fprintf(stderr, "[ERR] Only one stream is supported, \"%s\" can not be added.\n", argv[i]);
+                usage(stderr, argv[0]);
+                exit(1);
+            }
+
+            if (argv[i][4] == '\0') {
+                fprintf(stderr, "[ERR] The name of the shared memory segment is missing in \"%s\".\n", argv[i]);
+                usage(stderr, argv[0]);
+                exit(1);
+            }
+
+            args->shm_name = &argv[i][4];
+            continue;
+        }
+
         da_add(args->files, argv[i]);
     }
 }
 
+void check_stats_inputs(const char *prog, const Args *args) {
+    // Streams end with the viewer, so there is nothing to report on without it
+    if (args->stats && (args->stream_stdin || args->shm_name)) {
+        fprintf(stderr, "[ERR] --stats can not be combined with --stream or a \"SHM:\" input.\n");
+        usage(stderr, prog);
+        exit(1);
+    }
+}
+
 void define_window_title(Args *args) {
     // Determine the size of the window title buffer
     size_t n = 7;  // print3\n
@@ -153,7 +274,7 @@ void define_window_title(Args *args) {
 }
 
 void warn_on_unusual_args(const Args *args) {
-    if ((args->stdin_object_count + args->files.length) == 0) {
+    if ((args->stdin_object_count + args->files.length) == 0 && !args->stream_stdin && !args->shm_name) {
         fprintf(stderr, "[WARN] No input was specified. Only a empty scene will be visualized.\n");
         fprintf(stderr, "       Consider specify a input file or \"STDIN\" to provide an object via stdin.\n");
     }
@@ -192,17 +313,37 @@ Color parse_color(int argc, const char **argv, int offset, int channels) {
     return (Color){comp[0], comp[1], comp[2], comp[3]};
 }
 
+size_t parse_count(int argc, const char **argv, int offset, const char *name) {
+    if (offset >= argc) {
+        fprintf(stderr, "[ERR] An argument must be provided for the %s but none is given.\n", name);
+        usage(stderr, argv[0]);
+        exit(1);
+    }
+
+    char *peak;
+    long count = strtol(argv[offset], &peak, 10);
+    if (peak == argv[offset] || *peak != '\0' || count < 1) {
+        fprintf(stderr, "[ERR] The %s must be a positive number. %s was given.\n", name, argv[offset]);
+        usage(stderr, argv[0]);
+        exit(1);
+    }
+
+    return count;
+}
+
 void usage(FILE *stream, const char *prog_name) {
     fprintf(
         stream,
         "[USAGE] %s [OPTION ...] [INPUT ...]\n"
         "\n"
         "\n"
-        "- INPUT: \"STDIN\" | FILE\n"
+        "- INPUT: \"STDIN\" | \"SHM:\"{name} | FILE\n"
         "    Specify a file with a 3d model to visualize or provide the data via stdin.\n"
         "    The same file can be specified multiple times and will be duplicately rendered.\n"
         "    If \"STDIN\" is specified n times, n distinct objects need to be provided via stdin\n"
         "    before rendering can take place.\n"
+        "    \"SHM:\"{name} maps the shared memory ring of a producer (POSIX only) and shows its objects\n"
+        "    while the viewer is running, like --stream does for stdin. The producer must be started first.\n"
         "\n"
         "    The following file formats are supported:\n"
         "    - Standard Triangulation Language (.stl) (binary and ascii)\n"
@@ -217,6 +358,12 @@ void usage(FILE *stream, const char *prog_name) {
         "        v1x v1y v1z v2x v2y v2z v3x v3y v3z\n"
         "    - Terminate the specification with \"end\" or EoF (only feasable for the last object)\n"
         "\n"
+        "    With --binary-stdin every object is one binary frame instead:\n"
+        "    - 12 byte header: \"P3TF\" {red: UINT8} {green: UINT8} {blue: UINT8} {alpha: UINT8}\n"
+        "        {triangle count: UINT32 little endian}\n"
+        "    - The vertices of all triangles as packed REAL32 little endian\n"
+        "        v1x v1y v1z v2x v2y v2z v3x v3y v3z ...\n"
+        "\n"
         "\n"
         "- OPTION:\n"
         "    -h  | --help           Default: false\n"
@@ -249,6 +396,66 @@ void usage(FILE *stream, const char *prog_name) {
         "                           Warning: setting a non transparent (aka. alpha != 0) color will impact performance.\n"
         "                           Edge color of every surface. When a non transparent color is set\n"
         "                           the wireframe of the model is visible.\n"
+        "\n"
+        "    -j  | --jobs           Default: number of processors\n"
+        "                           Format: {count: UINT}\n"
+        "                           Number of threads used to load the input files.\n"
+        "                           Files are loaded concurrently, the order of the objects in the scene\n"
+        "                           always follows the order of the inputs.\n"
+        "\n"
+        "    -s  | --stream         Default: false\n"
+        "                           Format: Flag\n"
+        "                           Read objects from stdin while the viewer is running until the stream ends.\n"
+        "                           The objects use the stdin data format and are shown as soon as their\n"
+        "                           triangles arrive. Can not be combined with \"STDIN\" inputs.\n"
+        "                           Screenshots are saved as print3_{TIMESTAMP}.png in this mode.\n"
+        "                           Can not be combined with a \"SHM:\" input.\n"
+        "\n"
+        "    -bi | --binary-stdin   Default: false\n"
+        "                           Format: Flag\n"
+        "                           Read the objects on stdin as binary frames instead of text.\n"
+        "                           Producers holding the triangles in memory skip formatting and parsing numbers.\n"
+        "\n"
+        "    -ca | --cache          Default: false\n"
+        "                           Format: Flag\n"
+        "                           Cache the objects of text input files of at least 1 MiB after deserializing\n"
+        "                           them. An entry is reused as long as path, size, modification time and\n"
+        "                           fallback color of the file stay the same. Binary STL and PLY files are not\n"
+        "                           cached, they are decoded about as fast as an entry is read.\n"
+        "                           The entries are neither limited in size nor evicted, see --clear-cache.\n"
+        "\n"
+        "    -cc | --clear-cache    Default: false\n"
+        "                           Format: Flag\n"
+        "                           Remove all entries from the cache directory before loading the inputs.\n"
+        "\n"
+        "    -cd | --cache-dir      Default: $XDG_CACHE_HOME/print3, ~/.cache/print3 or %%LOCALAPPDATA%%\\print3\n"
+        "                           Format: {directory: PATH}\n"
+        "                           Directory of the cache entries.\n"
+        "\n"
+        "    -bm | --benchmark      Default: none\n"
+        "                           Format: {report: PATH}\n"
+        "                           Replay a fixed camera path (orbit, zoom, pan) over the scene without a frame rate\n"
+        "                           limit, close the viewer afterwards and write the mean, p50, p95 and p99 frame\n"
+        "                           times in milliseconds as JSON to the report. \"cpu\" covers updating the\n"
+        "                           viewer and issuing the draw calls, \"total\" adds flushing them and swapping the\n"
+        "                           buffers, which waits for the GPU once it falls behind.\n"
+        "\n"
+        "    -st | --stats          Default: false\n"
+        "                           Format: Flag\n"
+        "                           Load the inputs without opening a window and print for every file the time\n"
+        "                           spent reading, parsing, triangulating and caching it, and for every object its\n"
+        "                           triangle and vertex count, bounding box and allocated bytes. Formats which\n"
+        "                           triangulate while parsing report the triangulation as n/a.\n"
+        "                           Files are loaded one after another, so their timings do not overlap.\n"
+        "                           Mapped files are read while parsing, cached files report the cache load only.\n"
+        "                           Can not be combined with --stream or a \"SHM:\" input.\n"
+        "\n"
+        "    -tr | --trace          Default: none\n"
+        "                           Format: {file: PATH}\n"
+        "                           Write the timings of the loading and rendering steps, their threads and byte or\n"
+        "                           triangle counts in the Chrome trace format when the viewer closes. Open it in\n"
+        "                           Perfetto or chrome://tracing. Only available in builds configured with\n"
+        "                           -DPRINT3_TRACE=ON.\n"
         "\n",
         prog_name);
 }
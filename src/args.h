@@ -13,8 +13,17 @@ typedef struct Files {
 
 typedef struct Args {
     int stdin_object_count;
+    bool stream_stdin;
+    bool binary_stdin;
+    const char *shm_name;  // Shared memory ring streamed while the viewer is running, NULL if none
     Files files;
     Color fallback_color;
+    size_t job_count;  // 0 uses one job per processor
+    bool cache;
+    bool clear_cache;
+    const char *cache_directory;  // NULL uses the default directory
+    bool stats;                   // Print load statistics instead of opening the viewer
+    const char *trace_path;       // Chrome trace of the pipeline, NULL if none
     ViewerOptions viewer;
 } Args;
 
@@ -0,0 +1,525 @@
+#include "bvh.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dsa.h"
+#include "parallel.h"
+#include "trace.h"
+
+#define BIN_COUNT 16
+#define MIN_LEAF_SIZE 4      // Smaller nodes always become leafs
+#define MAX_LEAF_SIZE 32     // Larger nodes are always split
+#define MAX_DEPTH 64         // Bounds the traversal stack
+#define TRAVERSAL_COST 1.0f  // Relative to the cost of one triangle intersection
+
+#define TRIANGLES_PER_TASK (1 << 16)
+#define SUBTREES_PER_JOB 4
+#define MIN_SUBTREE_SIZE (1 << 12)
+
+// Boxes are enlarged relative to the scene size, so hits on the edges of a triangle are never missed
+#define BOX_PADDING 1e-5f
+
+typedef struct Primitive {
+    float min[3];
+    float max[3];
+    BvhTriangle triangle;
+} Primitive;
+
+typedef struct Bin {
+    size_t count;
+    float min[3];
+    float max[3];
+} Bin;
+
+typedef struct Split {
+    size_t axis;
+    size_t bin;  // Last bin of the left child
+    float cost;
+} Split;
+
+// Node of the upper levels, whose primitives are built into a separate hierarchy in parallel
+typedef struct Subtree {
+    size_t node;
+    size_t begin;
+    size_t end;
+    size_t depth;
+    BvhNodes nodes;
+} Subtree;
+
+typedef struct Subtrees {
+    Subtree *items;
+    size_t length;
+    size_t capacity;
+} Subtrees;
+
+typedef struct BuildState {
+    Primitive *primitives;
+    BvhNodes *nodes;
+    Subtrees *subtrees;   // NULL to build everything in place
+    size_t subtree_size;  // Nodes up to this size are deferred into subtrees
+} BuildState;
+
+typedef struct PrimitiveContext {
+    const Scene *scene;
+    const size_t *offsets;  // First triangle of every object, followed by the total triangle count
+    Primitive *primitives;
+} PrimitiveContext;
+
+typedef struct SubtreeContext {
+    Primitive *primitives;
+    Subtrees *subtrees;
+} SubtreeContext;
+
+typedef struct StackEntry {
+    uint32_t node;
+    float distance;
+} StackEntry;
+
+static inline float min_f(float a, float b) { return a < b ? a : b; }
+static inline float max_f(float a, float b) { return a > b ? a : b; }
+
+static int run_build(void *arg);
+static void compute_primitives_task(void *context, size_t index);
+static void build_subtree_task(void *context, size_t index);
+static void build_node(BuildState *state, size_t node_index, size_t begin, size_t end, size_t depth);
+static bool find_split(const Primitive *primitives, size_t begin, size_t end, const float centroid_min[3],
+                       const float centroid_max[3], Split *split);
+static size_t get_bin(const Primitive *primitive, size_t axis, float centroid_min, float scale);
+static float get_half_area(const float min[3], const float max[3]);
+static void merge_subtrees(Subtrees *subtrees, BvhNodes *nodes);
+static void pad_boxes(BvhNodes *nodes);
+static float get_ray_box_distance(const BvhNode *node, const float origin[3], const float direction[3],
+                                  const float inverse_direction[3], float max_distance);
+
+void bvh_build(const Scene *scene, Bvh *bvh) {
+    *bvh = (Bvh){0};
+
+    // Triangles are numbered over all objects
+    size_t *offsets = malloc((scene->objects.length + 1) * sizeof(size_t));
+    assert(offsets && "Could not allocate the triangle offsets.");
+    offsets[0] = 0;
+    for (size_t i = 0; i < scene->objects.length; ++i) {
+        offsets[i + 1] = offsets[i] + object_triangle_count(scene->objects.items[i]);
+    }
+
+    size_t triangle_count = offsets[scene->objects.length];
+    if (!triangle_count) {
+        free(offsets);
+        return;
+    }
+
+    // Node indices are 32 bit and there are up to two nodes per triangle
+    if (triangle_count > UINT32_MAX / 2) {
+        fprintf(stderr, "[ERR] Scene has too many triangles to build a bounding volume hierarchy.\n");
+        exit(1);
+    }
+
+    Primitive *primitives = malloc(triangle_count * sizeof(Primitive));
+    assert(primitives && "Could not allocate the primitives of the bounding volume hierarchy.");
+
+    PrimitiveContext primitive_context = {.scene = scene, .offsets = offsets, .primitives = primitives};
+    parallel_for((triangle_count + TRIANGLES_PER_TASK - 1) / TRIANGLES_PER_TASK, compute_primitives_task,
+                 &primitive_context);
+
+    // Build the upper levels serially, until there are enough subtrees to keep all jobs busy
+    size_t subtree_size = triangle_count / (parallel_get_job_count() * SUBTREES_PER_JOB);
+    if (subtree_size < MIN_SUBTREE_SIZE) subtree_size = MIN_SUBTREE_SIZE;
+
+    Subtrees subtrees = {0};
+    BuildState state = {
+        .primitives = primitives,
+        .nodes = &bvh->nodes,
+        .subtrees = &subtrees,
+        .subtree_size = subtree_size,
+    };
+    da_add(bvh->nodes, (BvhNode){0});
+    build_node(&state, 0, 0, triangle_count, 0);
+
+    SubtreeContext subtree_context = {.primitives = primitives, .subtrees = &subtrees};
+    parallel_for(subtrees.length, build_subtree_task, &subtree_context);
+
+    merge_subtrees(&subtrees, &bvh->nodes);
+    pad_boxes(&bvh->nodes);
+
+    // Keep only the references to the triangles in leaf order
+    bvh->triangles.items = malloc(triangle_count * sizeof(BvhTriangle));
+    assert(bvh->triangles.items && "Could not allocate the triangles of the bounding volume hierarchy.");
+    bvh->triangles.length = triangle_count;
+    bvh->triangles.capacity = triangle_count;
+    for (size_t i = 0; i < triangle_count; ++i) {
+        bvh->triangles.items[i] = primitives[i].triangle;
+    }
+
+    free(subtrees.items);
+    free(primitives);
+    free(offsets);
+}
+
+void bvh_free_members(Bvh *bvh) {
+    free(bvh->nodes.items);
+    free(bvh->triangles.items);
+}
+
+void bvh_build_start(const Scene *scene, BvhBuild *build) {
+    *build = (BvhBuild){.scene = scene};
+
+    if (thrd_create(&build->builder, run_build, build) != thrd_success) {
+        fprintf(stderr, "[ERR] Could not create a thread for building the bounding volume hierarchy.\n");
+        exit(1);
+    }
+}
+
+const Bvh *bvh_build_wait(BvhBuild *build) {
+    if (!build->joined) {
+        thrd_join(build->builder, NULL);
+        build->joined = true;
+    }
+
+    return &build->bvh;
+}
+
+void bvh_build_stop(BvhBuild *build) {
+    bvh_build_wait(build);
+    bvh_free_members(&build->bvh);
+    build->bvh = (Bvh){0};
+}
+
+bool bvh_get_ray_collision(const Bvh *bvh, const Scene *scene, Ray ray, BvhCollision *collision) {
+    *collision = (BvhCollision){0};
+
+    if (!bvh->nodes.length) return false;
+
+    float origin[3] = {ray.position.x, ray.position.y, ray.position.z};
+    float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+    float inverse_direction[3] = {1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2]};
+
+    // Nodes are only skipped if they are strictly farther away than the nearest hit, to resolve ties like a linear
+    // search over all triangles
+    float nearest = INFINITY;
+
+    StackEntry stack[MAX_DEPTH + 1];
+    size_t stack_size = 0;
+
+    float root_distance = get_ray_box_distance(&bvh->nodes.items[0], origin, direction, inverse_direction, nearest);
+    if (root_distance == INFINITY) return false;
+    stack[stack_size++] = (StackEntry){0, root_distance};
+
+    while (stack_size) {
+        StackEntry entry = stack[--stack_size];
+        if (entry.distance > nearest) continue;
+
+        const BvhNode *node = &bvh->nodes.items[entry.node];
+
+        if (node->count) {
+            for (size_t i = node->first; i < node->first + node->count; ++i) {
+                BvhTriangle triangle = bvh->triangles.items[i];
+
+                Vector3 vertices[3];
+                object_get_triangle(&scene->objects.items[triangle.object], triangle.triangle, vertices);
+                RayCollision hit = GetRayCollisionTriangle(ray, vertices[0], vertices[1], vertices[2]);
+
+                if (!hit.hit || hit.distance > nearest) continue;
+
+                if (hit.distance == nearest &&
+                    (triangle.object > collision->object ||
+                     (triangle.object == collision->object && triangle.triangle > collision->triangle))) {
+                    continue;
+                }
+
+                nearest = hit.distance;
+                collision->collision = hit;
+                collision->object = triangle.object;
+                collision->triangle = triangle.triangle;
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        StackEntry left = {node->first, 0};
+        StackEntry right = {node->first + 1, 0};
+        left.distance =
+            get_ray_box_distance(&bvh->nodes.items[left.node], origin, direction, inverse_direction, nearest);
+        right.distance =
+            get_ray_box_distance(&bvh->nodes.items[right.node], origin, direction, inverse_direction, nearest);
+
+        if (left.distance > right.distance) {
+            StackEntry temp = left;
+            left = right;
+            right = temp;
+        }
+
+        if (right.distance != INFINITY) stack[stack_size++] = right;
+        if (left.distance != INFINITY) stack[stack_size++] = left;
+    }
+
+    return collision->collision.hit;
+}
+
+int run_build(void *arg) {
+    BvhBuild *build = arg;
+
+    TRACE_BEGIN(build_bvh, "build bvh");
+    bvh_build(build->scene, &build->bvh);
+    TRACE_COUNT(build_bvh, "triangles", build->bvh.triangles.length);
+    TRACE_END(build_bvh);
+
+    return 0;
+}
+
+void compute_primitives_task(void *context, size_t index) {
+    PrimitiveContext *ctx = context;
+
+    size_t begin = index * TRIANGLES_PER_TASK;
+    size_t end = begin + TRIANGLES_PER_TASK;
+    if (end > ctx->offsets[ctx->scene->objects.length]) end = ctx->offsets[ctx->scene->objects.length];
+
+    // Find the object of the first triangle
+    size_t lower = 0;
+    size_t upper = ctx->scene->objects.length;
+    while (upper - lower > 1) {
+        size_t middle = (lower + upper) / 2;
+        if (ctx->offsets[middle] <= begin) {
+            lower = middle;
+        } else {
+            upper = middle;
+        }
+    }
+
+    size_t i_obj = lower;
+    for (size_t i = begin; i < end; ++i) {
+        while (i >= ctx->offsets[i_obj + 1]) ++i_obj;
+
+        Vector3 vertices[3];
+        object_get_triangle(&ctx->scene->objects.items[i_obj], i - ctx->offsets[i_obj], vertices);
+
+        Primitive *primitive = &ctx->primitives[i];
+        primitive->min[0] = min_f(min_f(vertices[0].x, vertices[1].x), vertices[2].x);
+        primitive->min[1] = min_f(min_f(vertices[0].y, vertices[1].y), vertices[2].y);
+        primitive->min[2] = min_f(min_f(vertices[0].z, vertices[1].z), vertices[2].z);
+        primitive->max[0] = max_f(max_f(vertices[0].x, vertices[1].x), vertices[2].x);
+        primitive->max[1] = max_f(max_f(vertices[0].y, vertices[1].y), vertices[2].y);
+        primitive->max[2] = max_f(max_f(vertices[0].z, vertices[1].z), vertices[2].z);
+        primitive->triangle = (BvhTriangle){i_obj, i - ctx->offsets[i_obj]};
+    }
+}
+
+void build_subtree_task(void *context, size_t index) {
+    SubtreeContext *ctx = context;
+    Subtree *subtree = &ctx->subtrees->items[index];
+
+    BuildState state = {
+        .primitives = ctx->primitives,
+        .nodes = &subtree->nodes,
+        .subtrees = NULL,
+        .subtree_size = 0,
+    };
+    da_add(subtree->nodes, (BvhNode){0});
+    build_node(&state, 0, subtree->begin, subtree->end, subtree->depth);
+}
+
+void build_node(BuildState *state, size_t node_index, size_t begin, size_t end, size_t depth) {
+    size_t count = end - begin;
+
+    if (state->subtrees && count <= state->subtree_size) {
+        Subtree subtree = {.node = node_index, .begin = begin, .end = end, .depth = depth};
+        da_add(*state->subtrees, subtree);
+        return;
+    }
+
+    // Bounds of the triangles and of their centroids
+    float min[3] = {INFINITY, INFINITY, INFINITY};
+    float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    float centroid_min[3] = {INFINITY, INFINITY, INFINITY};
+    float centroid_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t i = begin; i < end; ++i) {
+        const Primitive *primitive = &state->primitives[i];
+        for (size_t k = 0; k < 3; ++k) {
+            float centroid = 0.5f * (primitive->min[k] + primitive->max[k]);
+            min[k] = min_f(min[k], primitive->min[k]);
+            max[k] = max_f(max[k], primitive->max[k]);
+            centroid_min[k] = min_f(centroid_min[k], centroid);
+            centroid_max[k] = max_f(centroid_max[k], centroid);
+        }
+    }
+
+    BvhNode *node = &state->nodes->items[node_index];
+    for (size_t k = 0; k < 3; ++k) {
+        node->min[k] = min[k];
+        node->max[k] = max[k];
+    }
+    node->first = begin;
+    node->count = count;
+
+    if (count <= MIN_LEAF_SIZE || depth >= MAX_DEPTH) return;
+
+    size_t middle;
+    Split split;
+    if (find_split(state->primitives, begin, end, centroid_min, centroid_max, &split)) {
+        float leaf_cost = count * get_half_area(min, max);
+        float split_cost = TRAVERSAL_COST * get_half_area(min, max) + split.cost;
+        if (count <= MAX_LEAF_SIZE && split_cost >= leaf_cost) return;
+
+        // Partition the primitives by their bin along the split axis
+        float scale = BIN_COUNT / (centroid_max[split.axis] - centroid_min[split.axis]);
+        size_t left = begin;
+        size_t right = end;
+        while (left < right) {
+            if (get_bin(&state->primitives[left], split.axis, centroid_min[split.axis], scale) <= split.bin) {
+                ++left;
+            } else {
+                Primitive temp = state->primitives[left];
+                state->primitives[left] = state->primitives[--right];
+                state->primitives[right] = temp;
+            }
+        }
+        middle = left;
+    } else {
+        // All centroids coincide, so only an equal split of large nodes is left
+        if (count <= MAX_LEAF_SIZE) return;
+        middle = begin + count / 2;
+    }
+
+    // Children are stored next to each other, the node pointer is invalidated by adding them
+    size_t child_index = state->nodes->length;
+    da_add(*state->nodes, (BvhNode){0});
+    da_add(*state->nodes, (BvhNode){0});
+    state->nodes->items[node_index].first = child_index;
+    state->nodes->items[node_index].count = 0;
+
+    build_node(state, child_index, begin, middle, depth + 1);
+    build_node(state, child_index + 1, middle, end, depth + 1);
+}
+
+bool find_split(const Primitive *primitives, size_t begin, size_t end, const float centroid_min[3],
+                const float centroid_max[3], Split *split) {
+    bool found = false;
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+        float extent = centroid_max[axis] - centroid_min[axis];
+        if (!(extent > 0)) continue;
+
+        Bin bins[BIN_COUNT];
+        for (size_t i = 0; i < BIN_COUNT; ++i) {
+            bins[i] = (Bin){0, {INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY}};
+        }
+
+        float scale = BIN_COUNT / extent;
+        for (size_t i = begin; i < end; ++i) {
+            Bin *bin = &bins[get_bin(&primitives[i], axis, centroid_min[axis], scale)];
+            ++bin->count;
+            for (size_t k = 0; k < 3; ++k) {
+                bin->min[k] = min_f(bin->min[k], primitives[i].min[k]);
+                bin->max[k] = max_f(bin->max[k], primitives[i].max[k]);
+            }
+        }
+
+        // Sweep from the right to get the cost of every right side, then from the left to combine both
+        float right_costs[BIN_COUNT];
+        size_t right_count = 0;
+        float right_min[3] = {INFINITY, INFINITY, INFINITY};
+        float right_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (size_t i = BIN_COUNT - 1; i > 0; --i) {
+            right_count += bins[i].count;
+            for (size_t k = 0; k < 3; ++k) {
+                right_min[k] = min_f(right_min[k], bins[i].min[k]);
+                right_max[k] = max_f(right_max[k], bins[i].max[k]);
+            }
+            right_costs[i - 1] = right_count ? right_count * get_half_area(right_min, right_max) : 0;
+        }
+
+        size_t left_count = 0;
+        float left_min[3] = {INFINITY, INFINITY, INFINITY};
+        float left_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (size_t i = 0; i < BIN_COUNT - 1; ++i) {
+            left_count += bins[i].count;
+            for (size_t k = 0; k < 3; ++k) {
+                left_min[k] = min_f(left_min[k], bins[i].min[k]);
+                left_max[k] = max_f(left_max[k], bins[i].max[k]);
+            }
+
+            // Both children need primitives
+            if (!left_count || left_count == end - begin) continue;
+
+            float cost = left_count * get_half_area(left_min, left_max) + right_costs[i];
+            if (!found || cost < split->cost) {
+                *split = (Split){axis, i, cost};
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+size_t get_bin(const Primitive *primitive, size_t axis, float centroid_min, float scale) {
+    float centroid = 0.5f * (primitive->min[axis] + primitive->max[axis]);
+    size_t bin = (size_t)((centroid - centroid_min) * scale);
+    return bin < BIN_COUNT ? bin : BIN_COUNT - 1;
+}
+
+float get_half_area(const float min[3], const float max[3]) {
+    float dx = max[0] - min[0];
+    float dy = max[1] - min[1];
+    float dz = max[2] - min[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+void merge_subtrees(Subtrees *subtrees, BvhNodes *nodes) {
+    for (size_t i = 0; i < subtrees->length; ++i) {
+        Subtree *subtree = &subtrees->items[i];
+
+        // The root replaces the deferred node, all other nodes are appended
+        size_t offset = nodes->length - 1;
+        for (size_t i_node = 0; i_node < subtree->nodes.length; ++i_node) {
+            BvhNode node = subtree->nodes.items[i_node];
+            if (!node.count) node.first += offset;
+
+            if (i_node) {
+                da_add(*nodes, node);
+            } else {
+                nodes->items[subtree->node] = node;
+            }
+        }
+
+        free(subtree->nodes.items);
+    }
+}
+
+void pad_boxes(BvhNodes *nodes) {
+    float scene_size = 0;
+    for (size_t k = 0; k < 3; ++k) {
+        scene_size = max_f(scene_size, fabsf(nodes->items[0].min[k]));
+        scene_size = max_f(scene_size, fabsf(nodes->items[0].max[k]));
+    }
+
+    float padding = BOX_PADDING * scene_size;
+    for (size_t i = 0; i < nodes->length; ++i) {
+        for (size_t k = 0; k < 3; ++k) {
+            nodes->items[i].min[k] -= padding;
+            nodes->items[i].max[k] += padding;
+        }
+    }
+}
+
+float get_ray_box_distance(const BvhNode *node, const float origin[3], const float direction[3],
+                           const float inverse_direction[3], float max_distance) {
+    float near = 0;
+    float far = max_distance;
+
+    for (size_t k = 0; k < 3; ++k) {
+        // Rays parallel to a slab either always or never are within it
+        if (direction[k] == 0) {
+            if (origin[k] < node->min[k] || origin[k] > node->max[k]) return INFINITY;
+            continue;
+        }
+
+        float t1 = (node->min[k] - origin[k]) * inverse_direction[k];
+        float t2 = (node->max[k] - origin[k]) * inverse_direction[k];
+        near = max_f(near, min_f(t1, t2));
+        far = min_f(far, max_f(t1, t2));
+    }
+
+    return near <= far ? near : INFINITY;
+}
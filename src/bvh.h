@@ -0,0 +1,74 @@
+#ifndef PRINT3_BVH_H_
+#define PRINT3_BVH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "raylib.h"
+#include "scene.h"
+
+typedef struct BvhNode {
+    float min[3];
+    uint32_t first;  // Inner node: index of the left child, the right child follows. Leaf: first triangle
+    float max[3];
+    uint32_t count;  // Number of triangles of a leaf, 0 for inner nodes
+} BvhNode;
+
+typedef struct BvhNodes {
+    BvhNode *items;
+    size_t length;
+    size_t capacity;
+} BvhNodes;
+
+typedef struct BvhTriangle {
+    uint32_t object;
+    uint32_t triangle;
+} BvhTriangle;
+
+typedef struct BvhTriangles {
+    BvhTriangle *items;
+    size_t length;
+    size_t capacity;
+} BvhTriangles;
+
+// Bounding volume hierarchy over all triangles of a scene
+typedef struct Bvh {
+    BvhNodes nodes;  // Root at index 0
+    BvhTriangles triangles;
+} Bvh;
+
+// Hierarchy of a scene, built by a background thread
+typedef struct BvhBuild {
+    const Scene *scene;
+    Bvh bvh;  // Complete once the builder is joined
+    thrd_t builder;
+    bool joined;
+} BvhBuild;
+
+typedef struct BvhCollision {
+    RayCollision collision;
+    uint32_t object;
+    uint32_t triangle;
+} BvhCollision;
+
+// Build the hierarchy with binned SAH splits on the worker pool
+void bvh_build(const Scene *scene, Bvh *bvh);
+
+void bvh_free_members(Bvh *bvh);
+
+// The scene must not change until the build is stopped
+void bvh_build_start(const Scene *scene, BvhBuild *build);
+
+// Block until the hierarchy is built
+const Bvh *bvh_build_wait(BvhBuild *build);
+
+// Wait for the build and free the hierarchy
+void bvh_build_stop(BvhBuild *build);
+
+// Find the nearest triangle hit by the ray.
+// Ties are resolved in favor of the triangle, that comes first in the scene.
+bool bvh_get_ray_collision(const Bvh *bvh, const Scene *scene, Ray ray, BvhCollision *collision);
+
+#endif
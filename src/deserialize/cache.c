@@ -0,0 +1,441 @@
+#include "cache.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#define CACHE_MAGIC "P3C"
+#define CACHE_VERSION 1
+#define CACHE_EXTENSION ".p3c"
+#define CACHE_ALIGNMENT 8
+
+// Smaller files are deserialized faster than the cache entry is looked up and written
+#define CACHE_MIN_FILE_SIZE (1 << 20)
+
+#if defined(_WIN32)
+#define PATH_SEPARATOR '\\'
+#else
+#define PATH_SEPARATOR '/'
+#endif
+
+// Layout of an entry, every block starts at a multiple of CACHE_ALIGNMENT.
+// Entries are read with fread into arrays owned by the objects, which the scene frees like any other object.
+// - CacheHeader
+// - Absolute path of the source file
+// - For every object: CacheObject, vertices, colors, indices
+typedef struct CacheHeader {
+    char magic[4];
+    uint32_t version;  // Entries of hosts with another byte order never match
+    uint64_t size;
+    int64_t modification_seconds;
+    int64_t modification_nanoseconds;
+    unsigned char fallback_color[4];
+    uint32_t path_length;
+    uint64_t object_count;
+} CacheHeader;
+
+typedef struct CacheObject {
+    uint64_t vertex_count;  // Number of floats
+    uint64_t color_count;   // Number of color components
+    uint64_t index_count;
+} CacheObject;
+
+static bool cache_enabled = false;
+static char *cache_directory = NULL;
+static atomic_size_t temporary_count = 0;
+
+static char *get_default_directory(void);
+static char *get_entry_path(const CacheKey *key);
+static char *join_path(const char *directory, const char *name);
+static bool make_directories(const char *directory);
+static bool replace_file(const char *source, const char *destination);
+static unsigned long get_process_id(void);
+static bool get_file_size(const char *path, uint64_t *size);
+static bool read_block(FILE *fp, void *data, size_t size, uint64_t *remaining);
+static bool read_array(FILE *fp, void **items, uint64_t count, size_t item_size, uint64_t *remaining);
+static bool read_object(FILE *fp, Object *obj, uint64_t *remaining);
+static bool write_block(FILE *fp, const void *data, size_t size);
+static bool write_object(FILE *fp, const Object *obj);
+
+void cache_set_directory(const char *directory) {
+    free(cache_directory);
+
+    if (!directory) {
+        cache_directory = get_default_directory();
+        return;
+    }
+
+    cache_directory = join_path(directory, NULL);
+}
+
+void cache_set_enabled(bool enabled) { cache_enabled = enabled; }
+
+#if defined(_WIN32)
+
+void cache_clear(void) {
+    if (!cache_directory) return;
+
+    char *pattern = join_path(cache_directory, "*" CACHE_EXTENSION "*");
+
+    WIN32_FIND_DATAA entry;
+    HANDLE search = FindFirstFileA(pattern, &entry);
+    free(pattern);
+    if (search == INVALID_HANDLE_VALUE) return;
+
+    do {
+        char *path = join_path(cache_directory, entry.cFileName);
+        remove(path);
+        free(path);
+    } while (FindNextFileA(search, &entry));
+
+    FindClose(search);
+}
+
+#else
+
+void cache_clear(void) {
+    if (!cache_directory) return;
+
+    DIR *dir = opendir(cache_directory);
+    if (!dir) return;
+
+    // Remove entries and temporary files of interrupted writes, but nothing else
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (!strstr(entry->d_name, CACHE_EXTENSION)) continue;
+
+        char *path = join_path(cache_directory, entry->d_name);
+        if (remove(path)) {
+            fprintf(stderr, "[WARN] Could not remove the cache entry \"%s\".\n", path);
+        }
+        free(path);
+    }
+
+    closedir(dir);
+}
+
+#endif
+
+bool cache_get_key(const char *filename, Color fallback_color, CacheKey *key) {
+    *key = (CacheKey){0};
+
+    if (!cache_enabled || !cache_directory) return false;
+
+#if defined(_WIN32)
+    struct _stat64 info;
+    if (_stat64(filename, &info) || !(info.st_mode & _S_IFREG)) return false;
+    key->modification_seconds = info.st_mtime;
+    key->modification_nanoseconds = 0;
+#else
+    struct stat info;
+    if (stat(filename, &info) || !S_ISREG(info.st_mode)) return false;
+#if defined(__APPLE__)
+    key->modification_seconds = info.st_mtimespec.tv_sec;
+    key->modification_nanoseconds = info.st_mtimespec.tv_nsec;
+#else
+    key->modification_seconds = info.st_mtim.tv_sec;
+    key->modification_nanoseconds = info.st_mtim.tv_nsec;
+#endif
+#endif
+
+    if (info.st_size < CACHE_MIN_FILE_SIZE) return false;
+
+    key->size = info.st_size;
+    key->fallback_color = fallback_color;
+
+#if defined(_WIN32)
+    key->path = _fullpath(NULL, filename, 0);
+#else
+    key->path = realpath(filename, NULL);
+#endif
+
+    return key->path != NULL;
+}
+
+void cache_free_key(CacheKey *key) {
+    free(key->path);
+    *key = (CacheKey){0};
+}
+
+bool cache_load(const CacheKey *key, Scene *scene) {
+    char *entry = get_entry_path(key);
+
+    uint64_t remaining;
+    FILE *fp = get_file_size(entry, &remaining) ? fopen(entry, "rb") : NULL;
+    free(entry);
+    if (!fp) return false;
+
+    // Compare the identity of the source file
+    CacheHeader header;
+    bool valid = read_block(fp, &header, sizeof(CacheHeader), &remaining) &&
+                 memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == CACHE_VERSION &&
+                 header.size == key->size && header.modification_seconds == key->modification_seconds &&
+                 header.modification_nanoseconds == key->modification_nanoseconds &&
+                 header.fallback_color[0] == key->fallback_color.r &&
+                 header.fallback_color[1] == key->fallback_color.g &&
+                 header.fallback_color[2] == key->fallback_color.b &&
+                 header.fallback_color[3] == key->fallback_color.a && header.path_length == strlen(key->path);
+
+    // Entries of different files may share the same name
+    char *path = NULL;
+    valid = valid && read_array(fp, (void **)&path, header.path_length, sizeof(char), &remaining) &&
+            memcmp(path, key->path, header.path_length) == 0;
+    free(path);
+
+    Objects objects = {0};
+    for (uint64_t i = 0; valid && i < header.object_count; ++i) {
+        Object obj = {0};
+        valid = read_object(fp, &obj, &remaining);
+        da_add(objects, obj);
+    }
+    valid = valid && remaining == 0;
+
+    fclose(fp);
+
+    for (size_t i = 0; i < objects.length; ++i) {
+        if (valid) {
+            da_add(scene->objects, objects.items[i]);
+            continue;
+        }
+
+        free(objects.items[i].vertices.items);
+        free(objects.items[i].colors.items);
+        free(objects.items[i].indices.items);
+    }
+    free(objects.items);
+
+    return valid;
+}
+
+void cache_store(const CacheKey *key, const Object *objects, size_t count) {
+    if (!make_directories(cache_directory)) {
+        fprintf(stderr, "[WARN] Could not create the cache directory \"%s\".\n", cache_directory);
+        return;
+    }
+
+    // Write a temporary file and move it in place, so a concurrent load never sees a partial entry
+    char *entry = get_entry_path(key);
+    size_t n = strlen(entry) + 64;
+    char *temporary = malloc(n);
+    assert(temporary && "Could not allocate the path of a temporary cache entry.");
+    snprintf(temporary, n, "%s.%lu.%zu.tmp", entry, get_process_id(), atomic_fetch_add(&temporary_count, 1));
+
+    CacheHeader header = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .size = key->size,
+        .modification_seconds = key->modification_seconds,
+        .modification_nanoseconds = key->modification_nanoseconds,
+        .fallback_color = {key->fallback_color.r, key->fallback_color.g, key->fallback_color.b, key->fallback_color.a},
+        .path_length = strlen(key->path),
+        .object_count = count,
+    };
+
+    FILE *fp = fopen(temporary, "wb");
+    bool written = fp && write_block(fp, &header, sizeof(CacheHeader)) &&
+                   write_block(fp, key->path, header.path_length);
+    for (size_t i = 0; written && i < count; ++i) {
+        written = write_object(fp, &objects[i]);
+    }
+    if (fp) written = fclose(fp) == 0 && written;
+    written = written && replace_file(temporary, entry);
+
+    if (!written) {
+        fprintf(stderr, "[WARN] Could not write the cache entry of file \"%s\".\n", key->path);
+        remove(temporary);
+    }
+
+    free(temporary);
+    free(entry);
+}
+
+char *get_default_directory(void) {
+#if defined(_WIN32)
+    const char *local_app_data = getenv("LOCALAPPDATA");
+    return local_app_data && *local_app_data ? join_path(local_app_data, "print3") : NULL;
+#else
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home && *xdg_cache_home) return join_path(xdg_cache_home, "print3");
+
+    const char *home = getenv("HOME");
+    if (!home || !*home) return NULL;
+
+    char *cache_home = join_path(home, ".cache");
+    char *directory = join_path(cache_home, "print3");
+    free(cache_home);
+    return directory;
+#endif
+}
+
+char *get_entry_path(const CacheKey *key) {
+    // FNV-1a hash of the path and the fallback color, so edits of a file replace its entry
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *c = key->path; *c; ++c) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    unsigned char color[4] = {key->fallback_color.r, key->fallback_color.g, key->fallback_color.b,
+                              key->fallback_color.a};
+    for (size_t i = 0; i < 4; ++i) {
+        hash = (hash ^ color[i]) * 1099511628211ULL;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx" CACHE_EXTENSION, (unsigned long long)hash);
+    return join_path(cache_directory, name);
+}
+
+char *join_path(const char *directory, const char *name) {
+    size_t n_directory = strlen(directory);
+    size_t n_name = name ? strlen(name) : 0;
+
+    char *path = malloc(n_directory + n_name + 2);
+    assert(path && "Could not allocate a path.");
+
+    memcpy(path, directory, n_directory);
+    if (name) {
+        path[n_directory++] = PATH_SEPARATOR;
+        memcpy(&path[n_directory], name, n_name);
+    }
+    path[n_directory + n_name] = '\0';
+
+    return path;
+}
+
+bool make_directories(const char *directory) {
+    if (!directory) return false;
+
+    char *path = join_path(directory, NULL);
+
+    // Create every parent directory from the root on
+    for (char *c = path + 1; *c; ++c) {
+        if (*c != '/' && *c != PATH_SEPARATOR) continue;
+
+        char separator = *c;
+        *c = '\0';
+#if defined(_WIN32)
+        _mkdir(path);
+#else
+        mkdir(path, 0755);
+#endif
+        *c = separator;
+    }
+
+#if defined(_WIN32)
+    bool created = _mkdir(path) == 0 || errno == EEXIST;
+#else
+    bool created = mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+
+    free(path);
+    return created;
+}
+
+bool replace_file(const char *source, const char *destination) {
+#if defined(_WIN32)
+    return MoveFileExA(source, destination, MOVEFILE_REPLACE_EXISTING);
+#else
+    return rename(source, destination) == 0;
+#endif
+}
+
+unsigned long get_process_id(void) {
+#if defined(_WIN32)
+    return GetCurrentProcessId();
+#else
+    return getpid();
+#endif
+}
+
+bool get_file_size(const char *path, uint64_t *size) {
+#if defined(_WIN32)
+    struct _stat64 info;
+    if (_stat64(path, &info)) return false;
+#else
+    struct stat info;
+    if (stat(path, &info)) return false;
+#endif
+
+    *size = info.st_size;
+    return true;
+}
+
+bool read_block(FILE *fp, void *data, size_t size, uint64_t *remaining) {
+    size_t padding = (CACHE_ALIGNMENT - size % CACHE_ALIGNMENT) % CACHE_ALIGNMENT;
+    if (size + padding > *remaining) return false;
+
+    char zeros[CACHE_ALIGNMENT];
+    if (fread(data, 1, size, fp) != size || fread(zeros, 1, padding, fp) != padding) return false;
+
+    *remaining -= size + padding;
+    return true;
+}
+
+bool read_array(FILE *fp, void **items, uint64_t count, size_t item_size, uint64_t *remaining) {
+    *items = NULL;
+
+    // Reject corrupted counts before allocating
+    if (count > *remaining / item_size) return false;
+    if (!count) return true;
+
+    *items = malloc(count * item_size);
+    assert(*items && "Could not allocate the content of a cache entry.");
+
+    return read_block(fp, *items, count * item_size, remaining);
+}
+
+bool read_object(FILE *fp, Object *obj, uint64_t *remaining) {
+    CacheObject header;
+    if (!read_block(fp, &header, sizeof(CacheObject), remaining)) return false;
+
+    if (header.vertex_count % 3 || header.color_count != header.vertex_count / 3 * 4 || header.index_count % 3) {
+        return false;
+    }
+
+    bool valid = read_array(fp, (void **)&obj->vertices.items, header.vertex_count, sizeof(float), remaining) &&
+                 read_array(fp, (void **)&obj->colors.items, header.color_count, sizeof(unsigned char), remaining) &&
+                 read_array(fp, (void **)&obj->indices.items, header.index_count, sizeof(uint32_t), remaining);
+
+    obj->vertices.length = obj->vertices.capacity = header.vertex_count;
+    obj->colors.length = obj->colors.capacity = header.color_count;
+    obj->indices.length = obj->indices.capacity = header.index_count;
+
+    // A corrupted entry must not crash the viewer
+    for (size_t i = 0; valid && i < obj->indices.length; ++i) {
+        valid = obj->indices.items[i] < header.vertex_count / 3;
+    }
+
+    return valid;
+}
+
+bool write_block(FILE *fp, const void *data, size_t size) {
+    static const char zeros[CACHE_ALIGNMENT] = {0};
+    if (!size) return true;  // Empty arrays have no items to write
+
+    size_t padding = (CACHE_ALIGNMENT - size % CACHE_ALIGNMENT) % CACHE_ALIGNMENT;
+    return fwrite(data, 1, size, fp) == size && fwrite(zeros, 1, padding, fp) == padding;
+}
+
+bool write_object(FILE *fp, const Object *obj) {
+    CacheObject header = {
+        .vertex_count = obj->vertices.length,
+        .color_count = obj->colors.length,
+        .index_count = obj->indices.length,
+    };
+
+    return write_block(fp, &header, sizeof(CacheObject)) &&
+           write_block(fp, obj->vertices.items, obj->vertices.length * sizeof(float)) &&
+           write_block(fp, obj->colors.items, obj->colors.length * sizeof(unsigned char)) &&
+           write_block(fp, obj->indices.items, obj->indices.length * sizeof(uint32_t));
+}
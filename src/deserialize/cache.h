@@ -0,0 +1,37 @@
+#ifndef PRINT3_DESERIALZE_CACHE_H_
+#define PRINT3_DESERIALZE_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../scene.h"
+
+// Identity of a source file when it is deserialized
+typedef struct CacheKey {
+    char *path;  // Absolute path
+    uint64_t size;
+    int64_t modification_seconds;
+    int64_t modification_nanoseconds;
+    Color fallback_color;
+} CacheKey;
+
+// NULL selects the default directory: $XDG_CACHE_HOME/print3, ~/.cache/print3 or %LOCALAPPDATA%\print3
+void cache_set_directory(const char *directory);
+void cache_set_enabled(bool enabled);
+
+// Remove all cache entries from the cache directory
+void cache_clear(void);
+
+// Take the key before reading the file, so a file modified during the deserialization is never cached as valid.
+// Returns false when caching is disabled or the file is not worth caching.
+bool cache_get_key(const char *filename, Color fallback_color, CacheKey *key);
+void cache_free_key(CacheKey *key);
+
+// Add the cached objects of the file to the scene. Returns false if there is no valid entry.
+bool cache_load(const CacheKey *key, Scene *scene);
+
+// Replace the entry of the file by the given objects
+void cache_store(const CacheKey *key, const Object *objects, size_t count);
+
+#endif
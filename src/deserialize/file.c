@@ -3,6 +3,17 @@
 #include <stdio.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../parallel.h"
+#include "../timer.h"
+#include "../trace.h"
+#include "cache.h"
 #include "memory.h"
 #include "obj.h"
 #include "off.h"
@@ -11,6 +22,11 @@
 
 #define EXTENSION_MAP_COUNT 7
 
+#define READ_CHUNK_SIZE (1 << 20)
+
+// Bytes at the beginning of a file which tell binary and text variants of a format apart
+#define FORMAT_PEEK_SIZE 16
+
 // Use array of key value pair and scan linearly for the entry
 // With many deserializers consider implementing a hash table
 struct {
@@ -22,50 +38,140 @@ struct {
 
 };
 
+// Content of a file in memory
+// The byte at buffer[size] is always a null termination character, so text deserializers can rely on it.
+typedef struct FileContent {
+    char *buffer;
+    size_t size;
+    size_t mapping_size;  // 0 when the buffer is heap allocated
+} FileContent;
+
+// Per file slot of a concurrent load
+typedef struct FileLoad {
+    const char **filenames;
+    Color fallback_color;
+    Scene *scenes;
+} FileLoad;
+
 static MemoryDeserializer get_deserializer(const char *filename);
+static void load_file_task(void *context, size_t index);
+static bool is_text_file(const char *filename, MemoryDeserializer deserializer);
+static void load_content(const char *filename, FileContent *content);
+static bool map_content(const char *filename, FileContent *content);
+static void read_content(const char *filename, FileContent *content);
+static void free_content(FileContent *content);
 
 void file_add_to_scene(const char *filename, Color fallback_color, Scene *scene) {
+    FileTiming timing;
+    file_add_to_scene_timed(filename, fallback_color, scene, &timing);
+}
+
+void file_add_to_scene_timed(const char *filename, Color fallback_color, Scene *scene, FileTiming *timing) {
     MemoryDeserializer deserializer = get_deserializer(filename);
+    *timing = (FileTiming){.triangulate = -1.0};
 
-    // Open the file
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) {
-        fprintf(stderr, "[ERR] Could not open file \"%s\".\n", filename);
-        exit(1);
+    // Reuse the objects of a previous deserialization if the file did not change since
+    double start = timer_now();
+    TRACE_BEGIN(lookup, "cache lookup");
+    size_t first_object = scene->objects.length;
+    CacheKey key;
+    bool cacheable = cache_get_key(filename, fallback_color, &key);
+    if (cacheable && !is_text_file(filename, deserializer)) {
+        cache_free_key(&key);
+        cacheable = false;
     }
-
-    // Get the file size
-    if (fseek(fp, 0, SEEK_END)) {
-        fprintf(stderr, "[ERR] Could seek end of file \"%s\".\n", filename);
-        exit(1);
+    if (cacheable && cache_load(&key, scene)) {
+        cache_free_key(&key);
+        timing->cache = timer_now() - start;
+        timing->cache_hit = true;
+        TRACE_COUNT(lookup, "triangles", scene_count_triangles(scene, first_object));
+        TRACE_END(lookup);
+        return;
     }
-    size_t size = ftell(fp);
-    if (fseek(fp, 0, SEEK_SET)) {
-        fprintf(stderr, "[ERR] Could seek beginning of file \"%s\".\n", filename);
-        exit(1);
+    timing->cache = timer_now() - start;
+    TRACE_END(lookup);
+
+    start = timer_now();
+    TRACE_BEGIN(read, "read");
+    FileContent content = {0};
+    load_content(filename, &content);
+    timing->read = timer_now() - start;
+    TRACE_COUNT(read, "bytes", content.size);
+    TRACE_END(read);
+
+    // Dispatch the deserializer
+    start = timer_now();
+    TRACE_BEGIN(parse, "parse");
+    DeserializerTiming stages = {.triangulate = -1.0};
+    deserializer(content.buffer, content.size, fallback_color, scene, &stages);
+    timing->triangulate = stages.triangulate;
+    timing->parse = timer_now() - start - (stages.triangulate > 0.0 ? stages.triangulate : 0.0);
+    TRACE_COUNT(parse, "bytes", content.size);
+    TRACE_COUNT(parse, "triangles", scene_count_triangles(scene, first_object));
+    TRACE_END(parse);
+
+    if (cacheable) {
+        start = timer_now();
+        TRACE_BEGIN(store, "cache store");
+        cache_store(&key, &scene->objects.items[first_object], scene->objects.length - first_object);
+        cache_free_key(&key);
+        timing->cache += timer_now() - start;
+        TRACE_END(store);
     }
 
-    // Create a buffer for the content + a null termination character.
-    static_assert(sizeof(char) == 1, "Unsupported platform. Size of char is not one byte.");
-    char *buffer = malloc(size + 1);
-    if (!buffer) {
-        fprintf(stderr, "[Err] Could not allocate a buffer of size %u.\n", size + 1);
-        exit(1);
+    // Free resources
+    free_content(&content);
+}
+
+void file_add_all_to_scene(const char **filenames, size_t count, Color fallback_color, Scene *scene) {
+    // Report unsupported extensions before any work is done
+    for (size_t i = 0; i < count; ++i) {
+        get_deserializer(filenames[i]);
     }
 
-    // Read the file into the buffer and add the null termination character.
-    if (fread(buffer, 1, size, fp) != size) {
-        fprintf(stderr, "[Err] Could read the content of file \"%s\".\n", filename);
-        exit(1);
+    // Every file is deserialized into its own scene
+    FileLoad load = {
+        .filenames = filenames,
+        .fallback_color = fallback_color,
+        .scenes = calloc(count, sizeof(Scene)),
+    };
+    assert((load.scenes || !count) && "Could not allocate the scenes of the files.");
+
+    TRACE_BEGIN(files, "load files");
+    parallel_for(count, load_file_task, &load);
+    TRACE_COUNT(files, "files", count);
+    TRACE_END(files);
+
+    // Move the objects in command line order so object indices do not depend on the scheduling
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t i_obj = 0; i_obj < load.scenes[i].objects.length; ++i_obj) {
+            da_add(scene->objects, load.scenes[i].objects.items[i_obj]);
+        }
+        free(load.scenes[i].objects.items);
     }
-    buffer[size] = '\0';
 
-    // Dispatch the deserializer
-    deserializer(buffer, size, fallback_color, scene);
+    free(load.scenes);
+}
 
-    // Free resources
-    free(buffer);
+void load_file_task(void *context, size_t index) {
+    FileLoad *load = context;
+    file_add_to_scene(load->filenames[index], load->fallback_color, &load->scenes[index]);
+}
+
+bool is_text_file(const char *filename, MemoryDeserializer deserializer) {
+    // Binary STL and PLY files are decoded about as fast as their cache entry is read, only text is worth caching
+    if (deserializer != stl_deserialize && deserializer != ply_deserialize) return true;
+
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return false;
+
+    char head[FORMAT_PEEK_SIZE + 1];
+    size_t size = fread(head, 1, FORMAT_PEEK_SIZE, fp);
+    head[size] = '\0';
     fclose(fp);
+
+    if (deserializer == stl_deserialize) return strncmp(head, "solid", 5) == 0;
+    return strncmp(head, "ply\nformat ascii", 16) == 0;
 }
 
 MemoryDeserializer get_deserializer(const char *filename) {
@@ -81,3 +187,117 @@ MemoryDeserializer get_deserializer(const char *filename) {
     fprintf(stderr, "[ERR] File extension \"%s\" of file \"%s\" is not supported.\n", extension, filename);
     exit(1);
 }
+
+void load_content(const char *filename, FileContent *content) {
+    // Regular files are mapped into memory, everything else (pipes, devices, ...) is read into a buffer
+    if (!map_content(filename, content)) {
+        read_content(filename, content);
+    }
+}
+
+#if defined(_WIN32)
+
+bool map_content(const char *filename, FileContent *content) { return false; }
+
+#else
+
+bool map_content(const char *filename, FileContent *content) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    // Reserve the file size rounded up to whole pages plus one extra zero page.
+    // The remainder of the last file page and the extra page read as zero,
+    // which provides the null termination without copying the file.
+    size_t size = info.st_size;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t mapping_size = (size + page_size - 1) / page_size * page_size + page_size;
+
+    void *reserved = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    // Private mapping: deserializers may write into the buffer without touching the file
+    void *mapped = mmap(reserved, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        munmap(reserved, mapping_size);
+        return false;
+    }
+
+    // Deserializers walk the buffer from front to back
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    content->buffer = mapped;
+    content->size = size;
+    content->mapping_size = mapping_size;
+    return true;
+}
+
+#endif
+
+void read_content(const char *filename, FileContent *content) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "[ERR] Could not open file \"%s\".\n", filename);
+        exit(1);
+    }
+
+    // The size of pipes and special files is unknown upfront, so read in chunks until the end of the stream
+    static_assert(sizeof(char) == 1, "Unsupported platform. Size of char is not one byte.");
+    size_t size = 0;
+    size_t capacity = 0;
+    char *buffer = NULL;
+    while (1) {
+        // Keep space for the null termination character
+        if (size + READ_CHUNK_SIZE + 1 > capacity) {
+            capacity = capacity ? 2 * capacity : READ_CHUNK_SIZE + 1;
+            buffer = realloc(buffer, capacity);
+            if (!buffer) {
+                fprintf(stderr, "[ERR] Could not allocate a buffer of size %zu.\n", capacity);
+                exit(1);
+            }
+        }
+
+        size_t n = fread(&buffer[size], 1, READ_CHUNK_SIZE, fp);
+        size += n;
+
+        if (n < READ_CHUNK_SIZE) {
+            break;
+        }
+    }
+
+    if (ferror(fp)) {
+        fprintf(stderr, "[ERR] Could not read the content of file \"%s\".\n", filename);
+        exit(1);
+    }
+    fclose(fp);
+
+    buffer[size] = '\0';
+
+    content->buffer = buffer;
+    content->size = size;
+    content->mapping_size = 0;
+}
+
+void free_content(FileContent *content) {
+#if !defined(_WIN32)
+    if (content->mapping_size) {
+        munmap(content->buffer, content->mapping_size);
+        *content = (FileContent){0};
+        return;
+    }
+#endif
+
+    free(content->buffer);
+    *content = (FileContent){0};
+}
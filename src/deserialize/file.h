@@ -5,4 +5,19 @@
 
 void file_add_to_scene(const char *filename, Color fallback_color, Scene *scene);
 
+// Seconds spent in the stages of loading a file
+typedef struct FileTiming {
+    double read;
+    double parse;        // Deserialization without a separate triangulation step
+    double triangulate;  // Negative for formats which triangulate while parsing
+    double cache;        // Loading the objects from the cache or storing them into it
+    bool cache_hit;
+} FileTiming;
+
+// Same as file_add_to_scene, but measures the stages of loading
+void file_add_to_scene_timed(const char *filename, Color fallback_color, Scene *scene, FileTiming *timing);
+
+// Deserialize the files concurrently and add their objects in the given order
+void file_add_all_to_scene(const char **filenames, size_t count, Color fallback_color, Scene *scene);
+
 #endif
@@ -5,6 +5,13 @@
 
 #include "../scene.h"
 
-typedef void (*MemoryDeserializer)(void *buffer, size_t size, Color fallback_color, Scene *scene);
+// Seconds spent in the stages a deserializer runs as separate steps, which keep their initial value otherwise
+typedef struct DeserializerTiming {
+    double triangulate;
+} DeserializerTiming;
+
+// The timing may be NULL
+typedef void (*MemoryDeserializer)(void *buffer, size_t size, Color fallback_color, Scene *scene,
+                                   DeserializerTiming *timing);
 
 #endif
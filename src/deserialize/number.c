@@ -0,0 +1,628 @@
+#include "number.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Decimal floating point numbers are converted with the Clinger fast path when mantissa and power of ten are
+// exactly representable and with the Eisel-Lemire algorithm otherwise.
+// Numbers with more than 19 significant digits close to a rounding boundary are compared digit by digit with the
+// halfway point between the two candidate floats in big integer arithmetic.
+// See Daniel Lemire, "Number Parsing at a Gigabyte per Second", Software: Practice and Experience 51 (8), 2021.
+
+#define MANTISSA_EXPLICIT_BITS 23
+#define MINIMUM_EXPONENT (-127)
+#define INFINITE_POWER 0xFF
+
+// Decimal exponents outside of this range are zero or infinity for every 19 digit mantissa
+#define SMALLEST_POWER_OF_TEN (-65)
+#define LARGEST_POWER_OF_TEN 38
+
+// Range of decimal exponents for which round to even needs special care
+#define MIN_EXPONENT_ROUND_TO_EVEN (-17)
+#define MAX_EXPONENT_ROUND_TO_EVEN 10
+
+// Clinger fast path: mantissa and power of ten are exact floats, so one float operation rounds correctly
+#define MAX_EXPONENT_FAST_PATH 10
+#define MAX_MANTISSA_FAST_PATH (UINT64_C(2) << MANTISSA_EXPLICIT_BITS)
+
+#define MAX_DIGITS 19
+#define MIN_NINETEEN_DIGIT_INTEGER UINT64_C(1000000000000000000)
+
+// The halfway point between two floats has at most 113 significant digits, later digits only break ties
+#define MAX_COMPARED_DIGITS 120
+
+// Bits of the largest number compared: the kept digits times the powers of two and five of a finite float
+#define BIG_INTEGER_LIMBS 40
+
+// Largest power of five which fits into a limb
+#define LIMB_POWER_OF_FIVE 13
+#define LIMB_FIVE_TO_THE_POWER 1220703125
+
+typedef struct Decimal {
+    uint64_t mantissa;
+    int64_t exponent;
+    bool negative;
+    bool too_many_digits;
+} Decimal;
+
+// Binary float as mantissa without the implicit bit and biased exponent
+typedef struct AdjustedMantissa {
+    uint64_t mantissa;
+    int32_t power2;
+} AdjustedMantissa;
+
+// Unsigned integer with 32 bit limbs, the least significant first
+typedef struct BigInteger {
+    uint32_t limbs[BIG_INTEGER_LIMBS];
+    size_t length;
+} BigInteger;
+
+static const float powers_of_ten_f32[MAX_EXPONENT_FAST_PATH + 1] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                                                    1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+// 128 bit approximations of 5^q for SMALLEST_POWER_OF_TEN <= q <= LARGEST_POWER_OF_TEN,
+// normalized so the most significant bit is set (high word first)
+static const uint64_t powers_of_five_128[LARGEST_POWER_OF_TEN - SMALLEST_POWER_OF_TEN + 1][2] = {
+    {0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL},  // 5^-65
+    {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL},  // 5^-64
+    {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL},  // 5^-63
+    {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL},  // 5^-62
+    {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL},  // 5^-61
+    {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL},  // 5^-60
+    {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL},  // 5^-59
+    {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL},  // 5^-58
+    {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL},  // 5^-57
+    {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL},  // 5^-56
+    {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL},  // 5^-55
+    {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL},  // 5^-54
+    {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL},  // 5^-53
+    {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL},  // 5^-52
+    {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL},  // 5^-51
+    {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL},  // 5^-50
+    {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL},  // 5^-49
+    {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL},  // 5^-48
+    {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL},  // 5^-47
+    {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL},  // 5^-46
+    {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL},  // 5^-45
+    {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL},  // 5^-44
+    {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL},  // 5^-43
+    {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL},  // 5^-42
+    {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL},  // 5^-41
+    {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL},  // 5^-40
+    {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL},  // 5^-39
+    {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL},  // 5^-38
+    {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL},  // 5^-37
+    {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL},  // 5^-36
+    {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL},  // 5^-35
+    {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL},  // 5^-34
+    {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL},  // 5^-33
+    {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL},  // 5^-32
+    {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL},  // 5^-31
+    {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL},  // 5^-30
+    {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL},  // 5^-29
+    {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL},  // 5^-28
+    {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL},  // 5^-27
+    {0xc612062576589ddaULL, 0x95364afe032a819eULL},  // 5^-26
+    {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL},  // 5^-25
+    {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL},  // 5^-24
+    {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL},  // 5^-23
+    {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL},  // 5^-22
+    {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL},  // 5^-21
+    {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL},  // 5^-20
+    {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL},  // 5^-19
+    {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL},  // 5^-18
+    {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL},  // 5^-17
+    {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL},  // 5^-16
+    {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL},  // 5^-15
+    {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL},  // 5^-14
+    {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL},  // 5^-13
+    {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL},  // 5^-12
+    {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL},  // 5^-11
+    {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL},  // 5^-10
+    {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL},  // 5^-9
+    {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL},  // 5^-8
+    {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL},  // 5^-7
+    {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL},  // 5^-6
+    {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL},  // 5^-5
+    {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL},  // 5^-4
+    {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL},  // 5^-3
+    {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL},  // 5^-2
+    {0xccccccccccccccccULL, 0xcccccccccccccccdULL},  // 5^-1
+    {0x8000000000000000ULL, 0x0000000000000000ULL},  // 5^0
+    {0xa000000000000000ULL, 0x0000000000000000ULL},  // 5^1
+    {0xc800000000000000ULL, 0x0000000000000000ULL},  // 5^2
+    {0xfa00000000000000ULL, 0x0000000000000000ULL},  // 5^3
+    {0x9c40000000000000ULL, 0x0000000000000000ULL},  // 5^4
+    {0xc350000000000000ULL, 0x0000000000000000ULL},  // 5^5
+    {0xf424000000000000ULL, 0x0000000000000000ULL},  // 5^6
+    {0x9896800000000000ULL, 0x0000000000000000ULL},  // 5^7
+    {0xbebc200000000000ULL, 0x0000000000000000ULL},  // 5^8
+    {0xee6b280000000000ULL, 0x0000000000000000ULL},  // 5^9
+    {0x9502f90000000000ULL, 0x0000000000000000ULL},  // 5^10
+    {0xba43b74000000000ULL, 0x0000000000000000ULL},  // 5^11
+    {0xe8d4a51000000000ULL, 0x0000000000000000ULL},  // 5^12
+    {0x9184e72a00000000ULL, 0x0000000000000000ULL},  // 5^13
+    {0xb5e620f480000000ULL, 0x0000000000000000ULL},  // 5^14
+    {0xe35fa931a0000000ULL, 0x0000000000000000ULL},  // 5^15
+    {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL},  // 5^16
+    {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL},  // 5^17
+    {0xde0b6b3a76400000ULL, 0x0000000000000000ULL},  // 5^18
+    {0x8ac7230489e80000ULL, 0x0000000000000000ULL},  // 5^19
+    {0xad78ebc5ac620000ULL, 0x0000000000000000ULL},  // 5^20
+    {0xd8d726b7177a8000ULL, 0x0000000000000000ULL},  // 5^21
+    {0x878678326eac9000ULL, 0x0000000000000000ULL},  // 5^22
+    {0xa968163f0a57b400ULL, 0x0000000000000000ULL},  // 5^23
+    {0xd3c21bcecceda100ULL, 0x0000000000000000ULL},  // 5^24
+    {0x84595161401484a0ULL, 0x0000000000000000ULL},  // 5^25
+    {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL},  // 5^26
+    {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL},  // 5^27
+    {0x813f3978f8940984ULL, 0x4000000000000000ULL},  // 5^28
+    {0xa18f07d736b90be5ULL, 0x5000000000000000ULL},  // 5^29
+    {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL},  // 5^30
+    {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL},  // 5^31
+    {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL},  // 5^32
+    {0xc5371912364ce305ULL, 0x6c28000000000000ULL},  // 5^33
+    {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL},  // 5^34
+    {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL},  // 5^35
+    {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL},  // 5^36
+    {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL},  // 5^37
+    {0x96769950b50d88f4ULL, 0x1314448000000000ULL},  // 5^38
+};
+
+static bool is_digit(char c);
+static bool is_space(char c);
+static const char *parse_special(const char *ptr, bool negative, float *value);
+static bool match_lower(const char *ptr, const char *lower);
+static AdjustedMantissa compute_float(int64_t q, uint64_t w);
+static uint64_t full_multiplication(uint64_t a, uint64_t b, uint64_t *high);
+static int leading_zeroes(uint64_t value);
+static float to_float(AdjustedMantissa am, bool negative);
+static AdjustedMantissa compare_digits(const char *begin, const char *end, int64_t explicit_exponent,
+                                       AdjustedMantissa lower);
+static void big_multiply_add(BigInteger *x, uint32_t factor, uint32_t addend);
+static void big_multiply_power_of_five(BigInteger *x, int64_t exponent);
+static void big_shift_left(BigInteger *x, int64_t bits);
+static int big_compare(const BigInteger *a, const BigInteger *b);
+
+float str_to_f32(const char *str, char **end) {
+    const char *ptr = str;
+    while (is_space(*ptr)) ++ptr;
+
+    Decimal decimal = {0};
+    if (*ptr == '-' || *ptr == '+') {
+        decimal.negative = *ptr == '-';
+        ++ptr;
+    }
+    const char *token = ptr;
+
+    // Integer part
+    const char *integer_begin = ptr;
+    uint64_t mantissa = 0;
+    while (is_digit(*ptr)) {
+        mantissa = 10 * mantissa + (uint64_t)(*ptr - '0');  // Overflow is handled below
+        ++ptr;
+    }
+    const char *integer_end = ptr;
+    int64_t digit_count = integer_end - integer_begin;
+
+    // Fraction part
+    const char *fraction_begin = NULL;
+    int64_t exponent = 0;
+    if (*ptr == '.') {
+        ++ptr;
+        fraction_begin = ptr;
+        while (is_digit(*ptr)) {
+            mantissa = 10 * mantissa + (uint64_t)(*ptr - '0');
+            ++ptr;
+        }
+        exponent = fraction_begin - ptr;
+        digit_count -= exponent;
+    }
+
+    // Without any digit only special values are left
+    if (digit_count == 0) {
+        float value;
+        const char *special_end = parse_special(token, decimal.negative, &value);
+        if (end) *end = (char *)(special_end ? special_end : str);
+        return special_end ? value : 0.0f;
+    }
+
+    // Exponent part, which is only consumed when it has digits
+    int64_t explicit_exponent = 0;
+    if (*ptr == 'e' || *ptr == 'E') {
+        const char *exponent_begin = ptr;
+        ++ptr;
+
+        bool negative_exponent = false;
+        if (*ptr == '-' || *ptr == '+') {
+            negative_exponent = *ptr == '-';
+            ++ptr;
+        }
+
+        if (is_digit(*ptr)) {
+            while (is_digit(*ptr)) {
+                if (explicit_exponent < 0x10000) explicit_exponent = 10 * explicit_exponent + (*ptr - '0');
+                ++ptr;
+            }
+            explicit_exponent = negative_exponent ? -explicit_exponent : explicit_exponent;
+            exponent += explicit_exponent;
+        } else {
+            ptr = exponent_begin;
+        }
+    }
+    const char *token_end = ptr;
+    if (end) *end = (char *)token_end;
+
+    // More than 19 digits (leading zeros do not count) do not fit into the mantissa,
+    // so keep the first 19 significant digits and remember the truncation
+    if (digit_count > MAX_DIGITS) {
+        for (const char *p = integer_begin; p != token_end && (*p == '0' || *p == '.'); ++p) {
+            if (*p == '0') --digit_count;
+        }
+
+        if (digit_count > MAX_DIGITS) {
+            decimal.too_many_digits = true;
+
+            mantissa = 0;
+            const char *p = integer_begin;
+            while (mantissa < MIN_NINETEEN_DIGIT_INTEGER && p != integer_end) {
+                mantissa = 10 * mantissa + (uint64_t)(*p - '0');
+                ++p;
+            }
+
+            if (mantissa >= MIN_NINETEEN_DIGIT_INTEGER) {
+                exponent = (integer_end - p) + explicit_exponent;
+            } else if (fraction_begin) {
+                p = fraction_begin;
+                while (mantissa < MIN_NINETEEN_DIGIT_INTEGER && is_digit(*p)) {
+                    mantissa = 10 * mantissa + (uint64_t)(*p - '0');
+                    ++p;
+                }
+                exponent = (fraction_begin - p) + explicit_exponent;
+            }
+        }
+    }
+
+    decimal.mantissa = mantissa;
+    decimal.exponent = exponent;
+
+    // Clinger fast path
+    if (!decimal.too_many_digits && decimal.mantissa <= MAX_MANTISSA_FAST_PATH &&
+        -MAX_EXPONENT_FAST_PATH <= decimal.exponent && decimal.exponent <= MAX_EXPONENT_FAST_PATH) {
+        float value = (float)decimal.mantissa;
+        if (decimal.exponent < 0) {
+            value = value / powers_of_ten_f32[-decimal.exponent];
+        } else {
+            value = value * powers_of_ten_f32[decimal.exponent];
+        }
+        return decimal.negative ? -value : value;
+    }
+
+    // Eisel-Lemire
+    AdjustedMantissa am = compute_float(decimal.exponent, decimal.mantissa);
+    if (decimal.too_many_digits) {
+        // The truncated digits are between w and w + 1, the result is only certain when both round the same way
+        AdjustedMantissa am_upper = compute_float(decimal.exponent, decimal.mantissa + 1);
+        if (am.mantissa != am_upper.mantissa || am.power2 != am_upper.power2) {
+            am = compare_digits(token, token_end, explicit_exponent, am);
+        }
+    }
+
+    return to_float(am, decimal.negative);
+}
+
+int64_t str_to_i64(const char *str, char **end) {
+    const char *ptr = str;
+    while (is_space(*ptr)) ++ptr;
+
+    bool negative = false;
+    if (*ptr == '-' || *ptr == '+') {
+        negative = *ptr == '-';
+        ++ptr;
+    }
+
+    if (!is_digit(*ptr)) {
+        if (end) *end = (char *)str;
+        return 0;
+    }
+
+    // Saturate like strtoll on overflow
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    uint64_t value = 0;
+    bool overflow = false;
+    for (; is_digit(*ptr); ++ptr) {
+        uint64_t digit = *ptr - '0';
+        if (value > (limit - digit) / 10) {
+            overflow = true;
+        } else {
+            value = 10 * value + digit;
+        }
+    }
+
+    if (end) *end = (char *)ptr;
+
+    if (overflow) value = limit;
+    return negative ? (int64_t)(0 - value) : (int64_t)value;
+}
+
+bool is_digit(char c) { return '0' <= c && c <= '9'; }
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+
+const char *parse_special(const char *ptr, bool negative, float *value) {
+    float sign = negative ? -1.0f : 1.0f;
+
+    if (match_lower(ptr, "infinity")) {
+        *value = sign * (float)INFINITY;
+        return ptr + 8;
+    }
+
+    if (match_lower(ptr, "inf")) {
+        *value = sign * (float)INFINITY;
+        return ptr + 3;
+    }
+
+    if (match_lower(ptr, "nan")) {
+        *value = sign * (float)NAN;
+        ptr += 3;
+
+        // Optional payload "nan(chars)"
+        if (*ptr == '(') {
+            const char *p = ptr + 1;
+            while (is_digit(*p) || ('a' <= *p && *p <= 'z') || ('A' <= *p && *p <= 'Z') || *p == '_') ++p;
+            if (*p == ')') ptr = p + 1;
+        }
+        return ptr;
+    }
+
+    return NULL;
+}
+
+bool match_lower(const char *ptr, const char *lower) {
+    for (; *lower; ++ptr, ++lower) {
+        char c = ('A' <= *ptr && *ptr <= 'Z') ? *ptr - 'A' + 'a' : *ptr;
+        if (c != *lower) return false;
+    }
+    return true;
+}
+
+AdjustedMantissa compute_float(int64_t q, uint64_t w) {
+    AdjustedMantissa answer = {0};
+
+    if (w == 0 || q < SMALLEST_POWER_OF_TEN) {
+        return answer;  // Zero
+    }
+
+    if (q > LARGEST_POWER_OF_TEN) {
+        answer.power2 = INFINITE_POWER;
+        return answer;
+    }
+
+    // Normalize the mantissa and multiply with the 128 bit approximation of 5^q
+    int lz = leading_zeroes(w);
+    w <<= lz;
+
+    const uint64_t *power_of_five = powers_of_five_128[q - SMALLEST_POWER_OF_TEN];
+    const uint64_t precision_mask = UINT64_MAX >> (MANTISSA_EXPLICIT_BITS + 3);
+
+    uint64_t high;
+    uint64_t low = full_multiplication(w, power_of_five[0], &high);
+    if ((high & precision_mask) == precision_mask) {
+        // Lower bits might carry into the significant bits, use the second half of the power
+        uint64_t second_high;
+        full_multiplication(w, power_of_five[1], &second_high);
+        low += second_high;
+        if (second_high > low) ++high;
+    }
+
+    int upperbit = (int)(high >> 63);
+    int shift = upperbit + 64 - MANTISSA_EXPLICIT_BITS - 3;
+    answer.mantissa = high >> shift;
+
+    // floor(log2(10^q)) = floor(q * log2(10)) + 63 with the fixed point approximation of log2(10)
+    int32_t power = (int32_t)((((152170 + 65536) * q) >> 16) + 63);
+    answer.power2 = power + upperbit - lz - MINIMUM_EXPONENT;
+
+    // Subnormal numbers
+    if (answer.power2 <= 0) {
+        if (-answer.power2 + 1 >= 64) {
+            answer.mantissa = 0;
+            answer.power2 = 0;
+            return answer;
+        }
+
+        answer.mantissa >>= -answer.power2 + 1;
+        answer.mantissa += answer.mantissa & 1;
+        answer.mantissa >>= 1;
+        answer.power2 = answer.mantissa < (UINT64_C(1) << MANTISSA_EXPLICIT_BITS) ? 0 : 1;
+        return answer;
+    }
+
+    // Exactly halfway between two floats: round to even instead of up
+    if (low <= 1 && q >= MIN_EXPONENT_ROUND_TO_EVEN && q <= MAX_EXPONENT_ROUND_TO_EVEN && (answer.mantissa & 3) == 1) {
+        if ((answer.mantissa << shift) == high) {
+            answer.mantissa &= ~UINT64_C(1);
+        }
+    }
+
+    answer.mantissa += answer.mantissa & 1;
+    answer.mantissa >>= 1;
+    if (answer.mantissa >= (UINT64_C(2) << MANTISSA_EXPLICIT_BITS)) {
+        answer.mantissa = UINT64_C(1) << MANTISSA_EXPLICIT_BITS;
+        ++answer.power2;
+    }
+
+    answer.mantissa &= ~(UINT64_C(1) << MANTISSA_EXPLICIT_BITS);
+    if (answer.power2 >= INFINITE_POWER) {
+        answer.power2 = INFINITE_POWER;
+        answer.mantissa = 0;
+    }
+
+    return answer;
+}
+
+uint64_t full_multiplication(uint64_t a, uint64_t b, uint64_t *high) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)a * b;
+    *high = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+#else
+    uint64_t a_low = a & 0xFFFFFFFF, a_high = a >> 32;
+    uint64_t b_low = b & 0xFFFFFFFF, b_high = b >> 32;
+
+    uint64_t low_low = a_low * b_low;
+    uint64_t low_high = a_low * b_high;
+    uint64_t high_low = a_high * b_low;
+    uint64_t high_high = a_high * b_high;
+
+    uint64_t middle = (low_low >> 32) + (low_high & 0xFFFFFFFF) + (high_low & 0xFFFFFFFF);
+    *high = high_high + (low_high >> 32) + (high_low >> 32) + (middle >> 32);
+    return (middle << 32) | (low_low & 0xFFFFFFFF);
+#endif
+}
+
+int leading_zeroes(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    while (!(value & (UINT64_C(1) << 63))) {
+        value <<= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+float to_float(AdjustedMantissa am, bool negative) {
+    uint32_t bits = (uint32_t)am.mantissa | (uint32_t)am.power2 << MANTISSA_EXPLICIT_BITS;
+    if (negative) bits |= UINT32_C(1) << 31;
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+AdjustedMantissa compare_digits(const char *begin, const char *end, int64_t explicit_exponent,
+                                AdjustedMantissa lower) {
+    // The number is digits * 10^exponent, dropped digits beyond MAX_COMPARED_DIGITS are only remembered as non zero
+    BigInteger digits = {0};
+    int64_t exponent = explicit_exponent;
+    size_t digit_count = 0;
+    bool is_fraction = false;
+    bool is_truncated = false;
+    for (const char *p = begin; p != end && *p != 'e' && *p != 'E'; ++p) {
+        if (*p == '.') {
+            is_fraction = true;
+            continue;
+        }
+
+        uint32_t digit = *p - '0';
+        if (digit_count < MAX_COMPARED_DIGITS) {
+            big_multiply_add(&digits, 10, digit);
+            if (digits.length) ++digit_count;  // Leading zeros are not significant
+            if (is_fraction) --exponent;
+        } else {
+            is_truncated = is_truncated || digit;
+            if (!is_fraction) ++exponent;
+        }
+    }
+
+    // A trailing 1 places truncated digits strictly between the kept digits and the next larger number
+    if (is_truncated) {
+        big_multiply_add(&digits, 10, 1);
+        --exponent;
+    }
+
+    // The halfway point between lower and the next float is (2 * mantissa + 1) * 2^(power - 1)
+    uint64_t mantissa = lower.mantissa;
+    int64_t power = 1 + MINIMUM_EXPONENT - MANTISSA_EXPLICIT_BITS;  // Subnormal
+    if (lower.power2) {
+        mantissa |= UINT64_C(1) << MANTISSA_EXPLICIT_BITS;
+        power = lower.power2 + MINIMUM_EXPONENT - MANTISSA_EXPLICIT_BITS;
+    }
+    BigInteger halfway = {0};
+    big_multiply_add(&halfway, 1, (uint32_t)(2 * mantissa + 1));
+    power -= 1;
+
+    // Compare digits * 5^exponent * 2^exponent with halfway * 2^power, moving the powers to the integral side
+    int64_t digits_power2 = 0;
+    if (exponent >= 0) {
+        big_multiply_power_of_five(&digits, exponent);
+        digits_power2 = exponent;
+    } else {
+        big_multiply_power_of_five(&halfway, -exponent);
+        power -= exponent;
+    }
+    if (digits_power2 > power) {
+        big_shift_left(&digits, digits_power2 - power);
+    } else {
+        big_shift_left(&halfway, power - digits_power2);
+    }
+
+    // Above halfway rounds up, exactly halfway rounds to the even mantissa
+    int order = big_compare(&digits, &halfway);
+    if (order < 0 || (order == 0 && !(lower.mantissa & 1))) return lower;
+
+    AdjustedMantissa upper = lower;
+    if (++upper.mantissa == (UINT64_C(1) << MANTISSA_EXPLICIT_BITS)) {
+        upper.mantissa = 0;
+        ++upper.power2;
+    }
+    return upper;
+}
+
+void big_multiply_add(BigInteger *x, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+    for (size_t i = 0; i < x->length; ++i) {
+        uint64_t product = (uint64_t)x->limbs[i] * factor + carry;
+        x->limbs[i] = (uint32_t)product;
+        carry = product >> 32;
+    }
+
+    if (carry) {
+        assert(x->length < BIG_INTEGER_LIMBS && "Big integer of the number parser overflows.");
+        x->limbs[x->length++] = (uint32_t)carry;
+    }
+}
+
+void big_multiply_power_of_five(BigInteger *x, int64_t exponent) {
+    for (; exponent >= LIMB_POWER_OF_FIVE; exponent -= LIMB_POWER_OF_FIVE) {
+        big_multiply_add(x, LIMB_FIVE_TO_THE_POWER, 0);
+    }
+
+    uint32_t factor = 1;
+    for (; exponent > 0; --exponent) factor *= 5;
+    big_multiply_add(x, factor, 0);
+}
+
+void big_shift_left(BigInteger *x, int64_t bits) {
+    if (!x->length) return;
+
+    size_t limb_shift = bits / 32;
+    unsigned bit_shift = bits % 32;
+    assert(x->length + limb_shift < BIG_INTEGER_LIMBS && "Big integer of the number parser overflows.");
+
+    // Shift from the most significant limb down, the new top limb takes the bits shifted out
+    x->limbs[x->length + limb_shift] = bit_shift ? x->limbs[x->length - 1] >> (32 - bit_shift) : 0;
+    for (size_t i = x->length; i-- > 0;) {
+        uint32_t below = i && bit_shift ? x->limbs[i - 1] >> (32 - bit_shift) : 0;
+        x->limbs[i + limb_shift] = x->limbs[i] << bit_shift | below;
+    }
+    memset(x->limbs, 0, limb_shift * sizeof(x->limbs[0]));
+
+    x->length += limb_shift + 1;
+    while (x->length && !x->limbs[x->length - 1]) --x->length;
+}
+
+int big_compare(const BigInteger *a, const BigInteger *b) {
+    if (a->length != b->length) return a->length < b->length ? -1 : 1;
+
+    for (size_t i = a->length; i-- > 0;) {
+        if (a->limbs[i] != b->limbs[i]) return a->limbs[i] < b->limbs[i] ? -1 : 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef PRINT3_DESERIALIZE_NUMBER_H_
+#define PRINT3_DESERIALIZE_NUMBER_H_
+
+#include <stdint.h>
+
+// Locale independent replacements for strtof and strtoll (base 10) used by the text deserializers.
+//
+// Both skip leading whitespace and set *end to the first character after the number,
+// or to str when no number is found (end may be NULL).
+//
+// Accepted floating point grammar (covers the numbers of STL, OBJ, OFF and PLY files):
+//   [+-] ( digits [. [digits]] | . digits ) [(e|E) [+-] digits]
+//   [+-] (inf | infinity | nan)  (case insensitive)
+//
+// The result is the correctly rounded float (round to nearest, ties to even) for any input.
+
+float str_to_f32(const char *str, char **end);
+int64_t str_to_i64(const char *str, char **end);
+
+#endif
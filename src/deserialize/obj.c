@@ -3,154 +3,403 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "../parallel.h"
+#include "../trace.h"
+#include "number.h"
 #include "parsing.h"
 #include "raymath.h"
 
+// Smallest chunk of the file that is parsed on its own
+#define MIN_CHUNK_SIZE (1 << 20)
+
+// Number of chunks per job to balance uneven chunks
+#define CHUNKS_PER_JOB 4
+
 typedef struct Floats {
     float *items;
     size_t length;
     size_t capacity;
 } Floats;
 
-static char *try_parse_vector(char *ptr, const char *identifier, Floats *vertices);
-static char *try_parse_face(char *ptr, const Floats *vertices, const Floats *normals, Color fallback_color, Object *object);
-static char *skip_remaining_line(char *ptr);
+typedef struct Corners {
+    size_t *items;
+    size_t length;
+    size_t capacity;
+} Corners;
+
+// Scratch space of one face, reused for every face of a chunk
+typedef struct Face {
+    Corners vertex_indices;
+    Corners normal_indices;
+    Corners triangles;  // 3 per triangle, positions within the face
+    size_t number;      // One based number of the face for error messages
+} Face;
+
+typedef enum LineKind {
+    LINE_OTHER = 0,
+    LINE_VERTEX,
+    LINE_NORMAL,
+    LINE_FACE,
+} LineKind;
+
+// Range of whole lines of the file. The counts of the records in the chunk are known after the first pass,
+// the offsets are the counts of all previous chunks.
+typedef struct Chunk {
+    char *begin;
+    char *end;
+    size_t vertex_count;
+    size_t normal_count;
+    size_t face_count;
+    size_t vertex_offset;
+    size_t normal_offset;
+    size_t face_offset;
+    Indices indices;  // Triangles of the faces in the chunk
+} Chunk;
+
+typedef struct Chunks {
+    Chunk *items;
+    size_t length;
+    Floats vertices;  // Vertices of all chunks, every chunk fills its own range
+    Floats normals;   // Normals of all chunks, every chunk fills its own range
+} Chunks;
+
+static void split_chunks(char *begin, char *end, Chunks *chunks);
+static void count_lines_task(void *context, size_t index);
+static void parse_vectors_task(void *context, size_t index);
+static void parse_faces_task(void *context, size_t index);
+static void concat_chunks(Chunks *chunks, Object *object);
+static LineKind line_kind(const char *ptr);
+static char *next_line(char *ptr, const char *end);
+static void parse_vector(char *ptr, const char *kind, size_t number, float *components);
+static void parse_face(char *ptr, const Chunks *chunks, size_t vertex_count, size_t normal_count, Face *face,
+                       Indices *indices);
+static size_t resolve_index(int64_t index, size_t count, const char *kind, size_t face);
+
+void obj_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene, DeserializerTiming *timing) {
+    Chunks chunks = {0};
+    split_chunks(buffer, (char *)buffer + size, &chunks);
+
+    // First pass: count the records of every chunk, their prefix sums place the chunks in the shared arrays
+    TRACE_BEGIN(count, "obj count lines");
+    parallel_for(chunks.length, count_lines_task, &chunks);
+    TRACE_COUNT(count, "bytes", size);
+    TRACE_END(count);
+
+    size_t vertex_count = 0;
+    size_t normal_count = 0;
+    size_t face_count = 0;
+    for (size_t i = 0; i < chunks.length; ++i) {
+        Chunk *chunk = &chunks.items[i];
+        chunk->vertex_offset = vertex_count;
+        chunk->normal_offset = normal_count;
+        chunk->face_offset = face_count;
+        vertex_count += chunk->vertex_count;
+        normal_count += chunk->normal_count;
+        face_count += chunk->face_count;
+    }
 
-void obj_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene) {
-    char *ptr = buffer;
-    char *peak;
+    da_reserve(chunks.vertices, 3 * vertex_count);
+    da_reserve(chunks.normals, 3 * normal_count);
+    chunks.vertices.length = 3 * vertex_count;
+    chunks.normals.length = 3 * normal_count;
 
-    Floats vertices = {0};
-    Floats normals = {0};
+    // Second pass: fill the vertices and normals, then the faces, which may refer to the vertices of every
+    // previous chunk and therefore wait until all of them are known
+    TRACE_BEGIN(vectors, "obj parse vectors");
+    parallel_for(chunks.length, parse_vectors_task, &chunks);
+    TRACE_COUNT(vectors, "vertices", vertex_count);
+    TRACE_COUNT(vectors, "normals", normal_count);
+    TRACE_END(vectors);
+
+    TRACE_BEGIN(faces, "obj parse faces");
+    parallel_for(chunks.length, parse_faces_task, &chunks);
+    TRACE_COUNT(faces, "faces", face_count);
+    TRACE_END(faces);
 
     Object object = {0};
+    TRACE_BEGIN(concat, "obj concat chunks");
+    concat_chunks(&chunks, &object);
+    TRACE_COUNT(concat, "triangles", object.indices.length / 3);
+    TRACE_END(concat);
+    free(chunks.items);
+
+    // The object takes over the vertices, which are only kept when there are faces referring to them
+    if (object.indices.length) {
+        object.vertices = (Vertices){chunks.vertices.items, chunks.vertices.length, chunks.vertices.capacity};
+
+        // Use the fallback color since .obj does not hold color information
+        da_reserve(object.colors, 4 * vertex_count);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            da_add_color(object.colors, fallback_color);
+        }
+    } else {
+        free(chunks.vertices.items);
+    }
+    free(chunks.normals.items);
+
+    da_add(scene->objects, object);
+}
+
+void split_chunks(char *begin, char *end, Chunks *chunks) {
+    size_t size = end - begin;
+
+    size_t chunk_count = CHUNKS_PER_JOB * parallel_get_job_count();
+    if (chunk_count > size / MIN_CHUNK_SIZE) chunk_count = size / MIN_CHUNK_SIZE;
+    if (chunk_count < 1) chunk_count = 1;
+
+    chunks->items = calloc(chunk_count, sizeof(Chunk));
+    assert(chunks->items && "Could not allocate the chunks of the obj file.");
+    chunks->length = chunk_count;
 
-    while (*ptr) {
-        peak = try_parse_vector(ptr, "v ", &vertices);
+    // Every record is given in a line of its own, so a chunk starting at a line holds whole records
+    chunks->items[0].begin = begin;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        char *ptr = begin + size * i / chunk_count;
+        if (ptr < chunks->items[i - 1].begin) ptr = chunks->items[i - 1].begin;
+
+        char *line_end = memchr(ptr, '\n', end - ptr);
+        chunks->items[i].begin = line_end ? line_end + 1 : end;
+        chunks->items[i - 1].end = chunks->items[i].begin;
+    }
+    chunks->items[chunk_count - 1].end = end;
+}
 
-        if (peak == ptr) {
-            peak = try_parse_vector(ptr, "vn ", &normals);
+void count_lines_task(void *context, size_t index) {
+    Chunk *chunk = &((Chunks *)context)->items[index];
+
+    for (char *ptr = chunk->begin; ptr < chunk->end; ptr = next_line(ptr, chunk->end)) {
+        switch (line_kind(ptr)) {
+            case LINE_VERTEX:
+                ++chunk->vertex_count;
+                break;
+            case LINE_NORMAL:
+                ++chunk->normal_count;
+                break;
+            case LINE_FACE:
+                ++chunk->face_count;
+                break;
+            case LINE_OTHER:
+                break;
         }
+    }
+}
 
-        if (peak == ptr) {
-            peak = try_parse_face(ptr, &vertices, &normals, fallback_color, &object);
+void parse_vectors_task(void *context, size_t index) {
+    Chunks *chunks = context;
+    Chunk *chunk = &chunks->items[index];
+
+    TRACE_BEGIN(parse, "obj parse vector chunk");
+    size_t vertex_index = chunk->vertex_offset;
+    size_t normal_index = chunk->normal_offset;
+    for (char *ptr = chunk->begin; ptr < chunk->end; ptr = next_line(ptr, chunk->end)) {
+        LineKind kind = line_kind(ptr);
+        if (kind == LINE_VERTEX) {
+            parse_vector(ptr + 2, "vertex", vertex_index + 1, &chunks->vertices.items[3 * vertex_index]);
+            ++vertex_index;
+        } else if (kind == LINE_NORMAL) {
+            parse_vector(ptr + 3, "normal", normal_index + 1, &chunks->normals.items[3 * normal_index]);
+            ++normal_index;
         }
+    }
+    TRACE_COUNT(parse, "bytes", chunk->end - chunk->begin);
+    TRACE_END(parse);
+}
 
-        ptr = skip_remaining_line(peak);
+void parse_faces_task(void *context, size_t index) {
+    Chunks *chunks = context;
+    Chunk *chunk = &chunks->items[index];
+
+    // Negative indices count back from the vertices and normals read before the face
+    size_t vertex_count = chunk->vertex_offset;
+    size_t normal_count = chunk->normal_offset;
+
+    TRACE_BEGIN(parse, "obj parse face chunk");
+    Face face = {.number = chunk->face_offset};
+    da_reserve(chunk->indices, 3 * chunk->face_count);
+
+    for (char *ptr = chunk->begin; ptr < chunk->end; ptr = next_line(ptr, chunk->end)) {
+        switch (line_kind(ptr)) {
+            case LINE_VERTEX:
+                ++vertex_count;
+                break;
+            case LINE_NORMAL:
+                ++normal_count;
+                break;
+            case LINE_FACE:
+                parse_face(ptr, chunks, vertex_count, normal_count, &face, &chunk->indices);
+                break;
+            case LINE_OTHER:
+                break;
+        }
     }
 
-    da_add(scene->objects, object);
+    free(face.vertex_indices.items);
+    free(face.normal_indices.items);
+    free(face.triangles.items);
+    TRACE_COUNT(parse, "bytes", chunk->end - chunk->begin);
+    TRACE_COUNT(parse, "triangles", chunk->indices.length / 3);
+    TRACE_END(parse);
 }
 
-char *try_parse_vector(char *ptr, const char *identifier, Floats *vertices) {
-    size_t identifier_length = strlen(identifier);
-    if (strncmp(ptr, identifier, identifier_length)) {
-        return ptr;
+void concat_chunks(Chunks *chunks, Object *object) {
+    // A single chunk is taken over without copying
+    if (chunks->length == 1) {
+        object->indices = chunks->items[0].indices;
+        return;
     }
 
-    // Skip the prefix
-    ptr += identifier_length;
+    size_t index_count = 0;
+    for (size_t i = 0; i < chunks->length; ++i) {
+        index_count += chunks->items[i].indices.length;
+    }
+    da_reserve(object->indices, index_count);
+
+    for (size_t i = 0; i < chunks->length; ++i) {
+        const Chunk *chunk = &chunks->items[i];
+        memcpy(&object->indices.items[object->indices.length], chunk->indices.items,
+               chunk->indices.length * sizeof(object->indices.items[0]));
+        object->indices.length += chunk->indices.length;
+        free(chunk->indices.items);
+    }
+}
 
+LineKind line_kind(const char *ptr) {
+    if (ptr[0] == 'v' && ptr[1] == ' ') return LINE_VERTEX;
+    if (ptr[0] == 'v' && ptr[1] == 'n' && ptr[2] == ' ') return LINE_NORMAL;
+    if (ptr[0] == 'f' && ptr[1] == ' ') return LINE_FACE;
+    return LINE_OTHER;
+}
+
+char *next_line(char *ptr, const char *end) {
+    char *line_end = memchr(ptr, '\n', end - ptr);
+    return line_end ? line_end + 1 : (char *)end;
+}
+
+void parse_vector(char *ptr, const char *kind, size_t number, float *components) {
     // Parse the 3 components
     char *peak;
-    float components[3];
     for (int i = 0; i < 3; ++i) {
-        components[i] = strtof(ptr, &peak);
-        advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th component of the %d-th vertex must be a float.\n", i + 1,
-                       vertices->length + i + 1);
+        components[i] = str_to_f32(ptr, &peak);
+        advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th component of the %zu-th %s must be a float.\n", i + 1,
+                       number, kind);
     }
 
     // Parse the optional homongenous component
-    float homogenous = strtof(ptr, &peak);
+    float homogenous = str_to_f32(ptr, &peak);
     if (ptr == peak) {
         homogenous = 1.0f;
-    } else {
-        ptr = peak;
     }
 
-    // Transform into carthesian coordinates and add the vertices
+    // Transform into carthesian coordinates
     for (int i = 0; i < 3; ++i) {
         components[i] /= homogenous;
-        da_add(*vertices, components[i]);
     }
-
-    return ptr;
 }
 
-char *try_parse_face(char *ptr, const Floats *vertices, const Floats *normals, Color fallback_color, Object *object) {
-    if (strncmp(ptr, "f ", 2)) {
-        return ptr;
-    }
-
+void parse_face(char *ptr, const Chunks *chunks, size_t vertex_count, size_t normal_count, Face *face,
+                Indices *indices) {
     // Skip the prefix
     ptr += 2;
 
-    // Parse the indices of the face
+    // Parse the indices of every corner until the end of the line
     char *peak;
-    bool has_normal = false;
-    size_t vertex_indices[3];
-    size_t normal_indices[3];
-    for (int i = 0; i < 3; ++i) {
-        vertex_indices[i] = strtoll(ptr, &peak, 10) - 1;  // One based indexing
-        advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th vertex index of the %d-th face must be number.\n", i + 1,
-                       object->vertices.length / 9 + 1);
-
-        // Get texture component
-        if (*ptr == '/' && ptr[1] != '/') {
+    size_t face_number = ++face->number;
+    face->vertex_indices.length = 0;
+    face->normal_indices.length = 0;
+    while (true) {
+        while (*ptr == ' ' || *ptr == '\t') ++ptr;
+        if (*ptr != '-' && *ptr != '+' && (*ptr < '0' || *ptr > '9')) break;
+
+        size_t i = face->vertex_indices.length;
+        int64_t vertex_index = str_to_i64(ptr, &peak);
+        advance_or_err(ptr, peak, "[ERR] Invalid format. %zu-th vertex index of the %zu-th face must be number.\n",
+                       i + 1, face_number);
+        da_add(face->vertex_indices, resolve_index(vertex_index, vertex_count, "vertex", face_number));
+
+        // Get texture component, which is empty in v//n
+        if (*ptr == '/') {
             ++ptr;
-            strtoll(ptr, &peak, 10);
-            advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th texture index of the %d-th face must be number.\n", i + 1,
-                           object->vertices.length / 9 + 1);
+            if (*ptr != '/') {
+                str_to_i64(ptr, &peak);
+                advance_or_err(ptr, peak,
+                               "[ERR] Invalid format. %zu-th texture index of the %zu-th face must be number.\n", i + 1,
+                               face_number);
+            }
         }
 
         // Get normal component
         if (*ptr == '/') {
             ++ptr;
-            has_normal = true;
-            normal_indices[i] = strtoll(ptr, &peak, 10) - 1;  // One based indexing
-            advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th normal index of the %d-th face must be number.\n", i + 1,
-                           object->vertices.length / 9 + 1);
+            int64_t normal_index = str_to_i64(ptr, &peak);
+            advance_or_err(ptr, peak, "[ERR] Invalid format. %zu-th normal index of the %zu-th face must be number.\n",
+                           i + 1, face_number);
+            da_add(face->normal_indices, resolve_index(normal_index, normal_count, "normal", face_number));
         }
     }
 
-    // Extract the vertex vectors from the buffer
-    Vector3 v1 = vector3_at(vertices->items, vertex_indices[0]);
-    Vector3 v2 = vector3_at(vertices->items, vertex_indices[1]);
-    Vector3 v3 = vector3_at(vertices->items, vertex_indices[2]);
+    size_t corner_count = face->vertex_indices.length;
+    if (corner_count < 3) {
+        fprintf(stderr, "[ERR] Invalid format. %zu-th face has %zu vertices but at least 3 are needed.\n", face_number,
+                corner_count);
+        exit(1);
+    }
 
-    // Consider the normals for vertex ordering
-    if (has_normal) {
-        Vector3 n1 = vector3_at(normals->items, normal_indices[0]);
-        Vector3 n2 = vector3_at(normals->items, normal_indices[1]);
-        Vector3 n3 = vector3_at(normals->items, normal_indices[2]);
+    // Normals are only considered if every corner has one
+    bool has_normal = face->normal_indices.length == corner_count;
 
-        Vector3 normal = Vector3Scale(Vector3Add(n1, Vector3Add(n2, n3)), 1.0f / 3.0f);
+    const float *vertices = chunks->vertices.items;
+    const float *normals = chunks->normals.items;
+    const size_t *vertex_indices = face->vertex_indices.items;
+    const size_t *normal_indices = face->normal_indices.items;
 
-        order_vertices(&normal, &v1, &v2, &v3);
-    }
+    size_t triangle_count = corner_count - 2;
+    da_reserve(face->triangles, 3 * triangle_count);
+    triangulate_polygon(vertices, vertex_indices, corner_count, face->triangles.items);
+    da_reserve(*indices, indices->length + 3 * triangle_count);
 
-    // Add the vertices of the face
-    da_add_vector3(object->vertices, v1);
-    da_add_vector3(object->vertices, v2);
-    da_add_vector3(object->vertices, v3);
+    for (size_t i_triangle = 0; i_triangle < triangle_count; ++i_triangle) {
+        const size_t *corners = &face->triangles.items[3 * i_triangle];
+        size_t triangle[3] = {vertex_indices[corners[0]], vertex_indices[corners[1]], vertex_indices[corners[2]]};
 
-    // Use the fallback color since .obj does not hold color information
-    da_add_color(object->colors, fallback_color);
-    da_add_color(object->colors, fallback_color);
-    da_add_color(object->colors, fallback_color);
+        // Consider the normals for vertex ordering
+        if (has_normal) {
+            Vector3 v1 = vector3_at(vertices, triangle[0]);
+            Vector3 v2 = vector3_at(vertices, triangle[1]);
+            Vector3 v3 = vector3_at(vertices, triangle[2]);
 
-    return ptr;
-}
+            Vector3 n1 = vector3_at(normals, normal_indices[corners[0]]);
+            Vector3 n2 = vector3_at(normals, normal_indices[corners[1]]);
+            Vector3 n3 = vector3_at(normals, normal_indices[corners[2]]);
+
+            Vector3 normal = Vector3Scale(Vector3Add(n1, Vector3Add(n2, n3)), 1.0f / 3.0f);
 
-char *skip_remaining_line(char *ptr) {
-    while (*ptr) {
-        // get first character in the next line
-        if (*ptr == '\n') {
-            return ptr + 1;
+            if (order_vertices(&normal, &v1, &v2, &v3)) {
+                size_t temp = triangle[1];
+                triangle[1] = triangle[2];
+                triangle[2] = temp;
+            }
         }
 
-        ++ptr;
+        // Add the triangle
+        da_add3(*indices, triangle[0], triangle[1], triangle[2]);
     }
+}
 
-    return ptr;
-}
\ No newline at end of file
+size_t resolve_index(int64_t index, size_t count, const char *kind, size_t face) {
+    // One based indexing, negative indices count back from the last element read so far
+    int64_t resolved = index > 0 ? index - 1 : (int64_t)count + index;
+
+    if (index == 0 || resolved < 0 || (size_t)resolved >= count) {
+        fprintf(stderr, "[ERR] Invalid format. %zu-th face refers to %s %lld but only %zu are defined before.\n", face, kind,
+                (long long)index, count);
+        exit(1);
+    }
+
+    if (resolved > UINT32_MAX) {
+        fprintf(stderr, "[ERR] Unsupported data. %zu-th face refers to %s %lld but at most %u are supported.\n", face, kind,
+                (long long)index, UINT32_MAX);
+        exit(1);
+    }
+
+    return resolved;
+}
@@ -4,9 +4,25 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "../parallel.h"
+#include "../timer.h"
+#include "../trace.h"
+#include "number.h"
 #include "parsing.h"
 #include "raymath.h"
 
+// Smallest block of the face region that is parsed on its own
+#define FACE_MIN_BLOCK_SIZE (1 << 20)
+
+// Number of face blocks per job to balance uneven blocks
+#define FACE_BLOCKS_PER_JOB 4
+
+// Shortest line of a face, like "3 0 1 2\n"
+#define MIN_FACE_BYTES 8
+
+// Shortest number with its separator, like "0 "
+#define MIN_NUMBER_BYTES 2
+
 typedef struct Header {
     bool use_texture_coordinates;    // "ST" flag
     bool use_colors;                 // "C" flag
@@ -25,35 +41,118 @@ typedef struct Normals {
     size_t capacity;
 } Normals;
 
+// Vertex indices of the face being parsed, the storage is reused for all faces of a block
+typedef struct FaceIndices {
+    size_t *items;
+    size_t length;
+    size_t capacity;
+} FaceIndices;
+
+// Range of lines of the face region, which is parsed independently from the others
+typedef struct FaceBlock {
+    char *begin;
+    char *end;
+    size_t face_count;
+    Indices indices;
+    Colors corner_colors;  // Only filled from the first face with its own color on
+    bool use_corner_colors;
+} FaceBlock;
+
+typedef struct FaceBlocks {
+    FaceBlock *items;
+    size_t length;
+    const char *file;  // Beginning of the file to report line numbers
+    const Header *header;
+    const Vertices *vertices;
+    const Colors *colors;
+    const Normals *normals;
+} FaceBlocks;
+
+// Report the line of a face, the line number is only counted in case of an error
+#define face_advance_or_err(ptr, peak, file, ...)                                                       \
+    do {                                                                                                \
+        if ((peak) == (ptr)) {                                                                          \
+            fprintf(stderr, "[ERR] Invalid format. The face in line %zu ", line_number((file), (ptr))); \
+            fprintf(stderr, __VA_ARGS__);                                                               \
+            exit(1);                                                                                    \
+        }                                                                                               \
+        (ptr) = (peak);                                                                                 \
+    } while (0)
+
 static char *parse_header(char *ptr, Header *header);
-static char *parse_vertices(char *ptr, const Header *header, Vertices *vertices, Colors *colors, Normals *normals);
-static char *parse_faces(char *ptr, Color fallback_color, const Header *header, const Vertices *vertices,
-                         const Colors *colors, const Normals *normals, Object *object);
+static char *parse_vertices(char *ptr, const char *end, const Header *header, Vertices *vertices, Colors *colors,
+                            Normals *normals);
+static void parse_faces(FaceBlocks *blocks, char *begin, char *end, Object *object, Colors *corner_colors);
+static void split_face_blocks(char *begin, char *end, FaceBlocks *blocks);
+static void parse_face_block_task(void *context, size_t index);
+static void parse_face_block(const FaceBlocks *blocks, FaceBlock *block);
+static bool parse_face_color(const char *file, char **ptr, unsigned char color[4]);
+static void add_face_triangles(const FaceBlocks *blocks, const FaceIndices *face, const unsigned char *face_color,
+                               FaceIndices *corners, FaceBlock *block);
+static void concat_face_blocks(const FaceBlocks *blocks, Object *object, Colors *corner_colors);
+static void expand_to_triangle_soup(Object *object, Colors *corner_colors);
 static char *next_token(char *ptr);
-static bool has_numeric_in_line(const char *ptr);
-static bool has_float_in_line(const char *ptr);
+static char *skip_line(char *ptr);
+static bool is_number_in_line(const char *ptr);
+static size_t line_number(const char *file, const char *ptr);
 
-void off_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene) {
+void off_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene, DeserializerTiming *timing) {
     char *ptr = buffer;
 
     Header header = {0};
     ptr = parse_header(ptr, &header);
     if (header.use_n_dimensions && header.n_dimensions >= 4) {
-        fprintf(stderr, "[ERR] Unsupported. nOff with n = %d is given. Only n < 4 is supported.\n");
+        fprintf(stderr, "[ERR] Unsupported. nOff with n = %ld is given. Only n < 4 is supported.\n",
+                header.n_dimensions);
+        exit(1);
+    }
+
+    if (header.n_vertices < 0 || header.n_faces < 0) {
+        fprintf(stderr, "[ERR] Invalid format. Negative vertex or face count in the header.\n");
         exit(1);
     }
 
     Vertices vertices = {0};
     Colors colors = {0};
     Normals normals = {0};
-    ptr = parse_vertices(ptr, &header, &vertices, &colors, &normals);
+    TRACE_BEGIN(parse_vertices_scope, "off parse vertices");
+    ptr = parse_vertices(ptr, (char *)buffer + size, &header, &vertices, &colors, &normals);
+    TRACE_COUNT(parse_vertices_scope, "vertices", vertices.length / 3);
+    TRACE_END(parse_vertices_scope);
+
+    // Every vertex has a color, use the fallback color when the file has none
+    if (!header.use_colors) {
+        for (size_t i = 0; i < vertices.length / 3; ++i) {
+            da_add_color(colors, fallback_color);
+        }
+    }
 
+    // Faces refer to the vertices by index, unless a face has its own color
     Object object = {0};
-    ptr = parse_faces(ptr, fallback_color, &header, &vertices, &colors, &normals, &object);
-
-    if (*ptr) {
-        fprintf(stderr, "[ERR] Invalid format. Expected end of file after the %d-th face.\n", header.n_faces);
-        exit(1);
+    Colors corner_colors = {0};
+    FaceBlocks blocks = {
+        .file = buffer, .header = &header, .vertices = &vertices, .colors = &colors, .normals = &normals};
+    TRACE_BEGIN(parse_faces_scope, "off parse faces");
+    parse_faces(&blocks, ptr, (char *)buffer + size, &object, &corner_colors);
+    TRACE_COUNT(parse_faces_scope, "bytes", (char *)buffer + size - ptr);
+    TRACE_COUNT(parse_faces_scope, "triangles", object.indices.length / 3);
+    TRACE_END(parse_faces_scope);
+    free(normals.items);
+
+    object.vertices = vertices;
+    object.colors = colors;
+    if (corner_colors.length) {
+        // Polygons are split while parsing the faces, only giving the triangles their face colors is a step of its own
+        double start = timer_now();
+        TRACE_BEGIN(expand, "off expand to triangle soup");
+        expand_to_triangle_soup(&object, &corner_colors);
+        TRACE_END(expand);
+        if (timing) timing->triangulate = timer_now() - start;
+    } else if (!object.indices.length) {
+        // Only keep vertices when there are faces referring to them
+        free(object.vertices.items);
+        free(object.colors.items);
+        object = (Object){0};
     }
 
     da_add(scene->objects, object);
@@ -100,45 +199,45 @@ char *parse_header(char *ptr, Header *header) {
 
     char *peak;
     if (header->use_n_dimensions) {
-        header->n_dimensions = strtol(ptr, &peak, 10);
+        header->n_dimensions = str_to_i64(ptr, &peak);
         advance_or_err(ptr, peak, "[ERR] Invalid format. nOFF needs a dimension as first value.\n");
         ptr = next_token(peak);
     }
 
-    header->n_vertices = strtol(ptr, &peak, 10);
+    header->n_vertices = str_to_i64(ptr, &peak);
     advance_or_err(ptr, peak, "[ERR] Invalid format. No vertex count.\n");
     ptr = next_token(ptr);
 
-    header->n_faces = strtol(ptr, &peak, 10);
+    header->n_faces = str_to_i64(ptr, &peak);
     advance_or_err(ptr, peak, "[ERR] Invalid format. No face count.\n");
     ptr = next_token(ptr);
 
-    header->n_edges = strtol(ptr, &peak, 10);
+    header->n_edges = str_to_i64(ptr, &peak);
     advance_or_err(ptr, peak, "[ERR] Invalid format. No edge count.\n");
     ptr = next_token(ptr);
 
     return ptr;
 }
 
-#define parse_vector3_err(da, dims, ...)                                                            \
-    do {                                                                                            \
-        for (size_t parse_vector3_err_i = 0; parse_vector3_err_i < (dims); ++parse_vector3_err_i) { \
-            da_add(da, strtof(ptr, &peak));                                                         \
-            advance_or_err(ptr, peak, __VA_ARGS__);                                                 \
-        }                                                                                           \
-        for (size_t parse_vector3_err_i = (dims); parse_vector3_err_i < 3; ++parse_vector3_err_i) { \
-            da_add(da, 0.0f);                                                                       \
-        }                                                                                           \
-    } while (0)
-
-char *parse_vertices(char *ptr, const Header *header, Vertices *vertices, Colors *colors, Normals *normals) {
+char *parse_vertices(char *ptr, const char *end, const Header *header, Vertices *vertices, Colors *colors,
+                     Normals *normals) {
     char *peak;
     size_t vertex_dimensions = header->use_n_dimensions ? header->n_dimensions : 3;
 
+    // The counts are known from the header, so the arrays never grow while parsing.
+    // The vertex count of the header is not trusted beyond what the remaining bytes can hold.
+    size_t reserved_count = (size_t)header->n_vertices;
+    size_t max_vertex_count = (end - ptr) / (vertex_dimensions ? MIN_NUMBER_BYTES * vertex_dimensions : 1) + 1;
+    if (reserved_count > max_vertex_count) reserved_count = max_vertex_count;
+
+    da_reserve(*vertices, 3 * reserved_count);
+    da_reserve(*colors, 4 * reserved_count);
+    if (header->use_normals) da_reserve(*normals, 3 * reserved_count);
+
     for (size_t i_vertex = 0; i_vertex < header->n_vertices; ++i_vertex) {
         // Parse the vertex coordinates
         for (size_t i_dimension = 0; i_dimension < vertex_dimensions; ++i_dimension) {
-            float vertex_component = strtof(ptr, &peak);
+            float vertex_component = str_to_f32(ptr, &peak);
             advance_or_err(ptr, peak,
                            "[ERR] Invalid format. %d-th component of the %d-th vertex must be a floating point number.\n",
                            i_dimension + 1, i_vertex + 1);
@@ -149,7 +248,7 @@ char *parse_vertices(char *ptr, const Header *header, Vertices *vertices, Colors
 
         // Transform homogenous coordinates to cathesian coordinates if needed
         if (header->use_homogeneous_component) {
-            float homogeneous_component = strtof(ptr, &peak);
+            float homogeneous_component = str_to_f32(ptr, &peak);
             advance_or_err(
                 ptr, peak,
                 "[ERR] Invalid format. Homongeneous component of the %d-th vertex must be a floating point number.\n",
@@ -163,7 +262,7 @@ char *parse_vertices(char *ptr, const Header *header, Vertices *vertices, Colors
         // parse normals if present
         if (header->use_normals) {
             for (size_t i_dimension = 0; i_dimension < vertex_dimensions; ++i_dimension) {
-                float normal_component = strtof(ptr, &peak);
+                float normal_component = str_to_f32(ptr, &peak);
                 advance_or_err(
                     ptr, peak,
                     "[ERR] Invalid format. %d-th component of the %d-th vertex's normal must be a floating point number.\n",
@@ -179,7 +278,7 @@ char *parse_vertices(char *ptr, const Header *header, Vertices *vertices, Colors
         // Parse colors if present
         if (header->use_colors) {
             for (size_t i_color = 0; i_color < 4; ++i_color) {
-                unsigned char color_component = strtol(ptr, &peak, 10);
+                unsigned char color_component = str_to_i64(ptr, &peak);
                 advance_or_err(ptr, peak,
                                "[ERR] Invalid format. %d-th color component of the %d-th vertex must be a byte.\n",
                                i_color + 1, i_vertex + 1);
@@ -201,102 +300,283 @@ char *parse_vertices(char *ptr, const Header *header, Vertices *vertices, Colors
     return ptr;
 }
 
-char *parse_faces(char *ptr, Color fallback_color, const Header *header, const Vertices *vertices, const Colors *colors,
-                  const Normals *normals, Object *object) {
+void parse_faces(FaceBlocks *blocks, char *begin, char *end, Object *object, Colors *corner_colors) {
+    // The face region is split at line boundaries and the blocks are parsed concurrently
+    split_face_blocks(begin, end, blocks);
+    parallel_for(blocks->length, parse_face_block_task, blocks);
+
+    size_t face_count = 0;
+    for (size_t i = 0; i < blocks->length; ++i) face_count += blocks->items[i].face_count;
+
+    if (face_count < blocks->header->n_faces) {
+        fprintf(stderr, "[ERR] Invalid format. End of file is too early. %ld faces expected but only %zu found.\n",
+                blocks->header->n_faces, face_count);
+        exit(1);
+    }
+
+    if (face_count > blocks->header->n_faces) {
+        fprintf(stderr, "[ERR] Invalid format. Expected end of file after the %ld-th face.\n", blocks->header->n_faces);
+        exit(1);
+    }
+
+    // Join the blocks in file order
+    concat_face_blocks(blocks, object, corner_colors);
+    free(blocks->items);
+}
+
+void split_face_blocks(char *begin, char *end, FaceBlocks *blocks) {
+    size_t size = end - begin;
+
+    size_t block_count = FACE_BLOCKS_PER_JOB * parallel_get_job_count();
+    if (block_count > size / FACE_MIN_BLOCK_SIZE) block_count = size / FACE_MIN_BLOCK_SIZE;
+    if (block_count < 1) block_count = 1;
+
+    blocks->items = calloc(block_count, sizeof(FaceBlock));
+    assert(blocks->items && "Could not allocate the face blocks of the off file.");
+    blocks->length = block_count;
+
+    // Every face is given in a line of its own, so a block starting at a line holds whole faces
+    blocks->items[0].begin = begin;
+    for (size_t i = 1; i < block_count; ++i) {
+        char *ptr = begin + size * i / block_count;
+        if (ptr < blocks->items[i - 1].begin) ptr = blocks->items[i - 1].begin;
+
+        char *line_end = memchr(ptr, '\n', end - ptr);
+        blocks->items[i].begin = line_end ? line_end + 1 : end;
+        blocks->items[i - 1].end = blocks->items[i].begin;
+    }
+    blocks->items[block_count - 1].end = end;
+}
+
+void parse_face_block_task(void *context, size_t index) {
+    FaceBlocks *blocks = context;
+    parse_face_block(blocks, &blocks->items[index]);
+}
+
+void parse_face_block(const FaceBlocks *blocks, FaceBlock *block) {
+    const Header *header = blocks->header;
+
+    // Reserve for the share of the faces in this block, assuming triangles.
+    // The face count of the header is not trusted beyond what the bytes of the block can hold.
+    size_t region_size = blocks->items[blocks->length - 1].end - blocks->items[0].begin;
+    size_t block_size = block->end - block->begin;
+    if (region_size) {
+        size_t share = (size_t)((double)header->n_faces * block_size / region_size) + 1;
+        size_t max_face_count = block_size / MIN_FACE_BYTES + 1;
+        da_reserve(block->indices, 3 * (share < max_face_count ? share : max_face_count));
+    }
+
+    FaceIndices face = {0};
+    FaceIndices corners = {0};  // Triangles of the face as positions within it
+    char *ptr = next_token(block->begin);
     char *peak;
-    for (size_t i_face = 0; i_face < header->n_faces; ++i_face) {
-        long number_vertices = strtol(ptr, &peak, 10);
-        advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face has no vertex count.\n", i_face + 1);
 
-        long *vertex_indices = malloc(number_vertices * sizeof(long));
-        for (long i_vertex = 0; i_vertex < number_vertices; ++i_vertex) {
-            vertex_indices[i_vertex] = strtol(ptr, &peak, 10);
-            advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face has no %d-thvertex.\n", i_face + 1, i_vertex + 1);
+    // A face belongs to the block its first token is in
+    while (ptr < block->end && *ptr) {
+        long number_vertices = str_to_i64(ptr, &peak);
+        face_advance_or_err(ptr, peak, blocks->file, "has no vertex count.\n");
+        if (number_vertices < 0) {
+            fprintf(stderr, "[ERR] Invalid format. The face in line %zu has a negative vertex count.\n",
+                    line_number(blocks->file, ptr));
+            exit(1);
         }
 
-        bool has_face_color = false;
-        unsigned char face_color[4] = {255, 255, 255, 255};
-        if (has_numeric_in_line(ptr)) {
-            has_face_color = true;
-
-            if (has_float_in_line(ptr)) {
-                for (size_t i_color = 0; i_color < 3; ++i_color) {
-                    face_color[i_color] = (unsigned char)(strtof(ptr, &peak) * 255.0);
-                    advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face has no %d-th color component.\n", i_face + 1,
-                                   i_color + 1);
-                }
-
-                if (has_numeric_in_line(ptr)) {
-                    face_color[3] = (unsigned char)(strtof(ptr, &peak) * 255.0);
-                    advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face has no alpha color component.\n",
-                                   i_face + 1);
-                }
-            } else {
-                for (size_t i_color = 0; i_color < 3; ++i_color) {
-                    face_color[i_color] = (unsigned char)strtol(ptr, &peak, 10);
-                    advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face has no %d-th color component.\n", i_face + 1,
-                                   i_color + 1);
-                }
-
-                if (has_numeric_in_line(ptr)) {
-                    face_color[3] = (unsigned char)strtol(ptr, &peak, 10);
-                    advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face has no alpha color component.\n",
-                                   i_face + 1);
-                }
+        // Neither is the vertex count of a face trusted beyond the bytes left in the block
+        size_t max_vertex_count = (ptr < block->end ? (block->end - ptr) / MIN_NUMBER_BYTES : 0) + 1;
+        face.length = 0;
+        da_reserve(face, (size_t)number_vertices < max_vertex_count ? (size_t)number_vertices : max_vertex_count);
+        for (long i_vertex = 0; i_vertex < number_vertices; ++i_vertex) {
+            long index = str_to_i64(ptr, &peak);
+            face_advance_or_err(ptr, peak, blocks->file, "has no %ld-th vertex.\n", i_vertex + 1);
+
+            if (index < 0 || index >= header->n_vertices) {
+                fprintf(stderr,
+                        "[ERR] Invalid format. The face in line %zu refers to vertex %ld but only %ld vertices are given.\n",
+                        line_number(blocks->file, ptr), index, header->n_vertices);
+                exit(1);
             }
+
+            da_add(face, index);
         }
 
-        for (long i_vertex = 0; i_vertex + 2 < number_vertices; ++i_vertex) {
-            Vector3 v1 = vector3_at(vertices->items, vertex_indices[i_vertex]);
-            Vector3 v2 = vector3_at(vertices->items, vertex_indices[i_vertex + 1]);
-            Vector3 v3 = vector3_at(vertices->items, vertex_indices[i_vertex + 2]);
-
-            bool shuffled = false;
-            if (header->use_normals) {
-                Vector3 n1 = vector3_at(normals->items, vertex_indices[i_vertex]);
-                Vector3 n2 = vector3_at(normals->items, vertex_indices[i_vertex + 1]);
-                Vector3 n3 = vector3_at(normals->items, vertex_indices[i_vertex + 2]);
-
-                Vector3 normal = Vector3Scale(Vector3Add(n1, Vector3Add(n2, n3)), 1.0f / 3.0f);
-                shuffled = order_vertices(&normal, &v1, &v2, &v3);
-            } else {
-                shuffled = i_vertex % 2;
-                if (shuffled) {
-                    Vector3 temp = v2;
-                    v2 = v3;
-                    v3 = temp;
-                }
+        unsigned char face_color[4];
+        bool has_face_color = parse_face_color(blocks->file, &ptr, face_color);
+
+        // Colors per triangle corner are needed from the first face with its own color on.
+        // Record the vertex colors of all previous triangles of the block.
+        if (has_face_color && !block->use_corner_colors) {
+            block->use_corner_colors = true;
+            da_reserve(block->corner_colors, 4 * block->indices.capacity);
+            for (size_t i = 0; i < block->indices.length; ++i) {
+                Color c = color_at(blocks->colors->items, block->indices.items[i]);
+                da_add_color(block->corner_colors, c);
             }
+        }
+
+        add_face_triangles(blocks, &face, has_face_color ? face_color : NULL, &corners, block);
+        ++block->face_count;
+
+        // Anything following the face color is ignored
+        ptr = next_token(skip_line(ptr));
+    }
+
+    free(corners.items);
+    free(face.items);
+}
+
+bool parse_face_color(const char *file, char **ptr, unsigned char color[4]) {
+    // An optional color of up to 4 components follows the vertex indices within the same line.
+    // The color is given as floats if any component is one, so integer components are kept as both.
+    float floats[4];
+    int64_t integers[4];
+    bool is_float = false;
+    size_t count = 0;
+
+    while (count < 4 && is_number_in_line(*ptr)) {
+        char *peak;
+        integers[count] = str_to_i64(*ptr, &peak);
+        floats[count] = integers[count];
+
+        // Only tokens going on after the integer part need the float parser
+        if (peak == *ptr || *peak == '.' || *peak == 'e' || *peak == 'E') {
+            floats[count] = str_to_f32(*ptr, &peak);
+            is_float = true;
+        }
+
+        face_advance_or_err(*ptr, peak, file, "has an invalid %zu-th color component.\n", count + 1);
+        ++count;
+    }
+
+    if (!count) return false;
+
+    if (count < 3) {
+        fprintf(stderr, "[ERR] Invalid format. The face in line %zu has no %zu-th color component.\n",
+                line_number(file, *ptr), count + 1);
+        exit(1);
+    }
+
+    color[3] = 255;
+    for (size_t i = 0; i < count; ++i) {
+        color[i] = is_float ? (unsigned char)(floats[i] * 255.0) : (unsigned char)integers[i];
+    }
+
+    return true;
+}
+
+void add_face_triangles(const FaceBlocks *blocks, const FaceIndices *face, const unsigned char *face_color,
+                        FaceIndices *corners, FaceBlock *block) {
+    const Vertices *vertices = blocks->vertices;
+    const Colors *colors = blocks->colors;
+    const Normals *normals = blocks->normals;
+    if (face->length < 3) return;
+
+    // Polygons are split like in the other formats, as a fan when convex and by ear clipping otherwise
+    size_t triangle_count = face->length - 2;
+    da_reserve(*corners, 3 * triangle_count);
+    triangulate_polygon(vertices->items, face->items, face->length, corners->items);
+
+    for (size_t i_triangle = 0; i_triangle < triangle_count; ++i_triangle) {
+        size_t index1 = face->items[corners->items[3 * i_triangle]];
+        size_t index2 = face->items[corners->items[3 * i_triangle + 1]];
+        size_t index3 = face->items[corners->items[3 * i_triangle + 2]];
+
+        // The triangles keep the winding of the polygon, unless the normals ask for the other one
+        bool shuffled = false;
+        if (blocks->header->use_normals) {
+            Vector3 v1 = vector3_at(vertices->items, index1);
+            Vector3 v2 = vector3_at(vertices->items, index2);
+            Vector3 v3 = vector3_at(vertices->items, index3);
+
+            Vector3 n1 = vector3_at(normals->items, index1);
+            Vector3 n2 = vector3_at(normals->items, index2);
+            Vector3 n3 = vector3_at(normals->items, index3);
+
+            Vector3 normal = Vector3Scale(Vector3Add(n1, Vector3Add(n2, n3)), 1.0f / 3.0f);
+            shuffled = order_vertices(&normal, &v1, &v2, &v3);
+        }
+
+        if (shuffled) {
+            size_t temp = index2;
+            index2 = index3;
+            index3 = temp;
+        }
 
-            da_add_vector3(object->vertices, v1);
-            da_add_vector3(object->vertices, v2);
-            da_add_vector3(object->vertices, v3);
-
-            if (has_face_color) {
-                da_add4(object->colors, face_color[0], face_color[1], face_color[2], face_color[3]);
-                da_add4(object->colors, face_color[0], face_color[1], face_color[2], face_color[3]);
-                da_add4(object->colors, face_color[0], face_color[1], face_color[2], face_color[3]);
-            } else if (header->use_colors) {
-                Color c1 = color_at(colors->items, vertex_indices[i_vertex]);
-                Color c2 = shuffled ? color_at(colors->items, vertex_indices[i_vertex + 1])
-                                    : color_at(colors->items, vertex_indices[i_vertex + 2]);
-                Color c3 = shuffled ? color_at(colors->items, vertex_indices[i_vertex + 2])
-                                    : color_at(colors->items, vertex_indices[i_vertex + 1]);
-
-                da_add_color(object->colors, c1);
-                da_add_color(object->colors, c2);
-                da_add_color(object->colors, c3);
-            } else {
-                da_add_color(object->colors, fallback_color);
-                da_add_color(object->colors, fallback_color);
-                da_add_color(object->colors, fallback_color);
+        da_add3(block->indices, index1, index2, index3);
+
+        if (face_color) {
+            da_add4(block->corner_colors, face_color[0], face_color[1], face_color[2], face_color[3]);
+            da_add4(block->corner_colors, face_color[0], face_color[1], face_color[2], face_color[3]);
+            da_add4(block->corner_colors, face_color[0], face_color[1], face_color[2], face_color[3]);
+        } else if (block->use_corner_colors) {
+            Color c1 = color_at(colors->items, index1);
+            Color c2 = color_at(colors->items, index2);
+            Color c3 = color_at(colors->items, index3);
+
+            da_add_color(block->corner_colors, c1);
+            da_add_color(block->corner_colors, c2);
+            da_add_color(block->corner_colors, c3);
+        }
+    }
+}
+
+void concat_face_blocks(const FaceBlocks *blocks, Object *object, Colors *corner_colors) {
+    // A single block is taken over without copying
+    if (blocks->length == 1) {
+        object->indices = blocks->items[0].indices;
+        *corner_colors = blocks->items[0].corner_colors;
+        return;
+    }
+
+    size_t index_count = 0;
+    bool use_corner_colors = false;
+    for (size_t i = 0; i < blocks->length; ++i) {
+        index_count += blocks->items[i].indices.length;
+        use_corner_colors |= blocks->items[i].use_corner_colors;
+    }
+
+    da_reserve(object->indices, index_count);
+    if (use_corner_colors) da_reserve(*corner_colors, 4 * index_count);
+
+    for (size_t i = 0; i < blocks->length; ++i) {
+        const FaceBlock *block = &blocks->items[i];
+
+        // Blocks before the first face with its own color take the vertex colors
+        if (block->use_corner_colors) {
+            memcpy(&corner_colors->items[corner_colors->length], block->corner_colors.items,
+                   block->corner_colors.length);
+            corner_colors->length += block->corner_colors.length;
+        } else if (use_corner_colors) {
+            for (size_t j = 0; j < block->indices.length; ++j) {
+                Color c = color_at(blocks->colors->items, block->indices.items[j]);
+                da_add_color(*corner_colors, c);
             }
         }
 
-        free(vertex_indices);
-        ptr = next_token(ptr);
+        memcpy(&object->indices.items[object->indices.length], block->indices.items,
+               block->indices.length * sizeof(object->indices.items[0]));
+        object->indices.length += block->indices.length;
+
+        free(block->indices.items);
+        free(block->corner_colors.items);
     }
-    return ptr;
+}
+
+void expand_to_triangle_soup(Object *object, Colors *corner_colors) {
+    // Give every triangle corner its own vertex, so the corners can take the colors of their faces
+    Vertices soup = {0};
+    da_reserve(soup, 3 * object->indices.length);
+    for (size_t i = 0; i < object->indices.length; ++i) {
+        Vector3 v = vector3_at(object->vertices.items, object->indices.items[i]);
+        da_add_vector3(soup, v);
+    }
+
+    free(object->vertices.items);
+    free(object->colors.items);
+    free(object->indices.items);
+
+    object->vertices = soup;
+    object->colors = *corner_colors;
+    object->indices = (Indices){0};
 }
 
 char *next_token(char *ptr) {
@@ -317,20 +597,18 @@ char *next_token(char *ptr) {
     return ptr;
 }
 
-bool has_numeric_in_line(const char *ptr) {
-    for (; *ptr; ++ptr) {
-        if (*ptr == '\n') return false;
-        if (*ptr == '#') return false;
-        if ('0' <= *ptr && *ptr <= '9') return true;
-    }
-    return false;
+char *skip_line(char *ptr) {
+    while (*ptr && *ptr != '\n') ++ptr;
+    return ptr;
 }
 
-bool has_float_in_line(const char *ptr) {
-    for (; *ptr; ++ptr) {
-        if (*ptr == '\n') return false;
-        if (*ptr == '#') return false;
-        if (*ptr == '.') return true;
-    }
-    return false;
+bool is_number_in_line(const char *ptr) {
+    while (*ptr == ' ' || *ptr == '\t' || *ptr == '\r') ++ptr;
+    return isdigit(*ptr) || *ptr == '.' || *ptr == '-' || *ptr == '+';
+}
+
+size_t line_number(const char *file, const char *ptr) {
+    size_t line = 1;
+    for (; file < ptr; ++file) line += *file == '\n';
+    return line;
 }
@@ -2,7 +2,8 @@
 #define PRINT3_DESERIALIZE_OFF_H_
 
 #include "../scene.h"
+#include "memory.h"
 
-void off_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene);
+void off_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene, DeserializerTiming *timing);
 
 #endif
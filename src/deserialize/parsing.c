@@ -2,10 +2,18 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "raymath.h"
 
+#define TRIANGULATE_STACK_CORNERS 64
+
+static bool is_convex_corner(Vector3 previous, Vector3 corner, Vector3 next, Vector3 normal);
+static bool is_inside_triangle(Vector3 point, Vector3 a, Vector3 b, Vector3 c, Vector3 normal);
+static void clip_ears(const float *vertices, const size_t *polygon, size_t count, Vector3 normal, size_t *remaining,
+                      size_t *triangles);
+
 uint8_t binary_buffer_to_u8(const uint8_t *buffer) { return *buffer; }
 
 uint16_t binary_buffer_to_u16(const uint8_t *buffer, ByteOrdering ordering) {
@@ -87,3 +95,109 @@ bool order_vertices(const Vector3 *normal, Vector3 *v1, Vector3 *v2, Vector3 *v3
     }
     return false;
 }
+
+void triangulate_polygon(const float *vertices, const size_t *polygon, size_t count, size_t *triangles) {
+    assert(count >= 3 && "A polygon needs at least 3 vertices.");
+
+    // Newell's method gives the normal of the polygon, pointing to the side the polygon is wound counter clockwise
+    Vector3 normal = {0};
+    bool is_convex = true;
+    for (size_t i = 0; i < count; ++i) {
+        Vector3 current = vector3_at(vertices, polygon[i]);
+        Vector3 next = vector3_at(vertices, polygon[(i + 1) % count]);
+        normal.x += (current.y - next.y) * (current.z + next.z);
+        normal.y += (current.z - next.z) * (current.x + next.x);
+        normal.z += (current.x - next.x) * (current.y + next.y);
+    }
+
+    for (size_t i = 0; i < count && count > 3; ++i) {
+        Vector3 previous = vector3_at(vertices, polygon[(i + count - 1) % count]);
+        Vector3 current = vector3_at(vertices, polygon[i]);
+        Vector3 next = vector3_at(vertices, polygon[(i + 1) % count]);
+        if (!is_convex_corner(previous, current, next, normal)) {
+            is_convex = false;
+            break;
+        }
+    }
+
+    if (is_convex) {
+        for (size_t i = 1; i + 1 < count; ++i) {
+            triangles[3 * (i - 1) + 0] = 0;
+            triangles[3 * (i - 1) + 1] = i;
+            triangles[3 * (i - 1) + 2] = i + 1;
+        }
+        return;
+    }
+
+    // Ear clipping keeps the corners which are not cut off yet
+    size_t stack_remaining[TRIANGULATE_STACK_CORNERS];
+    size_t *remaining = count <= TRIANGULATE_STACK_CORNERS ? stack_remaining : malloc(count * sizeof(size_t));
+    assert(remaining && "Could not allocate the corners of a polygon.");
+
+    clip_ears(vertices, polygon, count, normal, remaining, triangles);
+
+    if (remaining != stack_remaining) free(remaining);
+}
+
+bool is_convex_corner(Vector3 previous, Vector3 corner, Vector3 next, Vector3 normal) {
+    Vector3 turn = Vector3CrossProduct(Vector3Subtract(corner, previous), Vector3Subtract(next, corner));
+    return Vector3DotProduct(turn, normal) >= 0.0f;
+}
+
+bool is_inside_triangle(Vector3 point, Vector3 a, Vector3 b, Vector3 c, Vector3 normal) {
+    // Inside or on an edge if the point is on the left of every edge when looking against the normal
+    return Vector3DotProduct(Vector3CrossProduct(Vector3Subtract(b, a), Vector3Subtract(point, a)), normal) >= 0.0f &&
+           Vector3DotProduct(Vector3CrossProduct(Vector3Subtract(c, b), Vector3Subtract(point, b)), normal) >= 0.0f &&
+           Vector3DotProduct(Vector3CrossProduct(Vector3Subtract(a, c), Vector3Subtract(point, c)), normal) >= 0.0f;
+}
+
+void clip_ears(const float *vertices, const size_t *polygon, size_t count, Vector3 normal, size_t *remaining,
+               size_t *triangles) {
+    for (size_t i = 0; i < count; ++i) {
+        remaining[i] = i;
+    }
+
+    size_t remaining_count = count;
+    size_t triangle_index = 0;
+    size_t i = 0;
+    size_t misses = 0;
+
+    while (remaining_count > 3) {
+        size_t previous = remaining[(i + remaining_count - 1) % remaining_count];
+        size_t current = remaining[i];
+        size_t next = remaining[(i + 1) % remaining_count];
+
+        Vector3 a = vector3_at(vertices, polygon[previous]);
+        Vector3 b = vector3_at(vertices, polygon[current]);
+        Vector3 c = vector3_at(vertices, polygon[next]);
+
+        // An ear is a convex corner whose triangle contains no other corner
+        bool is_ear = is_convex_corner(a, b, c, normal);
+        for (size_t j = 0; is_ear && j < remaining_count; ++j) {
+            size_t other = remaining[j];
+            if (other == previous || other == current || other == next) continue;
+
+            Vector3 p = vector3_at(vertices, polygon[other]);
+            is_ear = !is_inside_triangle(p, a, b, c, normal);
+        }
+
+        // Self intersecting or degenerate polygons may have no ear left, cut the corner anyway to make progress
+        if (is_ear || misses >= remaining_count) {
+            triangles[triangle_index++] = previous;
+            triangles[triangle_index++] = current;
+            triangles[triangle_index++] = next;
+
+            memmove(&remaining[i], &remaining[i + 1], (remaining_count - i - 1) * sizeof(size_t));
+            --remaining_count;
+            if (i >= remaining_count) i = 0;
+            misses = 0;
+        } else {
+            i = (i + 1) % remaining_count;
+            ++misses;
+        }
+    }
+
+    triangles[triangle_index++] = remaining[0];
+    triangles[triangle_index++] = remaining[1];
+    triangles[triangle_index++] = remaining[2];
+}
@@ -1,6 +1,7 @@
 #ifndef PRINT3_DESERIALIZE_PARSING_H_
 #define PRINT3_DESERIALIZE_PARSING_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "raylib.h"
@@ -11,6 +12,11 @@ typedef enum ByteOrdering {
     ByteOrdering_COUNT,
 } ByteOrdering;
 
+// Defined when the host stores multi byte numbers in little endian order
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define HOST_LITTLE_ENDIAN
+#endif
+
 #define advance_or_err(ptr, peak, ...)    \
     do {                                  \
         if ((peak) == (ptr)) {            \
@@ -37,4 +43,9 @@ char *str_skip(char *str, const char *skip);
 char *str_skip_whitespace(char *str);
 bool order_vertices(const Vector3 *normal, Vector3 *v1, Vector3 *v2, Vector3 *v3);
 
+// Split a polygon of count vertex indices into count - 2 triangles with the winding of the polygon.
+// Convex polygons are split as a fan, concave ones by ear clipping.
+// triangles receives 3 * (count - 2) corners as positions within polygon, not as vertex indices.
+void triangulate_polygon(const float *vertices, const size_t *polygon, size_t count, size_t *triangles);
+
 #endif
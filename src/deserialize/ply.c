@@ -4,9 +4,16 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "../parallel.h"
+#include "../timer.h"
+#include "../trace.h"
+#include "number.h"
 #include "parsing.h"
 #include "raymath.h"
 
+// Vertices decoded by a single task of the worker pool
+#define BIN_TASK_VERTICES (1 << 16)
+
 typedef enum Format {
     FORMAT_ASCII,
     FORMAT_BINARY_LITTLE_ENDIAN,
@@ -51,47 +58,124 @@ typedef struct FaceElement {
     DataTypeInfo item_info;
 } FaceElement;
 
+// Property of an element, that is not rendered
+typedef struct OtherProperty {
+    bool is_list;
+    DataTypeInfo count_info;  // Only for lists
+    DataTypeInfo info;        // Type of the value or of the list items
+} OtherProperty;
+
+typedef struct OtherProperties {
+    OtherProperty *items;
+    size_t length;
+    size_t capacity;
+} OtherProperties;
+
+// Element, that is neither the vertex nor the face element. Its data is skipped.
+typedef struct OtherElement {
+    size_t count;
+    size_t binary_size;  // Size of every item, only valid without list properties
+    bool has_list;
+    OtherProperties properties;
+} OtherElement;
+
+typedef struct OtherElements {
+    OtherElement *items;
+    size_t length;
+    size_t capacity;
+} OtherElements;
+
 typedef struct Header {
     Format format;
 
+    int64_t element_count;
+
     int64_t vertex_index;
     VertexElement vertex;
 
     int64_t face_index;
     FaceElement face;
+
+    OtherElements others;  // In the order of the file
 } Header;
 
-typedef struct Indices {
+// Vertex count followed by the vertex indices for every polygon
+typedef struct Polygons {
     size_t *items;
     size_t length;
     size_t capacity;
-} Indices;
+} Polygons;
+
+typedef struct BinVertices BinVertices;
+
+// Decode count vertices of the element, starting at the first-th vertex
+typedef void (*BinVertexDecoder)(const BinVertices *target, size_t first, size_t count);
+
+// Binary vertex element and the arrays it is decoded to, which hold all of its vertices
+struct BinVertices {
+    const uint8_t *buffer;
+    ByteOrdering ordering;
+    const VertexElement *element;
+    BinVertexDecoder decode;
+    Color fallback_color;  // Used when colors are not given by the element
+    bool use_fallback_color;
+    float *vertices;
+    float *normals;  // NULL when the element has no normals
+    unsigned char *colors;
+};
+
+// Vertex layout with a decoder, that does not inspect the properties
+typedef struct BinVertexLayout {
+    bool has_normals;
+    size_t color_channels;  // 0, 3 (rgb) or 4 (rgba)
+    BinVertexDecoder decode;
+} BinVertexLayout;
+
+typedef char *(*BinFaceDecoder)(ByteOrdering ordering, char *ptr, const FaceElement *element, Polygons *polygons);
+
+// Face layout with a decoder, that reads the list without dispatching on the data types
+typedef struct BinFaceLayout {
+    uint8_t count_size;
+    uint8_t item_size;
+    BinFaceDecoder decode;
+} BinFaceLayout;
 
 // Header parsing
 static char *parse_header(char *ptr, Header *header);
 static char *parse_vertex_properties(char *ptr, VertexElement *vertex);
 static char *parse_face_properties(char *ptr, FaceElement *face);
+static char *parse_other_properties(char *ptr, OtherElement *other);
 static DataTypeInfo parse_data_type_info(char *ptr, char **peak);
 static void str_cap(char *ptr, size_t n);
 
 // Ascii data parsing
 static char *ascii_parse_vertex(char *ptr, const VertexElement *element, Color fallback_color, Vertices *vertices,
                                 Vertices *normals, Colors *colors);
-static char *ascii_parse_face(char *ptr, const FaceElement *element, Indices *indices);
+static char *ascii_parse_face(char *ptr, const FaceElement *element, Polygons *polygons);
 
 // Binary data parsing
-static char *bin_parse_vertex(ByteOrdering ordering, char *ptr, const VertexElement *element, Color fallback_color,
-                              Vertices *vertices, Vertices *normals, Colors *colors);
-static char *bin_parse_face(ByteOrdering ordering, char *ptr, const FaceElement *element, Indices *indices);
+static char *bin_parse_vertex(ByteOrdering ordering, char *ptr, const char *end, const VertexElement *element,
+                              Color fallback_color, Vertices *vertices, Vertices *normals, Colors *colors);
+static BinVertexDecoder bin_select_vertex_decoder(ByteOrdering ordering, const VertexElement *element);
+static bool bin_is_property(const VertexProperty *property, int64_t binary_offset, bool is_float, uint8_t size);
+static void bin_decode_vertices_task(void *context, size_t index);
+static void bin_decode_vertices_generic(const BinVertices *target, size_t first, size_t count);
+static char *bin_parse_face(ByteOrdering ordering, char *ptr, const FaceElement *element, Polygons *polygons);
+static BinFaceDecoder bin_select_face_decoder(ByteOrdering ordering, const FaceElement *element);
+static char *bin_decode_faces_generic(ByteOrdering ordering, char *ptr, const FaceElement *element, Polygons *polygons);
+
+// Skipping of other elements
+static char *skip_element(Format format, ByteOrdering ordering, char *ptr, const char *end, const OtherElement *element);
 static uint64_t bin_get_integer(void *buffer, ByteOrdering ordering, DataTypeInfo info);
 static float bin_get_float(void *buffer, ByteOrdering ordering, DataTypeInfo info);
 
 // Triangluation
-static void triangulate_into_scene(const Vertices *vertices, const Vertices *normals, const Colors *colors,
-                                   const Indices *indices, Scene *scene);
+static void triangulate_into_scene(Vertices *vertices, const Vertices *normals, Colors *colors, const Polygons *polygons,
+                                   Scene *scene);
 
-void ply_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene) {
+void ply_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene, DeserializerTiming *timing) {
     char *ptr = buffer;
+    char *end = (char *)buffer + size;
     char *peak;
 
     Header header = {0};
@@ -103,28 +187,50 @@ void ply_deserialize(void *buffer, size_t size, Color fallback_color, Scene *sce
     Vertices vertices = {0};
     Vertices normals = {0};
     Colors colors = {0};
-    Indices indices = {0};
+    Polygons polygons = {0};
 
-    // Parse the data block
-    for (int64_t element_index = 0; *ptr; ++element_index) {
+    // Parse the data block, the elements are given in the order of the header
+    size_t other_index = 0;
+    for (int64_t element_index = 0; element_index < header.element_count; ++element_index) {
         if (header.vertex_index == element_index) {
+            TRACE_BEGIN(parse_vertices, "ply parse vertices");
             if (header.format == FORMAT_ASCII) {
                 ptr = ascii_parse_vertex(ptr, &header.vertex, fallback_color, &vertices, &normals, &colors);
             } else {
-                ptr = bin_parse_vertex(ordering, ptr, &header.vertex, fallback_color, &vertices, &normals, &colors);
+                ptr = bin_parse_vertex(ordering, ptr, end, &header.vertex, fallback_color, &vertices, &normals,
+                                       &colors);
             }
+            TRACE_COUNT(parse_vertices, "vertices", vertices.length / 3);
+            TRACE_END(parse_vertices);
         } else if (header.face_index == element_index) {
+            TRACE_BEGIN(parse_faces, "ply parse faces");
             if (header.format == FORMAT_ASCII) {
-                ptr = ascii_parse_face(ptr, &header.face, &indices);
+                ptr = ascii_parse_face(ptr, &header.face, &polygons);
             } else {
-                ptr = bin_parse_face(ordering, ptr, &header.face, &indices);
+                ptr = bin_parse_face(ordering, ptr, &header.face, &polygons);
             }
+            TRACE_COUNT(parse_faces, "faces", header.face.count);
+            TRACE_END(parse_faces);
         } else {
-            ++ptr;
+            ptr = skip_element(header.format, ordering, ptr, end, &header.others.items[other_index++]);
         }
     }
 
-    triangulate_into_scene(&vertices, &normals, &colors, &indices, scene);
+    double start = timer_now();
+    TRACE_BEGIN(triangulate, "ply triangulate");
+    size_t first_object = scene->objects.length;
+    (void)first_object;  // Only counted when tracing
+    triangulate_into_scene(&vertices, &normals, &colors, &polygons, scene);
+    TRACE_COUNT(triangulate, "triangles", scene_count_triangles(scene, first_object));
+    TRACE_END(triangulate);
+    if (timing) timing->triangulate = timer_now() - start;
+
+    for (size_t i = 0; i < header.others.length; ++i) {
+        free(header.others.items[i].properties.items);
+    }
+    free(header.others.items);
+    free(normals.items);
+    free(polygons.items);
 }
 
 char *parse_header(char *ptr, Header *header) {
@@ -169,9 +275,10 @@ char *parse_header(char *ptr, Header *header) {
     // Parse elements
     header->vertex_index = -1;  // Deactivate all element and activate them on visit
     header->face_index = -1;
-    for (int element_index = 0; strncmp(ptr, "end_header\n", 11); ++element_index) {
-        // Ignore comments
-        if (strncmp(ptr, "comment ", 8) == 0) {
+    int element_index = 0;
+    for (; strncmp(ptr, "end_header\n", 11); ++element_index) {
+        // Ignore comments and object informations
+        if (strncmp(ptr, "comment ", 8) == 0 || strncmp(ptr, "obj_info ", 9) == 0) {
             element_index--;
             ptr = str_skip(ptr, "\n");
             if (!ptr) {
@@ -184,6 +291,7 @@ char *parse_header(char *ptr, Header *header) {
         // Assert the start with element keyword
         if (strncmp(ptr, "element ", 8)) {
             fprintf(stderr, "[ERR] Invalid format. Every element must start with the element keyword.\n");
+            exit(1);
         }
         ptr += 8;
 
@@ -192,7 +300,7 @@ char *parse_header(char *ptr, Header *header) {
             ptr += 7;
 
             header->vertex_index = element_index;
-            header->vertex.count = strtoll(ptr, &peak, 10);
+            header->vertex.count = str_to_i64(ptr, &peak);
             advance_or_err(ptr, peak, "[ERR] Invalid format. Vertex element is missing a count.\n");
             if (*ptr != '\n') {
                 fprintf(stderr, "[ERR] Invalid format. Vertex count must be followed by new line.\n");
@@ -205,7 +313,7 @@ char *parse_header(char *ptr, Header *header) {
             ptr += 5;
 
             header->face_index = element_index;
-            header->face.count = strtoll(ptr, &peak, 10);
+            header->face.count = str_to_i64(ptr, &peak);
             advance_or_err(ptr, peak, "[ERR] Invalid format. Face element is missing a count.\n");
             if (*ptr != '\n') {
                 fprintf(stderr, "[ERR] Invalid format. Face count must be followed by new line.\n");
@@ -215,11 +323,29 @@ char *parse_header(char *ptr, Header *header) {
 
             ptr = parse_face_properties(ptr, &header->face);
         } else {
-            str_cap(ptr, 40);
-            fprintf(stderr, "[ERR] invalid format. Unknown element type -> element %s ... \n", ptr);
-            exit(1);
+            // Any other element is skipped, its properties are needed to know its size
+            peak = str_skip(ptr, " ");
+            if (!peak) {
+                str_cap(ptr, 40);
+                fprintf(stderr, "[ERR] Invalid format. Element is missing a count -> element %s ...\n", ptr);
+                exit(1);
+            }
+            ptr = peak;
+
+            OtherElement other = {0};
+            other.count = str_to_i64(ptr, &peak);
+            advance_or_err(ptr, peak, "[ERR] Invalid format. Element is missing a count.\n");
+            if (*ptr != '\n') {
+                fprintf(stderr, "[ERR] Invalid format. Element count must be followed by new line.\n");
+                exit(1);
+            }
+            ++ptr;
+
+            ptr = parse_other_properties(ptr, &other);
+            da_add(header->others, other);
         }
     }
+    header->element_count = element_index;
 
     // Skip "end_header\n" header termination
     ptr += 11;
@@ -361,6 +487,53 @@ char *parse_face_properties(char *ptr, FaceElement *face) {
     return ptr;
 }
 
+char *parse_other_properties(char *ptr, OtherElement *other) {
+    char *peak;
+
+    while (strncmp(ptr, "property ", 9) == 0 || strncmp(ptr, "comment ", 8) == 0) {
+        // Ignore comments
+        if (strncmp(ptr, "comment ", 8) == 0) {
+            ptr = str_skip(ptr, "\n");
+            if (!ptr) {
+                fprintf(stderr, "[ERR] Invalid format. Comment must end with a new line.\n");
+                exit(1);
+            }
+            continue;
+        }
+
+        // Skip property keyword
+        ptr += 9;
+
+        OtherProperty property = {0};
+        if (strncmp(ptr, "list ", 5) == 0) {
+            ptr += 5;
+            property.is_list = true;
+            other->has_list = true;
+
+            property.count_info = parse_data_type_info(ptr, &peak);
+            advance_or_err(ptr, peak, "[ERR] Invalid format. List property does not have a valid datatype for the count ->%s",
+                           ptr);
+        }
+
+        property.info = parse_data_type_info(ptr, &peak);
+        advance_or_err(ptr, peak, "[ERR] Invalid format. Property does not have a valid datatype ->%s", ptr);
+        if (!property.is_list) other->binary_size += property.info.size;
+
+        // The name does not matter
+        peak = str_skip(ptr, "\n");
+        if (!peak) {
+            str_cap(ptr, 20);
+            fprintf(stderr, "[ERR] Invalid format. Property does not have a newline at the end ->%s ...\n", ptr);
+            exit(1);
+        }
+        ptr = peak;
+
+        da_add(other->properties, property);
+    }
+
+    return ptr;
+}
+
 #define DATA_TYPE_INFO_MAP_COUNT 16
 
 struct {
@@ -437,14 +610,14 @@ char *ascii_parse_vertex(char *ptr, const VertexElement *element, Color fallback
         for (size_t property_index = 0; property_index < element->property_count; ++property_index) {
 #define read_float(prop, dest, msg)                       \
     if (property_index == (prop).index) {                 \
-        (dest) = strtod(ptr, &peak);                      \
+        (dest) = str_to_f32(ptr, &peak);                  \
         advance_or_err(ptr, peak, msg, vertex_index + 1); \
         continue;                                         \
     }
 
 #define read_integer(prop, dest, msg)                     \
     if (property_index == (prop).index) {                 \
-        (dest) = strtoll(ptr, &peak, 10);                 \
+        (dest) = str_to_i64(ptr, &peak);                  \
         advance_or_err(ptr, peak, msg, vertex_index + 1); \
         continue;                                         \
     }
@@ -490,19 +663,19 @@ char *ascii_parse_vertex(char *ptr, const VertexElement *element, Color fallback
     return ptr;
 }
 
-char *ascii_parse_face(char *ptr, const FaceElement *element, Indices *indices) {
+char *ascii_parse_face(char *ptr, const FaceElement *element, Polygons *polygons) {
     char *peak;
 
     for (size_t face_index = 0; face_index < element->count; ++face_index) {
-        size_t index_count = strtoll(ptr, &peak, 10);
+        size_t index_count = str_to_i64(ptr, &peak);
         advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face does not have a vertex count.\n", face_index + 1);
-        da_add(*indices, index_count);
+        da_add(*polygons, index_count);
 
         for (size_t index_index = 0; index_index < index_count; ++index_index) {
-            size_t index = strtoll(ptr, &peak, 10);
+            size_t index = str_to_i64(ptr, &peak);
             advance_or_err(ptr, peak, "[ERR] Invalid format. %d-th face does not have a %d-th vertex index.\n",
                            face_index + 1, index_index + 1);
-            da_add(*indices, index);
+            da_add(*polygons, index);
         }
 
         // Go to next line
@@ -523,32 +696,219 @@ char *ascii_parse_face(char *ptr, const FaceElement *element, Indices *indices)
 // Binary data parsing
 // *******************
 
-char *bin_parse_vertex(ByteOrdering ordering, char *ptr, const VertexElement *element, Color fallback_color,
-                       Vertices *vertices, Vertices *normals, Colors *colors) {
+// Specialized vertex decoders for float x y z, optionally followed by float nx ny nz and uchar red green blue [alpha].
+// The properties are packed in this order and stored in the byte order of the host, so they are copied as they are.
+#define DEFINE_BIN_VERTEX_DECODER(name, NORMALS, CHANNELS)                                                  \
+    static void name(const BinVertices *target, size_t first, size_t count) {                              \
+        const size_t stride = 12 + 12 * (NORMALS) + (CHANNELS);                                             \
+        const uint8_t *ptr = target->buffer + first * stride;                                               \
+        float *vertices = &target->vertices[3 * first];                                                     \
+                                                                                                            \
+        /* Positions only are a single block of floats */                                                   \
+        if (!(NORMALS) && !(CHANNELS)) {                                                                    \
+            memcpy(vertices, ptr, 12 * count);                                                              \
+            return;                                                                                         \
+        }                                                                                                   \
+                                                                                                            \
+        for (size_t i = 0; i < count; ++i, ptr += stride) {                                                 \
+            memcpy(&vertices[3 * i], ptr, 12);                                                              \
+            if (NORMALS) memcpy(&target->normals[3 * (first + i)], ptr + 12, 12);                           \
+            if (CHANNELS) {                                                                                 \
+                unsigned char *color = &target->colors[4 * (first + i)];                                    \
+                memcpy(color, ptr + 12 + 12 * (NORMALS), (CHANNELS));                                       \
+                if ((CHANNELS) == 3) color[3] = 255;                                                        \
+            }                                                                                               \
+        }                                                                                                   \
+    }
+
+DEFINE_BIN_VERTEX_DECODER(bin_decode_xyz, false, 0)
+DEFINE_BIN_VERTEX_DECODER(bin_decode_xyz_rgb, false, 3)
+DEFINE_BIN_VERTEX_DECODER(bin_decode_xyz_rgba, false, 4)
+DEFINE_BIN_VERTEX_DECODER(bin_decode_xyz_normal, true, 0)
+DEFINE_BIN_VERTEX_DECODER(bin_decode_xyz_normal_rgb, true, 3)
+DEFINE_BIN_VERTEX_DECODER(bin_decode_xyz_normal_rgba, true, 4)
+
+#undef DEFINE_BIN_VERTEX_DECODER
+
+#define BIN_VERTEX_LAYOUT_COUNT 6
+
+static const BinVertexLayout bin_vertex_layouts[BIN_VERTEX_LAYOUT_COUNT] = {
+    {.has_normals = false, .color_channels = 0, .decode = bin_decode_xyz},
+    {.has_normals = false, .color_channels = 3, .decode = bin_decode_xyz_rgb},
+    {.has_normals = false, .color_channels = 4, .decode = bin_decode_xyz_rgba},
+    {.has_normals = true, .color_channels = 0, .decode = bin_decode_xyz_normal},
+    {.has_normals = true, .color_channels = 3, .decode = bin_decode_xyz_normal_rgb},
+    {.has_normals = true, .color_channels = 4, .decode = bin_decode_xyz_normal_rgba},
+};
+
+// Specialized face decoders for integer counts and indices in the byte order of the host
+#define DEFINE_BIN_FACE_DECODER(name, COUNT_TYPE, ITEM_TYPE)                                          \
+    static char *name(ByteOrdering ordering, char *ptr, const FaceElement *element, Polygons *polygons) { \
+        (void)ordering;                                                                               \
+                                                                                                      \
+        /* Room for triangles, larger polygons grow the array */                                      \
+        da_reserve(*polygons, polygons->length + 4 * element->count);                                 \
+        for (size_t face_index = 0; face_index < element->count; ++face_index) {                      \
+            COUNT_TYPE index_count;                                                                   \
+            memcpy(&index_count, ptr, sizeof(COUNT_TYPE));                                            \
+            ptr += sizeof(COUNT_TYPE);                                                                \
+                                                                                                      \
+            /* Triangles are copied at once while they fit into the reserved room */                  \
+            if (index_count == 3 && polygons->length + 4 <= polygons->capacity) {                     \
+                ITEM_TYPE indices[3];                                                                 \
+                memcpy(indices, ptr, sizeof(indices));                                                \
+                ptr += sizeof(indices);                                                               \
+                size_t *items = &polygons->items[polygons->length];                                   \
+                items[0] = 3;                                                                         \
+                items[1] = indices[0];                                                                \
+                items[2] = indices[1];                                                                \
+                items[3] = indices[2];                                                                \
+                polygons->length += 4;                                                                \
+                continue;                                                                             \
+            }                                                                                         \
+                                                                                                      \
+            da_add(*polygons, index_count);                                                           \
+                                                                                                      \
+            for (size_t index_index = 0; index_index < index_count; ++index_index) {                  \
+                ITEM_TYPE index;                                                                      \
+                memcpy(&index, ptr, sizeof(ITEM_TYPE));                                               \
+                ptr += sizeof(ITEM_TYPE);                                                             \
+                da_add(*polygons, index);                                                             \
+            }                                                                                         \
+        }                                                                                             \
+                                                                                                      \
+        return ptr;                                                                                   \
+    }
+
+DEFINE_BIN_FACE_DECODER(bin_decode_faces_u8_u32, uint8_t, uint32_t)
+DEFINE_BIN_FACE_DECODER(bin_decode_faces_u8_u16, uint8_t, uint16_t)
+DEFINE_BIN_FACE_DECODER(bin_decode_faces_u32_u32, uint32_t, uint32_t)
+
+#undef DEFINE_BIN_FACE_DECODER
+
+#define BIN_FACE_LAYOUT_COUNT 3
+
+static const BinFaceLayout bin_face_layouts[BIN_FACE_LAYOUT_COUNT] = {
+    {.count_size = 1, .item_size = 4, .decode = bin_decode_faces_u8_u32},
+    {.count_size = 1, .item_size = 2, .decode = bin_decode_faces_u8_u16},
+    {.count_size = 4, .item_size = 4, .decode = bin_decode_faces_u32_u32},
+};
+
+char *bin_parse_vertex(ByteOrdering ordering, char *ptr, const char *end, const VertexElement *element,
+                       Color fallback_color, Vertices *vertices, Vertices *normals, Colors *colors) {
+    if (element->binary_size && (size_t)(end - ptr) / element->binary_size < element->count) {
+        fprintf(stderr, "[ERR] Invalid format. The file ends within the %zu vertices of the vertex element.\n",
+                element->count);
+        exit(1);
+    }
+
     bool use_fallback_color =
         element->r.index == -1 && element->g.index == -1 && element->b.index == -1 && element->a.index == -1;
 
     bool use_normals = element->n_x.index != -1 || element->n_y.index != -1 || element->n_z.index != -1;
 
-    // Use fallback color when no color is given
-    if (use_fallback_color) {
-        for (size_t i = 0; i < element->count; ++i) {
-            da_add_color(*colors, fallback_color);
+    // Every vertex is written to its place, so the element is decoded in parallel
+    da_reserve(*vertices, 3 * element->count);
+    da_reserve(*colors, 4 * element->count);
+    if (use_normals) da_reserve(*normals, 3 * element->count);
+
+    BinVertices target = {
+        .buffer = (const uint8_t *)ptr,
+        .ordering = ordering,
+        .element = element,
+        .decode = bin_select_vertex_decoder(ordering, element),
+        .fallback_color = fallback_color,
+        .use_fallback_color = use_fallback_color,
+        .vertices = vertices->items,
+        .normals = use_normals ? normals->items : NULL,
+        .colors = colors->items,
+    };
+    parallel_for((element->count + BIN_TASK_VERTICES - 1) / BIN_TASK_VERTICES, bin_decode_vertices_task, &target);
+
+    vertices->length = 3 * element->count;
+    colors->length = 4 * element->count;
+    if (use_normals) normals->length = 3 * element->count;
+
+    return ptr + element->count * element->binary_size;
+}
+
+BinVertexDecoder bin_select_vertex_decoder(ByteOrdering ordering, const VertexElement *element) {
+#if defined(HOST_LITTLE_ENDIAN)
+    bool host_ordering = ordering == ORDERING_LITTLE_ENDIAN;
+#else
+    bool host_ordering = ordering == ORDERING_BIG_ENDIAN;
+#endif
+
+    bool has_position = bin_is_property(&element->x, 0, true, 4) && bin_is_property(&element->y, 4, true, 4) &&
+                        bin_is_property(&element->z, 8, true, 4);
+    if (!host_ordering || !has_position) return bin_decode_vertices_generic;
+
+    for (size_t i = 0; i < BIN_VERTEX_LAYOUT_COUNT; ++i) {
+        const BinVertexLayout *layout = &bin_vertex_layouts[i];
+
+        // Either all or none of the optional properties, at their packed offsets
+        int64_t offset = 12;
+        bool normals_match = layout->has_normals
+                                 ? bin_is_property(&element->n_x, offset, true, 4) &&
+                                       bin_is_property(&element->n_y, offset + 4, true, 4) &&
+                                       bin_is_property(&element->n_z, offset + 8, true, 4)
+                                 : element->n_x.index == -1 && element->n_y.index == -1 && element->n_z.index == -1;
+        if (layout->has_normals) offset += 12;
+
+        const VertexProperty *channels[4] = {&element->r, &element->g, &element->b, &element->a};
+        bool colors_match = true;
+        for (size_t i_channel = 0; i_channel < 4; ++i_channel) {
+            colors_match &= i_channel < layout->color_channels
+                                ? bin_is_property(channels[i_channel], offset + i_channel, false, 1)
+                                : channels[i_channel]->index == -1;
         }
+        offset += layout->color_channels;
+
+        // No other properties may be interleaved
+        if (normals_match && colors_match && element->binary_size == (size_t)offset) return layout->decode;
     }
 
-    for (size_t vertex_index = 0; vertex_index < element->count; ++vertex_index) {
+    return bin_decode_vertices_generic;
+}
+
+bool bin_is_property(const VertexProperty *property, int64_t binary_offset, bool is_float, uint8_t size) {
+    return property->index != -1 && property->binary_offset == binary_offset &&
+           property->data_type_info.is_float == is_float && property->data_type_info.size == size;
+}
+
+void bin_decode_vertices_task(void *context, size_t index) {
+    const BinVertices *target = context;
+    size_t first = index * BIN_TASK_VERTICES;
+    size_t remaining = target->element->count - first;
+    size_t count = remaining < BIN_TASK_VERTICES ? remaining : BIN_TASK_VERTICES;
+
+    target->decode(target, first, count);
+
+    if (target->use_fallback_color) {
+        for (size_t i = first; i < first + count; ++i) {
+            memcpy(&target->colors[4 * i], &target->fallback_color, 4);
+        }
+    }
+}
+
+void bin_decode_vertices_generic(const BinVertices *target, size_t first, size_t count) {
+    const VertexElement *element = target->element;
+    ByteOrdering ordering = target->ordering;
+
+    for (size_t vertex_index = first; vertex_index < first + count; ++vertex_index) {
+        const char *ptr = (const char *)target->buffer + vertex_index * element->binary_size;
+
         Vector3 v = {0};
         Vector3 n = {0};
         Color c = {0, 0, 0, 255};
 
-#define read_float(prop, dest)                                                               \
-    if ((prop).index != -1) {                                                                \
-        (dest) = bin_get_float(ptr + (prop).binary_offset, ordering, (prop).data_type_info); \
+#define read_float(prop, dest)                                                                       \
+    if ((prop).index != -1) {                                                                        \
+        (dest) = bin_get_float((void *)(ptr + (prop).binary_offset), ordering, (prop).data_type_info); \
     }
-#define read_integer(prop, dest)                                                               \
-    if ((prop).index != -1) {                                                                  \
-        (dest) = bin_get_integer(ptr + (prop).binary_offset, ordering, (prop).data_type_info); \
+#define read_integer(prop, dest)                                                                       \
+    if ((prop).index != -1) {                                                                          \
+        (dest) = bin_get_integer((void *)(ptr + (prop).binary_offset), ordering, (prop).data_type_info); \
     }
 
         read_float(element->x, v.x);
@@ -564,34 +924,55 @@ char *bin_parse_vertex(ByteOrdering ordering, char *ptr, const VertexElement *el
         read_integer(element->b, c.b);
         read_integer(element->a, c.a);
 
-        da_add_vector3(*vertices, v);
+#undef read_float
+#undef read_integer
 
-        if (use_normals) {
-            da_add_vector3(*normals, n);
+        memcpy(&target->vertices[3 * vertex_index], &v, sizeof(v));
+
+        if (target->normals) {
+            memcpy(&target->normals[3 * vertex_index], &n, sizeof(n));
         }
 
-        if (!use_fallback_color) {
-            da_add_color(*colors, c);
+        if (!target->use_fallback_color) {
+            memcpy(&target->colors[4 * vertex_index], &c, sizeof(c));
         }
+    }
+}
 
-        // Go to next vertex
-        ptr += element->binary_size;
+char *bin_parse_face(ByteOrdering ordering, char *ptr, const FaceElement *element, Polygons *polygons) {
+    return bin_select_face_decoder(ordering, element)(ordering, ptr, element, polygons);
+}
+
+BinFaceDecoder bin_select_face_decoder(ByteOrdering ordering, const FaceElement *element) {
+#if defined(HOST_LITTLE_ENDIAN)
+    bool host_ordering = ordering == ORDERING_LITTLE_ENDIAN;
+#else
+    bool host_ordering = ordering == ORDERING_BIG_ENDIAN;
+#endif
+    if (!host_ordering || element->count_info.is_float || element->item_info.is_float) return bin_decode_faces_generic;
+
+    // Signed numbers are reinterpreted as unsigned, like the generic decoder does
+    for (size_t i = 0; i < BIN_FACE_LAYOUT_COUNT; ++i) {
+        const BinFaceLayout *layout = &bin_face_layouts[i];
+        if (layout->count_size == element->count_info.size && layout->item_size == element->item_info.size) {
+            return layout->decode;
+        }
     }
 
-    return ptr;
+    return bin_decode_faces_generic;
 }
 
-char *bin_parse_face(ByteOrdering ordering, char *ptr, const FaceElement *element, Indices *indices) {
+char *bin_decode_faces_generic(ByteOrdering ordering, char *ptr, const FaceElement *element, Polygons *polygons) {
     // Counts and indices are always non negative every number can be safely reinterpreted as unsigned
     for (size_t face_index = 0; face_index < element->count; ++face_index) {
         size_t index_count = bin_get_integer(ptr, ordering, element->count_info);
         ptr += element->count_info.size;
-        da_add(*indices, index_count);
+        da_add(*polygons, index_count);
 
         for (size_t index_index = 0; index_index < index_count; ++index_index) {
             size_t index = bin_get_integer(ptr, ordering, element->item_info);
             ptr += element->item_info.size;
-            da_add(*indices, index);
+            da_add(*polygons, index);
         }
     }
 
@@ -614,70 +995,162 @@ float bin_get_float(void *buffer, ByteOrdering ordering, DataTypeInfo info) {
     return info.size == 4 ? binary_buffer_to_f32_IEEE754(buffer, ordering) : binary_buffer_to_f64_IEEE754(buffer, ordering);
 }
 
+// ***************************
+// Skipping of other elements
+// ***************************
+
+char *skip_element(Format format, ByteOrdering ordering, char *ptr, const char *end, const OtherElement *element) {
+    // Every item of an ascii element is given in a line of its own
+    if (format == FORMAT_ASCII) {
+        for (size_t i = 0; i < element->count; ++i) {
+            char *line_end = memchr(ptr, '\n', end - ptr);
+            if (!line_end) {
+                if (i + 1 < element->count) {
+                    fprintf(stderr, "[ERR] Invalid format. The file ends within an element of %zu items.\n",
+                            element->count);
+                    exit(1);
+                }
+                return (char *)end;
+            }
+            ptr = line_end + 1;
+        }
+        return ptr;
+    }
+
+    // Items of a fixed size are skipped at once
+    if (!element->has_list) {
+        if (element->binary_size && (size_t)(end - ptr) / element->binary_size < element->count) {
+            fprintf(stderr, "[ERR] Invalid format. The file ends within an element of %zu items.\n", element->count);
+            exit(1);
+        }
+        return ptr + element->count * element->binary_size;
+    }
+
+    // Lists are skipped by their counts
+    for (size_t i = 0; i < element->count; ++i) {
+        for (size_t i_property = 0; i_property < element->properties.length; ++i_property) {
+            const OtherProperty *property = &element->properties.items[i_property];
+
+            size_t size = property->info.size;
+            if (property->is_list) {
+                if (end - ptr < property->count_info.size) goto truncated;
+                size *= bin_get_integer(ptr, ordering, property->count_info);
+                ptr += property->count_info.size;
+            }
+
+            if ((size_t)(end - ptr) < size) goto truncated;
+            ptr += size;
+        }
+    }
+
+    return ptr;
+
+truncated:
+    fprintf(stderr, "[ERR] Invalid format. The file ends within an element of %zu items.\n", element->count);
+    exit(1);
+}
+
 // *************
 // Triangluation
 // *************
 
-void triangulate_into_scene(const Vertices *vertices, const Vertices *normals, const Colors *colors, const Indices *indices,
+void triangulate_into_scene(Vertices *vertices, const Vertices *normals, Colors *colors, const Polygons *polygons,
                             Scene *scene) {
     Object object = {0};
 
     bool use_normals = normals->length > 0;
 
+    size_t vertex_count = vertices->length / 3;
+    if (vertex_count > UINT32_MAX) {
+        fprintf(stderr, "[ERR] Unsupported data. %zu vertices are given but at most %u vertices are supported.\n",
+                vertex_count, UINT32_MAX);
+        exit(1);
+    }
+
+    // Reserve the triangles of all polygons at once
+    size_t triangle_count = 0;
+    size_t max_polygon_count = 0;
     size_t polygon_index = 0;
-    size_t index_index = 0;
-    while (index_index < indices->length) {
-        size_t polygon_count = indices->items[index_index];
-        if (polygon_count != 3) {
-            fprintf(stderr,
-                    "[ERR] Unsupported data. %d-th polygon does not have 3 vertices. Only polygons with 3 vertices are "
-                    "supported. Rendering polygons with more vertices is ambigous.\n",
-                    polygon_index + 1);
+    for (size_t index_index = 0; index_index < polygons->length; index_index += 1 + polygons->items[index_index]) {
+        size_t polygon_count = polygons->items[index_index];
+        if (polygon_count < 3) {
+            fprintf(stderr, "[ERR] Invalid format. %zu-th polygon has %zu vertices but at least 3 are needed.\n",
+                    polygon_index + 1, polygon_count);
             exit(1);
         }
 
-        size_t index1 = indices->items[index_index + 1];
-        size_t index2 = indices->items[index_index + 2];
-        size_t index3 = indices->items[index_index + 3];
-
-        // printf("3 %d %d %d\n", index1, index2, index3);
-        // if (polygon_index == 10) exit(1);
-
-        Vector3 v1 = vector3_at(vertices->items, index1);
-        Vector3 v2 = vector3_at(vertices->items, index2);
-        Vector3 v3 = vector3_at(vertices->items, index3);
+        triangle_count += polygon_count - 2;
+        if (polygon_count > max_polygon_count) max_polygon_count = polygon_count;
+        ++polygon_index;
+    }
+    da_reserve(object.indices, 3 * triangle_count);
 
-        Color c1 = color_at(colors->items, index1);
-        Color c2 = color_at(colors->items, index2);
-        Color c3 = color_at(colors->items, index3);
+    // Corners of the triangles of one polygon as positions within the polygon
+    size_t *corners = malloc(3 * (max_polygon_count > 3 ? max_polygon_count - 2 : 1) * sizeof(size_t));
+    assert(corners && "Could not allocate the triangles of a polygon.");
 
-        // Swap vertices to match normals if needed
-        if (use_normals) {
-            Vector3 n1 = vector3_at(normals->items, index1);
-            Vector3 n2 = vector3_at(normals->items, index2);
-            Vector3 n3 = vector3_at(normals->items, index3);
-            Vector3 n = Vector3Scale(Vector3Add(n1, Vector3Add(n2, n3)), 1.0f / 3.0f);
-
-            if (order_vertices(&n, &v1, &v2, &v3)) {
-                Color temp = c2;
-                c2 = c3;
-                c3 = temp;
+    polygon_index = 0;
+    size_t index_index = 0;
+    while (index_index < polygons->length) {
+        size_t polygon_count = polygons->items[index_index];
+        const size_t *polygon = &polygons->items[index_index + 1];
+        for (size_t i = 0; i < polygon_count; ++i) {
+            if (polygon[i] >= vertex_count) {
+                fprintf(stderr,
+                        "[ERR] Invalid format. %zu-th polygon refers to vertex %zu but only %zu vertices are given.\n",
+                        polygon_index + 1, polygon[i], vertex_count);
+                exit(1);
             }
         }
 
-        // Add triangle to object
-        da_add_vector3(object.vertices, v1);
-        da_add_vector3(object.vertices, v2);
-        da_add_vector3(object.vertices, v3);
+        if (polygon_count == 3) {
+            corners[0] = 0;
+            corners[1] = 1;
+            corners[2] = 2;
+        } else {
+            triangulate_polygon(vertices->items, polygon, polygon_count, corners);
+        }
 
-        da_add_color(object.colors, c1);
-        da_add_color(object.colors, c2);
-        da_add_color(object.colors, c3);
+        for (size_t i_triangle = 0; i_triangle < polygon_count - 2; ++i_triangle) {
+            size_t index[3] = {polygon[corners[3 * i_triangle]], polygon[corners[3 * i_triangle + 1]],
+                               polygon[corners[3 * i_triangle + 2]]};
+
+            // Swap vertices to match normals if needed
+            if (use_normals) {
+                Vector3 v1 = vector3_at(vertices->items, index[0]);
+                Vector3 v2 = vector3_at(vertices->items, index[1]);
+                Vector3 v3 = vector3_at(vertices->items, index[2]);
+
+                Vector3 n1 = vector3_at(normals->items, index[0]);
+                Vector3 n2 = vector3_at(normals->items, index[1]);
+                Vector3 n3 = vector3_at(normals->items, index[2]);
+                Vector3 n = Vector3Scale(Vector3Add(n1, Vector3Add(n2, n3)), 1.0f / 3.0f);
+
+                if (order_vertices(&n, &v1, &v2, &v3)) {
+                    size_t temp = index[1];
+                    index[1] = index[2];
+                    index[2] = temp;
+                }
+            }
+
+            // Add triangle to object
+            da_add3(object.indices, index[0], index[1], index[2]);
+        }
 
         // Skip the count and the every polygon vertex
         index_index += 1 + polygon_count;
         ++polygon_index;
     }
+    free(corners);
+
+    // The object takes over the vertices and colors, which are only kept when there are triangles referring to them
+    if (object.indices.length) {
+        object.vertices = *vertices;
+        object.colors = *colors;
+    } else {
+        free(vertices->items);
+        free(colors->items);
+    }
 
     da_add(scene->objects, object);
 }
@@ -4,13 +4,35 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "../trace.h"
+#include "number.h"
+#include "parsing.h"
+
 #define BUFFER_SIZE 1024
 
+#define BINARY_MAGIC "P3TF"
+#define BINARY_HEADER_SIZE 12
+#define BINARY_BLOCK_TRIANGLES (1 << 14)  // Triangles published at once by the binary stream reader
+
+static int read_stream(void *arg);
+static int read_binary_stream(void *arg);
+static int read_shm_stream(void *arg);
+static void start_reader(thrd_start_t reader, StdinStream *stream);
+static void set_binary_mode(FILE *stream);
+static bool read_binary_header(FILE *stream, Color *color, size_t *triangle_count);
+static void parse_binary_header(const unsigned char *header, Color *color, size_t *triangle_count);
+static void read_binary_floats(FILE *stream, float *floats, size_t count);
 static Color read_color(char *buffer, char **end);
 static Vector3 read_vector3(char *buffer, char **end);
 
 void stdin_add_to_scene(FILE *stream, Scene *scene) {
     char buffer[BUFFER_SIZE];
+    TRACE_BEGIN(read, "stdin read object");
 
     Object object = {0};
 
@@ -37,15 +59,277 @@ void stdin_add_to_scene(FILE *stream, Scene *scene) {
         }
     }
 
+    TRACE_COUNT(read, "triangles", object.vertices.length / 9);
+    TRACE_END(read);
     da_add(scene->objects, object);
 }
 
+void stdin_add_binary_to_scene(FILE *stream, Scene *scene) {
+    set_binary_mode(stream);
+    TRACE_BEGIN(read, "stdin read binary object");
+
+    Color color;
+    size_t triangle_count;
+    if (!read_binary_header(stream, &color, &triangle_count)) {
+        fprintf(stderr, "[ERR] Expected the header of a binary object on stdin but the stream ended.\n");
+        exit(1);
+    }
+
+    // The triangles are copied straight into the object
+    Object object = {0};
+    object.vertices.length = object.vertices.capacity = 9 * triangle_count;
+    object.colors.length = object.colors.capacity = 12 * triangle_count;
+    if (triangle_count) {
+        object.vertices.items = malloc(object.vertices.length * sizeof(float));
+        object.colors.items = malloc(object.colors.length * sizeof(unsigned char));
+        if (!object.vertices.items || !object.colors.items) {
+            fprintf(stderr, "[ERR] Could not allocate a binary object with %zu triangles.\n", triangle_count);
+            exit(1);
+        }
+    }
+
+    read_binary_floats(stream, object.vertices.items, object.vertices.length);
+    scene_fill_colors(color, object.colors.items, object.colors.length);
+
+    TRACE_COUNT(read, "bytes", object.vertices.length * sizeof(float));
+    TRACE_COUNT(read, "triangles", triangle_count);
+    TRACE_END(read);
+    da_add(scene->objects, object);
+}
+
+void stdin_stream_start(FILE *input, bool binary, StdinStream *stream) {
+    *stream = (StdinStream){.input = input, .binary = binary};
+    if (binary) set_binary_mode(input);
+
+    start_reader(binary ? read_binary_stream : read_stream, stream);
+}
+
+void stdin_stream_start_shm(ShmRing *ring, StdinStream *stream) {
+    *stream = (StdinStream){.binary = true, .ring = ring};
+    start_reader(read_shm_stream, stream);
+}
+
+bool stdin_stream_take(StdinStream *stream, Object *taken) {
+    mtx_lock(&stream->lock);
+    *taken = stream->pending;
+    stream->pending = (Object){0};
+    bool finished = stream->finished;
+    mtx_unlock(&stream->lock);
+
+    return !finished || taken->vertices.length;
+}
+
+void stdin_stream_stop(StdinStream *stream) {
+    mtx_lock(&stream->lock);
+    bool finished = stream->finished;
+    mtx_unlock(&stream->lock);
+
+    // The reader of a ring stops once it is closed, it can be joined
+    if (!finished && stream->ring) {
+        shm_ring_close(stream->ring);
+        finished = true;
+    }
+
+    // The reader still owns the stream, its resources are released on process exit
+    if (!finished) {
+        thrd_detach(stream->reader);
+        return;
+    }
+
+    thrd_join(stream->reader, NULL);
+    if (stream->ring) shm_ring_free(stream->ring);
+    mtx_destroy(&stream->lock);
+    free(stream->pending.vertices.items);
+    free(stream->pending.colors.items);
+}
+
+int read_stream(void *arg) {
+    StdinStream *stream = arg;
+    char buffer[BUFFER_SIZE];
+
+    // Every object starts with its color, until the stream ends
+    while (fgets(buffer, BUFFER_SIZE, stream->input)) {
+        Color color = read_color(buffer, NULL);
+
+        while (fgets(buffer, BUFFER_SIZE, stream->input)) {
+            if (strncmp(buffer, "end", 3) == 0) {
+                break;
+            }
+
+            Vector3 vertices[3];
+            char *current = buffer;
+            for (int i = 0; i < 3; ++i) {
+                vertices[i] = read_vector3(current, &current);
+            }
+
+            // Publish every triangle right away, producers might emit them slowly
+            mtx_lock(&stream->lock);
+            for (int i = 0; i < 3; ++i) {
+                da_add_vector3(stream->pending.vertices, vertices[i]);
+                da_add_color(stream->pending.colors, color);
+            }
+            mtx_unlock(&stream->lock);
+        }
+    }
+
+    mtx_lock(&stream->lock);
+    stream->finished = true;
+    mtx_unlock(&stream->lock);
+
+    return 0;
+}
+
+int read_binary_stream(void *arg) {
+    StdinStream *stream = arg;
+
+    float *vertices = malloc(BINARY_BLOCK_TRIANGLES * 9 * sizeof(float));
+    unsigned char *colors = malloc(BINARY_BLOCK_TRIANGLES * 12 * sizeof(unsigned char));
+    assert(vertices && colors && "Could not allocate the blocks of the binary stream.");
+
+    Color color;
+    size_t triangle_count;
+    while (read_binary_header(stream->input, &color, &triangle_count)) {
+        scene_fill_colors(color, colors, BINARY_BLOCK_TRIANGLES * 12);
+
+        // Publish large frames in blocks, so they show up while the rest is still transmitted
+        while (triangle_count) {
+            size_t count = triangle_count < BINARY_BLOCK_TRIANGLES ? triangle_count : BINARY_BLOCK_TRIANGLES;
+            TRACE_BEGIN(block, "stdin read binary block");
+            read_binary_floats(stream->input, vertices, 9 * count);
+            triangle_count -= count;
+            TRACE_COUNT(block, "triangles", count);
+            TRACE_END(block);
+
+            mtx_lock(&stream->lock);
+            object_append_triangles(&stream->pending, vertices, colors, count);
+            mtx_unlock(&stream->lock);
+        }
+    }
+
+    free(colors);
+    free(vertices);
+
+    mtx_lock(&stream->lock);
+    stream->finished = true;
+    mtx_unlock(&stream->lock);
+
+    return 0;
+}
+
+int read_shm_stream(void *arg) {
+    StdinStream *stream = arg;
+
+    float *vertices = malloc(BINARY_BLOCK_TRIANGLES * 9 * sizeof(float));
+    unsigned char *colors = malloc(BINARY_BLOCK_TRIANGLES * 12 * sizeof(unsigned char));
+    assert(vertices && colors && "Could not allocate the blocks of the shared memory stream.");
+
+    // A short read means the ring was closed, a partial object is dropped
+    unsigned char header[BINARY_HEADER_SIZE];
+    while (shm_ring_read(stream->ring, header, BINARY_HEADER_SIZE) == BINARY_HEADER_SIZE) {
+        Color color;
+        size_t triangle_count;
+        parse_binary_header(header, &color, &triangle_count);
+        scene_fill_colors(color, colors, BINARY_BLOCK_TRIANGLES * 12);
+
+        // The floats are in the byte order of the host, no conversion is needed
+        while (triangle_count) {
+            size_t count = triangle_count < BINARY_BLOCK_TRIANGLES ? triangle_count : BINARY_BLOCK_TRIANGLES;
+            size_t size = 9 * count * sizeof(float);
+            TRACE_BEGIN(block, "shm read block");
+            if (shm_ring_read(stream->ring, vertices, size) != size) break;
+            triangle_count -= count;
+            TRACE_COUNT(block, "bytes", size);
+            TRACE_END(block);
+
+            mtx_lock(&stream->lock);
+            object_append_triangles(&stream->pending, vertices, colors, count);
+            mtx_unlock(&stream->lock);
+        }
+    }
+
+    free(colors);
+    free(vertices);
+
+    mtx_lock(&stream->lock);
+    stream->finished = true;
+    mtx_unlock(&stream->lock);
+
+    return 0;
+}
+
+void start_reader(thrd_start_t reader, StdinStream *stream) {
+    if (mtx_init(&stream->lock, mtx_plain) != thrd_success) {
+        fprintf(stderr, "[ERR] Could not create a mutex for the stdin stream.\n");
+        exit(1);
+    }
+
+    if (thrd_create(&stream->reader, reader, stream) != thrd_success) {
+        fprintf(stderr, "[ERR] Could not start the reader of the stdin stream.\n");
+        exit(1);
+    }
+}
+
+void set_binary_mode(FILE *stream) {
+#if defined(_WIN32)
+    // Stop the C runtime from translating line endings within the floats
+    _setmode(_fileno(stream), _O_BINARY);
+#else
+    (void)stream;
+#endif
+}
+
+bool read_binary_header(FILE *stream, Color *color, size_t *triangle_count) {
+    unsigned char header[BINARY_HEADER_SIZE];
+    size_t n = fread(header, 1, BINARY_HEADER_SIZE, stream);
+
+    // The stream may only end between objects
+    if (n == 0 && feof(stream)) return false;
+
+    if (n != BINARY_HEADER_SIZE) {
+        fprintf(stderr, "[ERR] The stream ended within the header of a binary object on stdin.\n");
+        exit(1);
+    }
+
+    parse_binary_header(header, color, triangle_count);
+    return true;
+}
+
+void parse_binary_header(const unsigned char *header, Color *color, size_t *triangle_count) {
+    if (memcmp(header, BINARY_MAGIC, 4) != 0) {
+        fprintf(stderr, "[ERR] Invalid header of a binary object. Expected \"%s\", color and triangle count.\n",
+                BINARY_MAGIC);
+        exit(1);
+    }
+
+    *color = (Color){header[4], header[5], header[6], header[7]};
+    *triangle_count = (size_t)header[8] | (size_t)header[9] << 8 | (size_t)header[10] << 16 | (size_t)header[11] << 24;
+}
+
+void read_binary_floats(FILE *stream, float *floats, size_t count) {
+    if (fread(floats, sizeof(float), count, stream) != count) {
+        fprintf(stderr, "[ERR] The stream ended within the triangles of a binary object on stdin.\n");
+        exit(1);
+    }
+
+#if !defined(HOST_LITTLE_ENDIAN)
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char *bytes = (unsigned char *)&floats[i];
+        unsigned char temp = bytes[0];
+        bytes[0] = bytes[3];
+        bytes[3] = temp;
+        temp = bytes[1];
+        bytes[1] = bytes[2];
+        bytes[2] = temp;
+    }
+#endif
+}
+
 Color read_color(char *buffer, char **end) {
     char color[4];
     char *peak;
 
     for (int i = 0; i < 4; ++i) {
-        color[i] = strtoul(buffer, &peak, 10);
+        color[i] = str_to_i64(buffer, &peak);
 
         if (peak == buffer) {
             fprintf(stderr, "[ERR] Expected a number [0 - 255] for the %d. color component at ->%s within the buffer.\n",
@@ -67,7 +351,7 @@ Vector3 read_vector3(char *buffer, char **end) {
     char *peak;
 
     for (int i = 0; i < 3; ++i) {
-        vec[i] = strtof(buffer, &peak);
+        vec[i] = str_to_f32(buffer, &peak);
 
         if (peak == buffer) {
             fprintf(
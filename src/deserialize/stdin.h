@@ -2,8 +2,44 @@
 #define PRINT3_DESERIALIZE_STDIN_H_
 
 #include "../scene.h"
+#include "../shm.h"
 #include <stdio.h>
+#include <threads.h>
+
+// Objects read by a background thread while the viewer is running
+typedef struct StdinStream {
+    FILE *input;
+    bool binary;
+    ShmRing *ring;  // Read instead of the input, if set. Owned by the stream
+    thrd_t reader;
+    mtx_t lock;
+    Object pending;  // Triangle soup of everything read since the last take
+    bool finished;
+} StdinStream;
 
 void stdin_add_to_scene(FILE *stream, Scene *scene);
 
+// Binary objects are framed by a 12 byte header followed by the packed triangles:
+// - "P3TF"
+// - {red: UINT8} {green: UINT8} {blue: UINT8} {alpha: UINT8}
+// - {triangle count: UINT32 little endian}
+// - 9 REAL32 little endian per triangle: v1x v1y v1z v2x v2y v2z v3x v3y v3z
+void stdin_add_binary_to_scene(FILE *stream, Scene *scene);
+
+// Read objects until the end of the stream.
+// Text objects are terminated by "end", binary objects consist of one frame each.
+void stdin_stream_start(FILE *input, bool binary, StdinStream *stream);
+
+// Read binary objects from the consumer side of a shared memory ring until the producer closes it.
+// The stream takes ownership of the ring.
+void stdin_stream_start_shm(ShmRing *ring, StdinStream *stream);
+
+// Move the triangles read since the last call into taken.
+// Returns false once the stream ended and all of its triangles were taken.
+bool stdin_stream_take(StdinStream *stream, Object *taken);
+
+// The reader is detached if the stream did not end yet, it might block on the input until the process exits.
+// A shared memory ring is closed instead, so its reader ends as well.
+void stdin_stream_stop(StdinStream *stream);
+
 #endif
@@ -4,25 +4,94 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "../parallel.h"
+#include "../trace.h"
+#include "number.h"
 #include "parsing.h"
 #include "raymath.h"
 
+// The 8 wide winding test is compiled with the PRINT3_AVX2 option, otherwise the SSE2 one is used
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STL_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define ASCII_FACET_KEYWORD "facet normal "
+
+// Smallest chunk of an ascii file that is parsed on its own
+#define ASCII_MIN_CHUNK_SIZE (1 << 20)
+
+// Number of chunks per job to balance uneven chunks
+#define ASCII_CHUNKS_PER_JOB 4
+
+// Range of facets of an ascii file which is parsed independently from the others
+typedef struct AsciiChunk {
+    char *begin;
+    char *end;
+    Object object;
+} AsciiChunk;
+
+typedef struct AsciiChunks {
+    AsciiChunk *items;
+    size_t length;
+    Color fallback_color;
+} AsciiChunks;
+
+// Size of a facet record in a binary file: normal, 3 vertices and the attribute byte count
+#define BIN_FACET_SIZE (12 * 4 + 2)
+
+// Facets decoded together for the batched winding test
+#define BIN_BLOCK_SIZE 256
+
+// Facets decoded by a single task of the worker pool
+#define BIN_TASK_FACETS (1 << 16)
+
+// Facets of a binary file and the vertex buffer they are decoded to
+typedef struct BinFacets {
+    const uint8_t *buffer;
+    size_t count;
+    float *vertices;
+} BinFacets;
+
+// Block of facets with one array per coordinate (normal xyz, v1 xyz, v2 xyz, v3 xyz)
+typedef struct FacetBlock {
+    _Alignas(32) float coords[12][BIN_BLOCK_SIZE];
+    bool flip[BIN_BLOCK_SIZE];
+} FacetBlock;
+
 // scii implementation
 static void ascii_stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene);
+static void ascii_split_chunks(char *begin, char *end, AsciiChunks *chunks);
+static void ascii_parse_chunk_task(void *context, size_t index);
+static void ascii_parse_facets(char *ptr, const char *end, Color fallback_color, Object *obj);
+static void ascii_concat_chunks(const AsciiChunks *chunks, Object *obj);
 static void ascii_str_to_vector3(char *ptr, char **end, Vector3 *vector);
 
 // binary implementation
 static void bin_stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene);
+static void bin_decode_task(void *context, size_t index);
+static void bin_decode_block(const uint8_t *ptr, size_t count, float *vertices);
+static void bin_test_winding(FacetBlock *block, size_t count);
 
-void stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene) {
+void stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene, DeserializerTiming *timing) {
     // determine it is binary or ascii format
 
     // First 80 byte is the header in binary
     // Ascii starts with solid keyword and binary header is permitted to start with same bytes
     if (strncmp(buffer, "solid", 5) == 0) {
+        TRACE_BEGIN(ascii, "stl ascii");
         ascii_stl_deserialize(buffer, size, fallback_color, scene);
+        TRACE_COUNT(ascii, "bytes", size);
+        TRACE_END(ascii);
     } else {
+        TRACE_BEGIN(bin, "stl binary");
         bin_stl_deserialize(buffer, size, fallback_color, scene);
+        TRACE_COUNT(bin, "bytes", size);
+        TRACE_END(bin);
     }
 }
 
@@ -50,18 +119,69 @@ void ascii_stl_deserialize(void *buffer, size_t size, Color fallback_color, Scen
     char *ptr = buffer;
     char *peak;
 
-    // Create a new object
-    Object obj = {0};
-
     // Skip the beginning of the solid block
     skip_or_err("solid", "[ERR] Invalid format. No start of a solid block found.\n");
     skip_or_err("\n", "[ERR] Invalid format. No body of a solid block found.\n");
 
+    // Split the body at facet boundaries and parse the chunks concurrently
+    AsciiChunks chunks = {.fallback_color = fallback_color};
+    ascii_split_chunks(ptr, (char *)buffer + size, &chunks);
+    parallel_for(chunks.length, ascii_parse_chunk_task, &chunks);
+
+    // Join the chunks in file order to a new object
+    Object obj = {0};
+    TRACE_BEGIN(concat, "stl concat chunks");
+    ascii_concat_chunks(&chunks, &obj);
+    TRACE_END(concat);
+    free(chunks.items);
+
+    // Add the created object to the scene
+    da_add(scene->objects, obj);
+}
+
+void ascii_split_chunks(char *begin, char *end, AsciiChunks *chunks) {
+    size_t size = end - begin;
+
+    size_t chunk_count = ASCII_CHUNKS_PER_JOB * parallel_get_job_count();
+    if (chunk_count > size / ASCII_MIN_CHUNK_SIZE) chunk_count = size / ASCII_MIN_CHUNK_SIZE;
+    if (chunk_count < 1) chunk_count = 1;
+
+    chunks->items = calloc(chunk_count, sizeof(AsciiChunk));
+    assert(chunks->items && "Could not allocate the chunks of the ascii file.");
+    chunks->length = chunk_count;
+
+    // Every chunk starts at a facet keyword, so it holds whole facets and the
+    // chunks together yield the facets in the same order as a single pass.
+    chunks->items[0].begin = begin;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        char *ptr = begin + size * i / chunk_count;
+        if (ptr < chunks->items[i - 1].begin) ptr = chunks->items[i - 1].begin;
+
+        char *facet = strstr(ptr, ASCII_FACET_KEYWORD);
+        chunks->items[i].begin = facet ? facet : end;
+        chunks->items[i - 1].end = chunks->items[i].begin;
+    }
+    chunks->items[chunk_count - 1].end = end;
+}
+
+void ascii_parse_chunk_task(void *context, size_t index) {
+    AsciiChunks *chunks = context;
+    AsciiChunk *chunk = &chunks->items[index];
+    TRACE_BEGIN(parse, "stl parse chunk");
+    ascii_parse_facets(chunk->begin, chunk->end, chunks->fallback_color, &chunk->object);
+    TRACE_COUNT(parse, "bytes", chunk->end - chunk->begin);
+    TRACE_COUNT(parse, "triangles", chunk->object.vertices.length / 9);
+    TRACE_END(parse);
+}
+
+void ascii_parse_facets(char *ptr, const char *end, Color fallback_color, Object *obj) {
+    char *peak;
+
     while (1) {
-        // Stop when no mor facet is defined
-        peak = str_skip(ptr, "facet normal ");
-        if (!peak) break;
-        ptr = peak;
+        // Stop when no mor facet starts within the chunk
+        peak = strstr(ptr, ASCII_FACET_KEYWORD);
+        if (!peak || peak >= end) break;
+        ptr = peak + strlen(ASCII_FACET_KEYWORD);
 
         // Parse out the normal vector
         Vector3 normal;
@@ -78,13 +198,47 @@ void ascii_stl_deserialize(void *buffer, size_t size, Color fallback_color, Scen
 
         // Add the vertices to the scene and the facet to the object
         for (int i = 0; i < 3; ++i) {
-            da_add_vector3(obj.vertices, v[i]);
-            da_add_color(obj.colors, fallback_color);
+            da_add_vector3(obj->vertices, v[i]);
+            da_add_color(obj->colors, fallback_color);
         }
     }
+}
 
-    // Add the created object to the scene
-    da_add(scene->objects, obj);
+void ascii_concat_chunks(const AsciiChunks *chunks, Object *obj) {
+    // A single chunk is taken over without copying
+    if (chunks->length == 1) {
+        *obj = chunks->items[0].object;
+        return;
+    }
+
+    size_t vertices_length = 0;
+    size_t colors_length = 0;
+    for (size_t i = 0; i < chunks->length; ++i) {
+        vertices_length += chunks->items[i].object.vertices.length;
+        colors_length += chunks->items[i].object.colors.length;
+    }
+
+    obj->vertices.items = malloc(vertices_length * sizeof(obj->vertices.items[0]));
+    obj->vertices.capacity = vertices_length;
+    obj->colors.items = malloc(colors_length * sizeof(obj->colors.items[0]));
+    obj->colors.capacity = colors_length;
+    assert((obj->vertices.items || !vertices_length) && (obj->colors.items || !colors_length) &&
+           "Could not allocate the object of the ascii file.");
+
+    for (size_t i = 0; i < chunks->length; ++i) {
+        const Object *chunk_obj = &chunks->items[i].object;
+
+        memcpy(&obj->vertices.items[obj->vertices.length], chunk_obj->vertices.items,
+               chunk_obj->vertices.length * sizeof(obj->vertices.items[0]));
+        obj->vertices.length += chunk_obj->vertices.length;
+
+        memcpy(&obj->colors.items[obj->colors.length], chunk_obj->colors.items,
+               chunk_obj->colors.length * sizeof(obj->colors.items[0]));
+        obj->colors.length += chunk_obj->colors.length;
+
+        free(chunk_obj->vertices.items);
+        free(chunk_obj->colors.items);
+    }
 }
 
 void ascii_str_to_vector3(char *ptr, char **end, Vector3 *vector) {
@@ -93,7 +247,7 @@ void ascii_str_to_vector3(char *ptr, char **end, Vector3 *vector) {
     char *peak;
     float comp[3];
     for (size_t i = 0; i < 3; ++i) {
-        comp[i] = strtof(ptr, &peak);
+        comp[i] = str_to_f32(ptr, &peak);
         if (peak == ptr) return;
         ptr = peak;
     }
@@ -128,19 +282,151 @@ void bin_stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene
     ptr += 4;
 
     // Check if file size matches the computed size
-    size_t computed_size = 80 + 4 + facet_count * (12 * 4 + 2);
+    size_t computed_size = 80 + 4 + (size_t)facet_count * BIN_FACET_SIZE;
     if (size != computed_size) {
         fprintf(stderr, "[ERR] Invalid format. File has %u bytes but according to the content should have %u bytes.\n", size,
                 computed_size);
         exit(1);
     }
 
-    // Create a new object
+    // Create a new object with the final size, since the facet count is known upfront
     Object obj = {0};
+    obj.vertices.length = obj.vertices.capacity = 9 * (size_t)facet_count;
+    obj.vertices.items = malloc(obj.vertices.capacity * sizeof(obj.vertices.items[0]));
+    obj.colors.length = obj.colors.capacity = 12 * (size_t)facet_count;
+    obj.colors.items = malloc(obj.colors.capacity * sizeof(obj.colors.items[0]));
+    assert(((obj.vertices.items && obj.colors.items) || !facet_count) && "Could not allocate the object of the stl file.");
+
+    scene_fill_colors(fallback_color, obj.colors.items, obj.colors.length);
+
+    // Decode the facets in slices on the worker pool
+    BinFacets facets = {
+        .buffer = ptr,
+        .count = facet_count,
+        .vertices = obj.vertices.items,
+    };
+    parallel_for((facet_count + BIN_TASK_FACETS - 1) / BIN_TASK_FACETS, bin_decode_task, &facets);
+
+    // Add the created object to the scene
+    da_add(scene->objects, obj);
+}
+
+void bin_decode_task(void *context, size_t index) {
+    BinFacets *facets = context;
+
+    size_t begin = index * BIN_TASK_FACETS;
+    size_t end = begin + BIN_TASK_FACETS < facets->count ? begin + BIN_TASK_FACETS : facets->count;
+
+    TRACE_BEGIN(decode, "stl decode facets");
+    for (size_t i = begin; i < end; i += BIN_BLOCK_SIZE) {
+        size_t count = i + BIN_BLOCK_SIZE < end ? BIN_BLOCK_SIZE : end - i;
+        bin_decode_block(&facets->buffer[i * BIN_FACET_SIZE], count, &facets->vertices[9 * i]);
+    }
+    TRACE_COUNT(decode, "triangles", end - begin);
+    TRACE_END(decode);
+}
+
+#if defined(HOST_LITTLE_ENDIAN)
+
+void bin_decode_block(const uint8_t *ptr, size_t count, float *vertices) {
+    FacetBlock block;
+
+    // Transpose the records into one array per coordinate, the floats can be copied as they are on the host
+    for (size_t i = 0; i < count; ++i) {
+        float coords[12];
+        memcpy(coords, &ptr[i * BIN_FACET_SIZE], sizeof(coords));
+
+        for (size_t i_coord = 0; i_coord < 12; ++i_coord) {
+            block.coords[i_coord][i] = coords[i_coord];
+        }
+    }
+
+    bin_test_winding(&block, count);
+
+    // Write the vertices and swap v2 and v3 where the order does not match the normal
+    for (size_t i = 0; i < count; ++i) {
+        size_t second = block.flip[i] ? 9 : 6;
+        size_t third = block.flip[i] ? 6 : 9;
+
+        float *v = &vertices[9 * i];
+        v[0] = block.coords[3][i];
+        v[1] = block.coords[4][i];
+        v[2] = block.coords[5][i];
+        v[3] = block.coords[second][i];
+        v[4] = block.coords[second + 1][i];
+        v[5] = block.coords[second + 2][i];
+        v[6] = block.coords[third][i];
+        v[7] = block.coords[third + 1][i];
+        v[8] = block.coords[third + 2][i];
+    }
+}
+
+void bin_test_winding(FacetBlock *block, size_t count) {
+    float(*c)[BIN_BLOCK_SIZE] = block->coords;
+    size_t i = 0;
+
+    // Same operations in the same order as order_vertices, so the vectorized test decides identically
+
+#if defined(__AVX__)
+    for (; i + 8 <= count; i += 8) {
+        __m256 e1x = _mm256_sub_ps(_mm256_load_ps(&c[6][i]), _mm256_load_ps(&c[3][i]));
+        __m256 e1y = _mm256_sub_ps(_mm256_load_ps(&c[7][i]), _mm256_load_ps(&c[4][i]));
+        __m256 e1z = _mm256_sub_ps(_mm256_load_ps(&c[8][i]), _mm256_load_ps(&c[5][i]));
+        __m256 e2x = _mm256_sub_ps(_mm256_load_ps(&c[9][i]), _mm256_load_ps(&c[3][i]));
+        __m256 e2y = _mm256_sub_ps(_mm256_load_ps(&c[10][i]), _mm256_load_ps(&c[4][i]));
+        __m256 e2z = _mm256_sub_ps(_mm256_load_ps(&c[11][i]), _mm256_load_ps(&c[5][i]));
+
+        __m256 cx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e1z, e2y));
+        __m256 cy = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e1x, e2z));
+        __m256 cz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e1y, e2x));
+
+        __m256 dot = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(&c[0][i]), cx), _mm256_mul_ps(_mm256_load_ps(&c[1][i]), cy)),
+            _mm256_mul_ps(_mm256_load_ps(&c[2][i]), cz));
 
-    // add all facets to the the new object
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(dot, _mm256_setzero_ps(), _CMP_LT_OQ));
+        for (int k = 0; k < 8; ++k) block->flip[i + k] = (mask >> k) & 1;
+    }
+#endif
+
+#if defined(STL_USE_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128 e1x = _mm_sub_ps(_mm_load_ps(&c[6][i]), _mm_load_ps(&c[3][i]));
+        __m128 e1y = _mm_sub_ps(_mm_load_ps(&c[7][i]), _mm_load_ps(&c[4][i]));
+        __m128 e1z = _mm_sub_ps(_mm_load_ps(&c[8][i]), _mm_load_ps(&c[5][i]));
+        __m128 e2x = _mm_sub_ps(_mm_load_ps(&c[9][i]), _mm_load_ps(&c[3][i]));
+        __m128 e2y = _mm_sub_ps(_mm_load_ps(&c[10][i]), _mm_load_ps(&c[4][i]));
+        __m128 e2z = _mm_sub_ps(_mm_load_ps(&c[11][i]), _mm_load_ps(&c[5][i]));
+
+        __m128 cx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+        __m128 cy = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+        __m128 cz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(&c[0][i]), cx), _mm_mul_ps(_mm_load_ps(&c[1][i]), cy)),
+                                _mm_mul_ps(_mm_load_ps(&c[2][i]), cz));
+
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()));
+        for (int k = 0; k < 4; ++k) block->flip[i + k] = (mask >> k) & 1;
+    }
+#endif
+
+    // Remaining facets or hosts without SIMD support
+    for (; i < count; ++i) {
+        Vector3 normal = {c[0][i], c[1][i], c[2][i]};
+        Vector3 v1 = {c[3][i], c[4][i], c[5][i]};
+        Vector3 v2 = {c[6][i], c[7][i], c[8][i]};
+        Vector3 v3 = {c[9][i], c[10][i], c[11][i]};
+
+        block->flip[i] = order_vertices(&normal, &v1, &v2, &v3);
+    }
+}
+
+#else
+
+void bin_decode_block(const uint8_t *ptr, size_t count, float *vertices) {
+    // Decode every float byte by byte on big endian hosts
     float coords[12];
-    for (size_t i_facet = 0; i_facet < facet_count; ++i_facet) {
+    for (size_t i_facet = 0; i_facet < count; ++i_facet) {
         // Read all coordinates for the facet
         for (size_t i_coord = 0; i_coord < 12; ++i_coord) {
             coords[i_coord] = binary_buffer_to_f32_IEEE754(ptr, ORDERING_LITTLE_ENDIAN);
@@ -152,21 +438,16 @@ void bin_stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene
 
         // Place the coordinates in vector3 structs
         Vector3 normal = {coords[0], coords[1], coords[2]};
-        Vector3 v1 = {coords[3], coords[4], coords[5]};
-        Vector3 v2 = {coords[6], coords[7], coords[8]};
-        Vector3 v3 = {coords[9], coords[10], coords[11]};
+        Vector3 v[3] = {{coords[3], coords[4], coords[5]}, {coords[6], coords[7], coords[8]}, {coords[9], coords[10], coords[11]}};
 
-        order_vertices(&normal, &v1, &v2, &v3);
-
-        da_add_vector3(obj.vertices, v1);
-        da_add_vector3(obj.vertices, v2);
-        da_add_vector3(obj.vertices, v3);
+        order_vertices(&normal, &v[0], &v[1], &v[2]);
 
-        da_add_color(obj.colors, fallback_color);
-        da_add_color(obj.colors, fallback_color);
-        da_add_color(obj.colors, fallback_color);
+        for (size_t i = 0; i < 3; ++i) {
+            vertices[9 * i_facet + 3 * i] = v[i].x;
+            vertices[9 * i_facet + 3 * i + 1] = v[i].y;
+            vertices[9 * i_facet + 3 * i + 2] = v[i].z;
+        }
     }
-
-    // Add the created object to the scene
-    da_add(scene->objects, obj);
 }
+
+#endif
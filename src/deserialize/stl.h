@@ -2,7 +2,8 @@
 #define PRINT3_DESERIALIZE_STL_H_
 
 #include "../scene.h"
+#include "memory.h"
 
-void stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene);
+void stl_deserialize(void *buffer, size_t size, Color fallback_color, Scene *scene, DeserializerTiming *timing);
 
 #endif
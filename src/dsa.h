@@ -13,6 +13,16 @@
         (da).items[(da).length++] = item;                                            \
     } while (0)
 
+// Grow the capacity to at least count items, so that many items are added without reallocation
+#define da_reserve(da, count)                                                        \
+    do {                                                                             \
+        if ((count) > (da).capacity) {                                               \
+            (da).capacity = (count);                                                 \
+            (da).items = realloc((da).items, (da).capacity * sizeof((da).items[0])); \
+            assert((da).items && "Could not resize dynamic array.");                 \
+        }                                                                            \
+    } while (0)
+
 #define da_add3(da, item1, item2, item3) \
     da_add(da, item1);                   \
     da_add(da, item2);                   \
@@ -0,0 +1,662 @@
+#include "lod.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsa.h"
+#include "parallel.h"
+#include "trace.h"
+
+// Boundary edges are held in place by planes perpendicular to their triangle, weighted against the triangle planes
+#define BOUNDARY_WEIGHT 100.0
+
+// Collapses turning a remaining triangle by more than about 80 degrees would fold the surface, they are rejected
+#define MIN_NORMAL_COSINE 0.2f
+
+// Loops over vertices, faces, edges or collapses look at the cancel flag once per this many iterations
+#define CANCEL_CHECK_INTERVAL 4096
+
+#define NO_VERTEX UINT32_MAX
+
+// Digit of the radix sort of the edges
+#define RADIX_BITS 16
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+// Symmetric 4x4 matrix of the squared distances to a set of planes: xx xy xz xw yy yz yw zz zw ww
+typedef struct Quadric {
+    double q[10];
+} Quadric;
+
+// Move the vertex from onto the vertex to, both are representatives of their welded vertices
+typedef struct Collapse {
+    float cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_version;
+    uint32_t to_version;
+} Collapse;
+
+typedef struct Collapses {
+    Collapse *items;  // Binary min heap by cost
+    size_t length;
+    size_t capacity;
+} Collapses;
+
+typedef struct Neighbors {
+    uint32_t *items;
+    size_t length;
+    size_t capacity;
+} Neighbors;
+
+typedef struct EdgeRef {
+    uint64_t key;  // Smaller vertex in the upper 32 bits
+    uint32_t face;
+} EdgeRef;
+
+// Welded, indexed copy of the object and the state of its simplification.
+// Collapsed vertices keep their faces, the corners are resolved to their representatives when needed.
+typedef struct Simplification {
+    const Object *obj;
+    const atomic_bool *canceled;  // May be NULL
+    size_t vertex_count;
+    uint32_t *sources;  // Vertex of the object for every welded vertex
+    size_t face_count;
+    size_t live_face_count;
+    uint32_t *faces;  // 3 welded vertices per face
+    bool *dead_faces;
+    uint32_t *face_offsets;  // The faces of vertex v are face_lists[face_offsets[v] .. face_offsets[v + 1]]
+    uint32_t *face_lists;
+    uint32_t *parents;  // Vertex a collapsed vertex was moved onto, representatives are their own parent
+    uint32_t *next_members;  // Vertices collapsed onto a representative as a linked list, starting at itself
+    uint32_t *last_members;
+    uint32_t *versions;  // Incremented whenever the neighborhood of a representative changes
+    Quadric *quadrics;
+    Collapses heap;
+    Neighbors neighbors;  // Reused by every collapse
+} Simplification;
+
+typedef struct Vector3d {
+    double x;
+    double y;
+    double z;
+} Vector3d;
+
+static bool weld_vertices(const Object *obj, Simplification *s);
+static bool add_face_quadrics(Simplification *s);
+static bool get_sorted_edges(const Simplification *s, EdgeRef **edges, size_t *count);
+static bool sort_edges(const Simplification *s, EdgeRef **edges, size_t count);
+static bool add_boundary_quadrics(Simplification *s, const EdgeRef *edges, size_t count);
+static bool link_faces(Simplification *s);
+static bool is_canceled(const Simplification *s, size_t iteration);
+static bool collapse_cheapest_edge(Simplification *s);
+static bool is_collapse_valid(Simplification *s, uint32_t from, uint32_t to);
+static void collapse(Simplification *s, uint32_t from, uint32_t to);
+static void push_collapse(Simplification *s, uint32_t a, uint32_t b);
+static void write_simplified(Simplification *s, Object *simplified);
+static void free_simplification(Simplification *s);
+static uint32_t find_representative(Simplification *s, uint32_t vertex);
+static Vector3d get_position(const Simplification *s, uint32_t vertex);
+static void add_plane_quadric(Vector3d normal, double d, double weight, Quadric *quadric);
+static double get_quadric_error(const Quadric *quadric, Vector3d p);
+static Vector3d get_face_normal(Vector3d a, Vector3d b, Vector3d c);
+static void heap_push(Collapses *heap, Collapse collapse);
+static Collapse heap_pop(Collapses *heap);
+static int build_levels(void *arg);
+static void build_object_levels_task(void *context, size_t index);
+
+bool lod_simplify(const Object *obj, size_t target_triangle_count, const atomic_bool *canceled, Object *simplified) {
+    Simplification s = {.obj = obj, .canceled = canceled};
+    EdgeRef *edges = NULL;
+    size_t edge_count = 0;
+
+    // Every stage looks at the cancel flag while it runs
+    if (!weld_vertices(obj, &s) || !add_face_quadrics(&s) || !get_sorted_edges(&s, &edges, &edge_count) ||
+        !add_boundary_quadrics(&s, edges, edge_count) || !link_faces(&s)) {
+        goto canceled;
+    }
+
+    // Every edge starts out with its cheaper direction
+    for (size_t i = 0; i < edge_count; ++i) {
+        if (is_canceled(&s, i)) goto canceled;
+        if (i && edges[i].key == edges[i - 1].key) continue;
+        push_collapse(&s, edges[i].key >> 32, edges[i].key & UINT32_MAX);
+    }
+    free(edges);
+    edges = NULL;
+
+    size_t collapse_count = 0;
+    while (s.live_face_count > target_triangle_count && collapse_cheapest_edge(&s)) {
+        if (is_canceled(&s, ++collapse_count)) goto canceled;
+    }
+
+    write_simplified(&s, simplified);
+    free_simplification(&s);
+    return true;
+
+canceled:
+    free(edges);
+    free_simplification(&s);
+    return false;
+}
+
+void lod_build_start(const Scene *scene, LodBuild *build) {
+    build->scene = scene;
+    build->levels = calloc(scene->objects.length, sizeof(LodLevels));
+    assert((build->levels || !scene->objects.length) && "Could not allocate the levels of detail.");
+    atomic_init(&build->finished, false);
+    atomic_init(&build->canceled, false);
+
+    if (thrd_create(&build->builder, build_levels, build) != thrd_success) {
+        fprintf(stderr, "[ERR] Could not create a thread for building the levels of detail.\n");
+        exit(1);
+    }
+}
+
+bool lod_build_is_finished(LodBuild *build) { return atomic_load(&build->finished); }
+
+void lod_build_stop(LodBuild *build) {
+    atomic_store(&build->canceled, true);
+    thrd_join(build->builder, NULL);
+
+    for (size_t i = 0; i < build->scene->objects.length; ++i) {
+        LodLevels *levels = &build->levels[i];
+        for (size_t i_level = 0; i_level < levels->length; ++i_level) {
+            free(levels->items[i_level].vertices.items);
+            free(levels->items[i_level].colors.items);
+            free(levels->items[i_level].indices.items);
+        }
+        free(levels->items);
+    }
+    free(build->levels);
+    build->levels = NULL;
+}
+
+// ****************************************************************************
+// Simplification
+// ****************************************************************************
+
+bool weld_vertices(const Object *obj, Simplification *s) {
+    size_t corner_count = 3 * object_triangle_count(*obj);
+    size_t max_vertex_count = object_is_indexed(*obj) ? obj->vertices.length / 3 : corner_count;
+
+    // Vertex indices are 32 bit, one value marks unused entries
+    if (max_vertex_count >= NO_VERTEX || corner_count / 3 >= NO_VERTEX) {
+        fprintf(stderr, "[ERR] Object has too many vertices to be simplified.\n");
+        exit(1);
+    }
+
+    s->face_count = corner_count / 3;
+    s->faces = malloc(corner_count * sizeof(uint32_t));
+    s->sources = malloc(max_vertex_count * sizeof(uint32_t));
+    assert((s->faces && s->sources) || !corner_count);
+
+    // Open addressing table from positions to welded vertices, with at most half of the slots in use
+    size_t table_size = 1;
+    while (table_size < 2 * max_vertex_count) table_size *= 2;
+    uint32_t *table = malloc(table_size * sizeof(uint32_t));
+    assert(table && "Could not allocate the table for welding the vertices.");
+    memset(table, 0xFF, table_size * sizeof(uint32_t));
+
+    for (size_t corner = 0; corner < corner_count; ++corner) {
+        if (is_canceled(s, corner)) {
+            free(table);
+            return false;
+        }
+
+        size_t vertex = object_corner_vertex(*obj, corner);
+        const float *position = &obj->vertices.items[3 * vertex];
+
+        // Adding zero turns -0 into 0, so both hash alike
+        uint32_t bits[3];
+        for (size_t k = 0; k < 3; ++k) {
+            float component = position[k] + 0.0f;
+            memcpy(&bits[k], &component, sizeof(float));
+        }
+        uint64_t hash = (bits[0] * 0x9E3779B97F4A7C15ull) ^ (bits[1] * 0xC2B2AE3D27D4EB4Full) ^ bits[2];
+        size_t slot = (size_t)((hash * 0x165667B19E3779F9ull) >> 32) & (table_size - 1);
+
+        while (table[slot] != NO_VERTEX) {
+            const float *other = &obj->vertices.items[3 * s->sources[table[slot]]];
+            if (other[0] == position[0] && other[1] == position[1] && other[2] == position[2]) break;
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (table[slot] == NO_VERTEX) {
+            table[slot] = s->vertex_count;
+            s->sources[s->vertex_count++] = vertex;
+        }
+        s->faces[corner] = table[slot];
+    }
+
+    free(table);
+    return true;
+}
+
+bool add_face_quadrics(Simplification *s) {
+    s->quadrics = calloc(s->vertex_count, sizeof(Quadric));
+    s->dead_faces = calloc(s->face_count, sizeof(bool));
+    assert((s->quadrics || !s->vertex_count) && (s->dead_faces || !s->face_count));
+
+    // The plane of every face is weighted by its area, faces whose corners were welded together are dropped
+    for (size_t f = 0; f < s->face_count; ++f) {
+        if (is_canceled(s, f)) return false;
+
+        const uint32_t *face = &s->faces[3 * f];
+        if (face[0] == face[1] || face[1] == face[2] || face[2] == face[0]) {
+            s->dead_faces[f] = true;
+            continue;
+        }
+        ++s->live_face_count;
+
+        Vector3d a = get_position(s, face[0]);
+        Vector3d normal = get_face_normal(a, get_position(s, face[1]), get_position(s, face[2]));
+        double double_area = sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (double_area == 0.0) continue;
+
+        Vector3d unit = {normal.x / double_area, normal.y / double_area, normal.z / double_area};
+        double d = -(unit.x * a.x + unit.y * a.y + unit.z * a.z);
+        for (size_t k = 0; k < 3; ++k) {
+            add_plane_quadric(unit, d, 0.5 * double_area, &s->quadrics[face[k]]);
+        }
+    }
+
+    return true;
+}
+
+bool get_sorted_edges(const Simplification *s, EdgeRef **edges, size_t *count) {
+    *edges = malloc(3 * s->face_count * sizeof(EdgeRef));
+    assert((*edges || !s->face_count) && "Could not allocate the edges.");
+
+    *count = 0;
+    for (size_t f = 0; f < s->face_count; ++f) {
+        if (is_canceled(s, f)) return false;
+        if (s->dead_faces[f]) continue;
+
+        for (size_t k = 0; k < 3; ++k) {
+            uint64_t a = s->faces[3 * f + k];
+            uint64_t b = s->faces[3 * f + (k + 1) % 3];
+            (*edges)[(*count)++] = (EdgeRef){.key = a < b ? a << 32 | b : b << 32 | a, .face = f};
+        }
+    }
+
+    return sort_edges(s, edges, *count);
+}
+
+bool sort_edges(const Simplification *s, EdgeRef **edges, size_t count) {
+    // Least significant digit first radix sort by the keys, unlike qsort it can stop between any two edges
+    EdgeRef *sorted = malloc(count * sizeof(EdgeRef));
+    size_t *offsets = malloc(RADIX_SIZE * sizeof(size_t));
+    assert((sorted || !count) && offsets && "Could not allocate the buffers for sorting the edges.");
+
+    bool is_sorted = true;
+    for (unsigned shift = 0; shift < 64 && is_sorted; shift += RADIX_BITS) {
+        memset(offsets, 0, RADIX_SIZE * sizeof(size_t));
+        for (size_t i = 0; i < count && is_sorted; ++i) {
+            is_sorted = !is_canceled(s, i);
+            ++offsets[((*edges)[i].key >> shift) & (RADIX_SIZE - 1)];
+        }
+
+        // A digit shared by all keys, like the upper bits of small vertex indices, leaves the order as it is
+        if (!count || offsets[((*edges)[0].key >> shift) & (RADIX_SIZE - 1)] == count) continue;
+
+        size_t offset = 0;
+        for (size_t digit = 0; digit < RADIX_SIZE; ++digit) {
+            size_t digit_count = offsets[digit];
+            offsets[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (size_t i = 0; i < count && is_sorted; ++i) {
+            is_sorted = !is_canceled(s, i);
+            sorted[offsets[((*edges)[i].key >> shift) & (RADIX_SIZE - 1)]++] = (*edges)[i];
+        }
+
+        EdgeRef *previous = *edges;
+        *edges = sorted;
+        sorted = previous;
+    }
+
+    free(offsets);
+    free(sorted);
+    return is_sorted;
+}
+
+bool add_boundary_quadrics(Simplification *s, const EdgeRef *edges, size_t count) {
+    // Edges of a single face are on the boundary of an open surface
+    for (size_t i = 0; i < count; ++i) {
+        if (is_canceled(s, i)) return false;
+
+        bool is_shared = (i && edges[i - 1].key == edges[i].key) || (i + 1 < count && edges[i + 1].key == edges[i].key);
+        if (is_shared) continue;
+
+        const uint32_t *face = &s->faces[3 * edges[i].face];
+        uint32_t a = edges[i].key >> 32;
+        uint32_t b = edges[i].key & UINT32_MAX;
+        Vector3d pa = get_position(s, a);
+        Vector3d pb = get_position(s, b);
+        Vector3d face_normal = get_face_normal(get_position(s, face[0]), get_position(s, face[1]),
+                                               get_position(s, face[2]));
+
+        // The plane contains the edge and is perpendicular to the face
+        Vector3d edge = {pb.x - pa.x, pb.y - pa.y, pb.z - pa.z};
+        Vector3d normal = {
+            edge.y * face_normal.z - edge.z * face_normal.y,
+            edge.z * face_normal.x - edge.x * face_normal.z,
+            edge.x * face_normal.y - edge.y * face_normal.x,
+        };
+        double length = sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length == 0.0) continue;
+
+        Vector3d unit = {normal.x / length, normal.y / length, normal.z / length};
+        double d = -(unit.x * pa.x + unit.y * pa.y + unit.z * pa.z);
+        double weight = BOUNDARY_WEIGHT * (edge.x * edge.x + edge.y * edge.y + edge.z * edge.z);
+        add_plane_quadric(unit, d, weight, &s->quadrics[a]);
+        add_plane_quadric(unit, d, weight, &s->quadrics[b]);
+    }
+
+    return true;
+}
+
+bool link_faces(Simplification *s) {
+    s->face_offsets = calloc(s->vertex_count + 1, sizeof(uint32_t));
+    s->face_lists = malloc(3 * s->face_count * sizeof(uint32_t));
+    s->parents = malloc(s->vertex_count * sizeof(uint32_t));
+    s->next_members = malloc(s->vertex_count * sizeof(uint32_t));
+    s->last_members = malloc(s->vertex_count * sizeof(uint32_t));
+    s->versions = calloc(s->vertex_count, sizeof(uint32_t));
+    assert(s->face_offsets && (s->face_lists || !s->face_count) &&
+           ((s->parents && s->next_members && s->last_members && s->versions) || !s->vertex_count) &&
+           "Could not allocate the adjacency of the vertices.");
+
+    // Count the faces of every vertex, then place them at the prefix sums
+    for (size_t f = 0; f < s->face_count; ++f) {
+        if (is_canceled(s, f)) return false;
+        if (s->dead_faces[f]) continue;
+        for (size_t k = 0; k < 3; ++k) ++s->face_offsets[s->faces[3 * f + k] + 1];
+    }
+    for (size_t v = 0; v < s->vertex_count; ++v) {
+        s->face_offsets[v + 1] += s->face_offsets[v];
+    }
+
+    uint32_t *fill = malloc(s->vertex_count * sizeof(uint32_t));
+    assert(fill || !s->vertex_count);
+    memcpy(fill, s->face_offsets, s->vertex_count * sizeof(uint32_t));
+    for (size_t f = 0; f < s->face_count; ++f) {
+        if (is_canceled(s, f)) {
+            free(fill);
+            return false;
+        }
+        if (s->dead_faces[f]) continue;
+        for (size_t k = 0; k < 3; ++k) s->face_lists[fill[s->faces[3 * f + k]]++] = f;
+    }
+    free(fill);
+
+    for (size_t v = 0; v < s->vertex_count; ++v) {
+        s->parents[v] = v;
+        s->next_members[v] = NO_VERTEX;
+        s->last_members[v] = v;
+    }
+
+    return true;
+}
+
+bool collapse_cheapest_edge(Simplification *s) {
+    while (s->heap.length) {
+        Collapse c = heap_pop(&s->heap);
+
+        // Entries of vertices that were collapsed or got a new neighborhood since are outdated
+        if (s->parents[c.from] != c.from || s->parents[c.to] != c.to) continue;
+        if (s->versions[c.from] != c.from_version || s->versions[c.to] != c.to_version) continue;
+        if (!is_collapse_valid(s, c.from, c.to)) continue;
+
+        collapse(s, c.from, c.to);
+        return true;
+    }
+
+    return false;
+}
+
+bool is_collapse_valid(Simplification *s, uint32_t from, uint32_t to) {
+    Vector3d target = get_position(s, to);
+
+    // The faces around from, which keep existing, must not flip when from moves onto to
+    for (uint32_t m = from; m != NO_VERTEX; m = s->next_members[m]) {
+        for (uint32_t i = s->face_offsets[m]; i < s->face_offsets[m + 1]; ++i) {
+            uint32_t f = s->face_lists[i];
+            if (s->dead_faces[f]) continue;
+
+            uint32_t corners[3];
+            for (size_t k = 0; k < 3; ++k) corners[k] = find_representative(s, s->faces[3 * f + k]);
+            if (corners[0] == to || corners[1] == to || corners[2] == to) continue;
+
+            Vector3d before[3];
+            Vector3d after[3];
+            for (size_t k = 0; k < 3; ++k) {
+                before[k] = get_position(s, corners[k]);
+                after[k] = corners[k] == from ? target : before[k];
+            }
+
+            Vector3d n0 = get_face_normal(before[0], before[1], before[2]);
+            Vector3d n1 = get_face_normal(after[0], after[1], after[2]);
+            double dot = n0.x * n1.x + n0.y * n1.y + n0.z * n1.z;
+            double length0 = sqrt(n0.x * n0.x + n0.y * n0.y + n0.z * n0.z);
+            double length1 = sqrt(n1.x * n1.x + n1.y * n1.y + n1.z * n1.z);
+            if (dot < MIN_NORMAL_COSINE * length0 * length1) return false;
+        }
+    }
+
+    return true;
+}
+
+void collapse(Simplification *s, uint32_t from, uint32_t to) {
+    s->parents[from] = to;
+    s->next_members[s->last_members[to]] = from;
+    s->last_members[to] = s->last_members[from];
+    for (size_t k = 0; k < 10; ++k) s->quadrics[to].q[k] += s->quadrics[from].q[k];
+    ++s->versions[to];
+
+    // Faces with both vertices become degenerate and are dropped, the neighbors of the remaining ones get new collapses
+    for (uint32_t m = to; m != NO_VERTEX; m = s->next_members[m]) {
+        for (uint32_t i = s->face_offsets[m]; i < s->face_offsets[m + 1]; ++i) {
+            uint32_t f = s->face_lists[i];
+            if (s->dead_faces[f]) continue;
+
+            uint32_t a = find_representative(s, s->faces[3 * f]);
+            uint32_t b = find_representative(s, s->faces[3 * f + 1]);
+            uint32_t c = find_representative(s, s->faces[3 * f + 2]);
+            if (a == b || b == c || c == a) {
+                s->dead_faces[f] = true;
+                --s->live_face_count;
+                continue;
+            }
+
+            uint32_t corners[3] = {a, b, c};
+            for (size_t k = 0; k < 3; ++k) {
+                bool is_known = corners[k] == to;
+                for (size_t i_neighbor = 0; i_neighbor < s->neighbors.length && !is_known; ++i_neighbor) {
+                    is_known = s->neighbors.items[i_neighbor] == corners[k];
+                }
+                if (!is_known) da_add(s->neighbors, corners[k]);
+            }
+        }
+    }
+
+    // The merged quadric changes the cost of every edge of to
+    for (size_t i = 0; i < s->neighbors.length; ++i) {
+        push_collapse(s, to, s->neighbors.items[i]);
+    }
+    s->neighbors.length = 0;
+}
+
+void push_collapse(Simplification *s, uint32_t a, uint32_t b) {
+    Quadric sum;
+    for (size_t k = 0; k < 10; ++k) sum.q[k] = s->quadrics[a].q[k] + s->quadrics[b].q[k];
+
+    // Vertices stay where they are, so their colors are kept, the one with the smaller error remains
+    double cost_to_b = get_quadric_error(&sum, get_position(s, b));
+    double cost_to_a = get_quadric_error(&sum, get_position(s, a));
+    Collapse c = cost_to_b <= cost_to_a ? (Collapse){.cost = cost_to_b, .from = a, .to = b}
+                                        : (Collapse){.cost = cost_to_a, .from = b, .to = a};
+    c.from_version = s->versions[c.from];
+    c.to_version = s->versions[c.to];
+    heap_push(&s->heap, c);
+}
+
+void write_simplified(Simplification *s, Object *simplified) {
+    const Object *obj = s->obj;
+    *simplified = (Object){0};
+    da_reserve(simplified->indices, 3 * s->live_face_count);
+
+    // Number the remaining vertices in the order of the faces
+    uint32_t *outputs = malloc(s->vertex_count * sizeof(uint32_t));
+    assert(outputs || !s->vertex_count);
+    memset(outputs, 0xFF, s->vertex_count * sizeof(uint32_t));
+
+    for (size_t f = 0; f < s->face_count; ++f) {
+        if (s->dead_faces[f]) continue;
+
+        for (size_t k = 0; k < 3; ++k) {
+            uint32_t v = find_representative(s, s->faces[3 * f + k]);
+            if (outputs[v] == NO_VERTEX) {
+                outputs[v] = simplified->vertices.length / 3;
+                size_t source = s->sources[v];
+                da_add3(simplified->vertices, obj->vertices.items[3 * source], obj->vertices.items[3 * source + 1],
+                        obj->vertices.items[3 * source + 2]);
+                da_add4(simplified->colors, obj->colors.items[4 * source], obj->colors.items[4 * source + 1],
+                        obj->colors.items[4 * source + 2], obj->colors.items[4 * source + 3]);
+            }
+            da_add(simplified->indices, outputs[v]);
+        }
+    }
+
+    free(outputs);
+}
+
+void free_simplification(Simplification *s) {
+    free(s->sources);
+    free(s->faces);
+    free(s->dead_faces);
+    free(s->face_offsets);
+    free(s->face_lists);
+    free(s->parents);
+    free(s->next_members);
+    free(s->last_members);
+    free(s->versions);
+    free(s->quadrics);
+    free(s->heap.items);
+    free(s->neighbors.items);
+}
+
+bool is_canceled(const Simplification *s, size_t iteration) {
+    return iteration % CANCEL_CHECK_INTERVAL == 0 && s->canceled && atomic_load(s->canceled);
+}
+
+uint32_t find_representative(Simplification *s, uint32_t vertex) {
+    // Path halving keeps the chains of repeatedly collapsed vertices short
+    while (s->parents[vertex] != vertex) {
+        s->parents[vertex] = s->parents[s->parents[vertex]];
+        vertex = s->parents[vertex];
+    }
+    return vertex;
+}
+
+Vector3d get_position(const Simplification *s, uint32_t vertex) {
+    const float *p = &s->obj->vertices.items[3 * s->sources[vertex]];
+    return (Vector3d){p[0], p[1], p[2]};
+}
+
+void add_plane_quadric(Vector3d normal, double d, double weight, Quadric *quadric) {
+    double a = normal.x;
+    double b = normal.y;
+    double c = normal.z;
+    double terms[10] = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+    for (size_t k = 0; k < 10; ++k) quadric->q[k] += weight * terms[k];
+}
+
+double get_quadric_error(const Quadric *quadric, Vector3d p) {
+    const double *q = quadric->q;
+    double error = q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x +
+                   q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y + q[7] * p.z * p.z + 2 * q[8] * p.z +
+                   q[9];
+    return error > 0.0 ? error : 0.0;  // Rounding may leave it slightly negative
+}
+
+Vector3d get_face_normal(Vector3d a, Vector3d b, Vector3d c) {
+    Vector3d u = {b.x - a.x, b.y - a.y, b.z - a.z};
+    Vector3d v = {c.x - a.x, c.y - a.y, c.z - a.z};
+    return (Vector3d){u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+}
+
+void heap_push(Collapses *heap, Collapse collapse) {
+    da_add(*heap, collapse);
+
+    size_t i = heap->length - 1;
+    while (i && heap->items[(i - 1) / 2].cost > collapse.cost) {
+        heap->items[i] = heap->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->items[i] = collapse;
+}
+
+Collapse heap_pop(Collapses *heap) {
+    Collapse top = heap->items[0];
+    Collapse last = heap->items[--heap->length];
+
+    size_t i = 0;
+    while (2 * i + 1 < heap->length) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < heap->length && heap->items[child + 1].cost < heap->items[child].cost) ++child;
+        if (heap->items[child].cost >= last.cost) break;
+        heap->items[i] = heap->items[child];
+        i = child;
+    }
+    if (heap->length) heap->items[i] = last;
+
+    return top;
+}
+
+// ****************************************************************************
+// Background build
+// ****************************************************************************
+
+int build_levels(void *arg) {
+    LodBuild *build = arg;
+
+    TRACE_BEGIN(levels, "build levels of detail");
+    parallel_for(build->scene->objects.length, build_object_levels_task, build);
+    TRACE_END(levels);
+
+    atomic_store(&build->finished, true);
+    return 0;
+}
+
+void build_object_levels_task(void *context, size_t index) {
+    LodBuild *build = context;
+    const Object *obj = &build->scene->objects.items[index];
+    LodLevels *levels = &build->levels[index];
+
+    if (!lod_has_levels(*obj)) return;
+    size_t triangle_count = object_triangle_count(*obj);
+
+    // Every level is simplified from the previous one, which is cheaper than starting over from the object
+    const Object *finer = obj;
+    while (levels->length < LOD_MAX_LEVELS && triangle_count / 4 >= LOD_MIN_LEVEL_TRIANGLES) {
+        TRACE_BEGIN(simplify, "simplify level");
+        Object level;
+        if (!lod_simplify(finer, triangle_count / 4, &build->canceled, &level)) return;
+        TRACE_COUNT(simplify, "triangles", object_triangle_count(level));
+        TRACE_END(simplify);
+
+        da_add(*levels, level);
+        finer = &levels->items[levels->length - 1];
+
+        // Stop when the folding check blocks most collapses, the next level would hardly be coarser
+        size_t level_triangle_count = object_triangle_count(level);
+        if (2 * level_triangle_count > triangle_count) break;
+        triangle_count = level_triangle_count;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef PRINT3_LOD_H_
+#define PRINT3_LOD_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <threads.h>
+
+#include "scene.h"
+
+// Objects with fewer triangles are always drawn in full detail
+#define LOD_MIN_OBJECT_TRIANGLES (1 << 16)
+// Every level keeps about a quarter of the triangles of the previous one, down to this count
+#define LOD_MIN_LEVEL_TRIANGLES (1 << 12)
+#define LOD_MAX_LEVELS 8
+
+#define lod_has_levels(obj) (object_triangle_count(obj) >= LOD_MIN_OBJECT_TRIANGLES)
+
+// Simplified copies of one object, from fine to coarse. The object itself is not part of it.
+typedef struct LodLevels {
+    Object *items;
+    size_t length;
+    size_t capacity;
+} LodLevels;
+
+// Levels of all objects of a scene, built by a background thread
+typedef struct LodBuild {
+    const Scene *scene;
+    LodLevels *levels;  // One entry per object, complete once finished is set
+    thrd_t builder;
+    atomic_bool finished;
+    atomic_bool canceled;
+} LodBuild;
+
+// Collapse edges in the order of their quadric error until at most target_triangle_count triangles are left.
+// Vertices at the same position are welded first, so triangle soups are simplified as connected surfaces.
+// The result is an indexed object, whose vertices and colors are a subset of the ones of the object.
+// Returns false without a result when canceled is set while simplifying, canceled may be NULL.
+bool lod_simplify(const Object *obj, size_t target_triangle_count, const atomic_bool *canceled, Object *simplified);
+
+// The scene must not change until the build is stopped
+void lod_build_start(const Scene *scene, LodBuild *build);
+bool lod_build_is_finished(LodBuild *build);
+
+// Cancel the build if it is still running and free all levels
+void lod_build_stop(LodBuild *build);
+
+#endif
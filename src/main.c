@@ -1,25 +1,61 @@
 #include "args.h"
+#include "deserialize/cache.h"
 #include "deserialize/file.h"
 #include "deserialize/stdin.h"
+#include "parallel.h"
 #include "scene.h"
+#include "shm.h"
+#include "stats.h"
+#include "trace.h"
 #include "viewer.h"
 
 int main(int argc, const char **argv) {
     Args args = {0};
+    TRACE_BEGIN(parse_args, "parse arguments");
     args_parse(argc, argv, &args);
+    TRACE_SET_OUTPUT(args.trace_path);
+    TRACE_END(parse_args);
+
+    parallel_set_job_count(args.job_count);
+
+    cache_set_directory(args.cache_directory);
+    cache_set_enabled(args.cache);
+    if (args.clear_cache) cache_clear();
+
+    // Report on the inputs instead of showing them
+    if (args.stats) {
+        stats_run(&args);
+        TRACE_WRITE();
+        args_free_member(&args);
+        return 0;
+    }
 
     Scene scene = {0};
 
+    TRACE_BEGIN(load, "load scene");
     for (size_t i = 0; i < args.stdin_object_count; ++i) {
-        stdin_add_to_scene(stdin, &scene);
+        if (args.binary_stdin) {
+            stdin_add_binary_to_scene(stdin, &scene);
+        } else {
+            stdin_add_to_scene(stdin, &scene);
+        }
     }
 
-    for (size_t i = 0; i < args.files.length; ++i) {
-        file_add_to_scene(args.files.items[i], args.fallback_color, &scene);
-    }
+    file_add_all_to_scene(args.files.items, args.files.length, args.fallback_color, &scene);
+    TRACE_COUNT(load, "triangles", scene_count_triangles(&scene, 0));
+    TRACE_END(load);
+
+    // The stream is read while the viewer is running
+    StdinStream stream;
+    bool streaming = args.stream_stdin || args.shm_name;
+    if (args.stream_stdin) stdin_stream_start(stdin, args.binary_stdin, &stream);
+    if (args.shm_name) stdin_stream_start_shm(shm_ring_open(args.shm_name), &stream);
+
+    viewer_run(&args.viewer, &scene, streaming ? &stream : NULL, NULL);
+
+    if (streaming) stdin_stream_stop(&stream);
 
-    bool viewer_should_run = true;
-    viewer_run(&args.viewer, &scene, &viewer_should_run);
+    TRACE_WRITE();
 
     scene_free_members(&scene);
     args_free_member(&args);
@@ -0,0 +1,185 @@
+#include "parallel.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct Loop {
+    size_t next_index;
+    size_t finished_count;
+    size_t count;
+    ParallelTask task;
+    void *context;
+    struct Loop *parent;  // Loop whose task submitted this one, NULL for the outermost loops
+    struct Loop *next;
+} Loop;
+
+// Worker threads are started on first use and wait for further loops until the program exits
+typedef struct Pool {
+    mtx_t lock;
+    cnd_t changed;  // A loop was submitted or finished
+    Loop *loops;    // Loops with indices left to take, the most recently submitted first
+    size_t worker_count;
+} Pool;
+
+static size_t configured_job_count = 0;
+static once_flag init_flag = ONCE_FLAG_INIT;
+static Pool pool = {0};
+static thread_local Loop *current_loop = NULL;
+
+static size_t get_processor_count(void);
+static void init_pool(void);
+static void start_workers(size_t worker_count);
+static int run_worker(void *arg);
+static bool take_index(const Loop *ancestor, Loop **loop, size_t *index);
+static bool is_within(const Loop *loop, const Loop *ancestor);
+static void run_index(Loop *loop, size_t index);
+
+void parallel_set_job_count(size_t job_count) { configured_job_count = job_count; }
+
+size_t parallel_get_job_count(void) { return configured_job_count ? configured_job_count : get_processor_count(); }
+
+void parallel_for(size_t count, ParallelTask task, void *context) {
+    size_t job_count = parallel_get_job_count();
+
+    // Do not involve the pool for trivial loops
+    if (job_count <= 1 || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(context, i);
+        }
+        return;
+    }
+
+    call_once(&init_flag, init_pool);
+
+    Loop loop = {
+        .next_index = 0,
+        .finished_count = 0,
+        .count = count,
+        .task = task,
+        .context = context,
+        .parent = current_loop,
+    };
+
+    mtx_lock(&pool.lock);
+
+    // The calling thread is one of the jobs
+    start_workers(job_count - 1);
+
+    loop.next = pool.loops;
+    pool.loops = &loop;
+    cnd_broadcast(&pool.changed);
+
+    // Only this loop and the ones nested in it are helped with, other loops could keep the caller busy for long
+    Loop *taken;
+    size_t index;
+    while (loop.finished_count < loop.count) {
+        if (take_index(&loop, &taken, &index)) {
+            run_index(taken, index);
+        } else {
+            cnd_wait(&pool.changed, &pool.lock);
+        }
+    }
+
+    mtx_unlock(&pool.lock);
+}
+
+size_t get_processor_count(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long count = info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return count > 0 ? count : 1;
+}
+
+void init_pool(void) {
+    if (mtx_init(&pool.lock, mtx_plain) != thrd_success || cnd_init(&pool.changed) != thrd_success) {
+        fprintf(stderr, "[ERR] Could not create a mutex for the worker pool.\n");
+        exit(1);
+    }
+}
+
+void start_workers(size_t worker_count) {
+    // Called with the pool locked, the pool grows to the largest job count requested so far
+    for (; pool.worker_count < worker_count; ++pool.worker_count) {
+        thrd_t thread;
+        if (thrd_create(&thread, run_worker, NULL) != thrd_success) {
+            fprintf(stderr, "[ERR] Could not create a worker thread.\n");
+            exit(1);
+        }
+        thrd_detach(thread);
+    }
+}
+
+int run_worker(void *arg) {
+    (void)arg;
+
+    mtx_lock(&pool.lock);
+
+    Loop *loop;
+    size_t index;
+    while (true) {
+        if (take_index(NULL, &loop, &index)) {
+            run_index(loop, index);
+        } else {
+            cnd_wait(&pool.changed, &pool.lock);
+        }
+    }
+
+    return 0;
+}
+
+bool take_index(const Loop *ancestor, Loop **loop, size_t *index) {
+    // Called with the pool locked, nested loops are submitted later and so are preferred
+    for (Loop **link = &pool.loops; *link; link = &(*link)->next) {
+        if (ancestor && !is_within(*link, ancestor)) continue;
+
+        *loop = *link;
+        *index = (*loop)->next_index++;
+        if ((*loop)->next_index == (*loop)->count) {
+            *link = (*loop)->next;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool is_within(const Loop *loop, const Loop *ancestor) {
+    for (; loop; loop = loop->parent) {
+        if (loop == ancestor) return true;
+    }
+
+    return false;
+}
+
+void run_index(Loop *loop, size_t index) {
+    // Called with the pool locked, which is released while the task runs
+    mtx_unlock(&pool.lock);
+
+    Loop *outer_loop = current_loop;
+    current_loop = loop;
+    loop->task(loop->context, index);
+    current_loop = outer_loop;
+
+    mtx_lock(&pool.lock);
+
+    // The submitting thread may return once it sees the last index finished, the loop is not touched afterwards
+    loop->finished_count += 1;
+    if (loop->finished_count == loop->count) {
+        cnd_broadcast(&pool.changed);
+    }
+}
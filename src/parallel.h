@@ -0,0 +1,17 @@
+#ifndef PRINT3_PARALLEL_H_
+#define PRINT3_PARALLEL_H_
+
+#include <stddef.h>
+
+// Task executed once for every index of a parallel loop
+typedef void (*ParallelTask)(void *context, size_t index);
+
+// A job count of 0 uses one job per available processor
+void parallel_set_job_count(size_t job_count);
+size_t parallel_get_job_count(void);
+
+// Run task for every index in [0, count) on a pool of worker threads and wait for all of them.
+// Nested calls from within a task are submitted to the same pool, the waiting thread works on them meanwhile.
+void parallel_for(size_t count, ParallelTask task, void *context);
+
+#endif
@@ -0,0 +1,15 @@
+#include "print3.h"
+
+void print3_show(const float *triangles, size_t triangle_count, Color color) {
+    Scene scene = {0};
+    scene_add_triangles(&scene, triangles, triangle_count, color, true);
+
+    print3_show_scene(&scene);
+
+    scene_free_members(&scene);
+}
+
+void print3_show_scene(const Scene *scene) {
+    ViewerOptions options = viewer_get_default_options();
+    viewer_run(&options, scene, NULL, NULL);
+}
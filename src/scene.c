@@ -1,14 +1,120 @@
 #include "scene.h"
 
+#include <math.h>
+#include <string.h>
+
 void scene_free_members(Scene *scene) {
     for (size_t i = 0; i < scene->objects.length; ++i) {
         free(scene->objects.items[i].colors.items);
-        free(scene->objects.items[i].vertices.items);
+        if (!scene->objects.items[i].borrowed_vertices) free(scene->objects.items[i].vertices.items);
+        free(scene->objects.items[i].indices.items);
     }
 
     free(scene->objects.items);
 }
 
+float scene_get_radius(const Scene *scene) {
+    // Compare the squares for the max length cos length needs sqrt to compute
+    // only compute the sqrt of the maximum
+    // Add one to the found radius to ensure a little distance is always kept
+    // Scene radius is only used to prevent clipping through objects for zooming the fov can be modified
+    float max_length_sqr = 0.0f;
+
+    for (size_t i_obj = 0; i_obj < scene->objects.length; ++i_obj) {
+        Object obj = scene->objects.items[i_obj];
+
+        for (size_t i_ver = 0; i_ver < obj.vertices.length; i_ver += 3) {
+            float x = obj.vertices.items[i_ver];
+            float y = obj.vertices.items[i_ver + 1];
+            float z = obj.vertices.items[i_ver + 2];
+            float length_sqr = x * x + y * y + z * z;
+
+            if (length_sqr > max_length_sqr) {
+                max_length_sqr = length_sqr;
+            }
+        }
+    }
+
+    return 1.0f + sqrtf(max_length_sqr);
+}
+
+size_t scene_count_triangles(const Scene *scene, size_t first_object) {
+    size_t triangle_count = 0;
+    for (size_t i = first_object; i < scene->objects.length; ++i) {
+        triangle_count += object_triangle_count(scene->objects.items[i]);
+    }
+    return triangle_count;
+}
+
+void scene_add_triangles(Scene *scene, const float *vertices, size_t triangle_count, Color color, bool borrow) {
+    Object obj = {0};
+    obj.vertices.length = obj.vertices.capacity = 9 * triangle_count;
+    obj.colors.length = obj.colors.capacity = 12 * triangle_count;
+    obj.borrowed_vertices = borrow;
+
+    if (!triangle_count) {
+        da_add(scene->objects, obj);
+        return;
+    }
+
+    if (borrow) {
+        obj.vertices.items = (float *)vertices;
+    } else {
+        obj.vertices.items = malloc(obj.vertices.length * sizeof(float));
+        assert(obj.vertices.items && "Could not allocate the vertices of an object.");
+        memcpy(obj.vertices.items, vertices, obj.vertices.length * sizeof(float));
+    }
+
+    // Colors are always owned, the viewer needs one per vertex
+    obj.colors.items = malloc(obj.colors.length * sizeof(unsigned char));
+    assert(obj.colors.items && "Could not allocate the colors of an object.");
+    scene_fill_colors(color, obj.colors.items, obj.colors.length);
+
+    da_add(scene->objects, obj);
+}
+
+void object_get_triangle(const Object *obj, size_t triangle, Vector3 vertices[3]) {
+    for (size_t i = 0; i < 3; ++i) {
+        size_t i_ver = 3 * object_corner_vertex(*obj, 3 * triangle + i);
+        vertices[i] =
+            (Vector3){obj->vertices.items[i_ver], obj->vertices.items[i_ver + 1], obj->vertices.items[i_ver + 2]};
+    }
+}
+
+void object_append_triangles(Object *obj, const float *vertices, const unsigned char *colors, size_t triangle_count) {
+    if (!triangle_count) return;
+
+    size_t vertex_length = obj->vertices.length + 9 * triangle_count;
+    if (vertex_length > obj->vertices.capacity) {
+        obj->vertices.capacity = 2 * vertex_length;
+        obj->vertices.items = realloc(obj->vertices.items, obj->vertices.capacity * sizeof(float));
+        assert(obj->vertices.items && "Could not resize dynamic array.");
+    }
+
+    size_t color_length = obj->colors.length + 12 * triangle_count;
+    if (color_length > obj->colors.capacity) {
+        obj->colors.capacity = 2 * color_length;
+        obj->colors.items = realloc(obj->colors.items, obj->colors.capacity * sizeof(unsigned char));
+        assert(obj->colors.items && "Could not resize dynamic array.");
+    }
+
+    memcpy(&obj->vertices.items[obj->vertices.length], vertices, 9 * triangle_count * sizeof(float));
+    memcpy(&obj->colors.items[obj->colors.length], colors, 12 * triangle_count * sizeof(unsigned char));
+    obj->vertices.length = vertex_length;
+    obj->colors.length = color_length;
+}
+
+void scene_fill_colors(Color color, unsigned char *colors, size_t length) {
+    if (!length) return;
+
+    // Double the filled range with every copy
+    memcpy(colors, &color, 4);
+    for (size_t filled = 4; filled < length; filled *= 2) {
+        size_t n = filled <= length - filled ? filled : length - filled;
+        memcpy(&colors[filled], colors, n);
+    }
+}
+
 void scene_add_demo_object(Scene *scene) {
     // Add a pyramid shaped object to the scene
     Vector3 vertices[5] = {(Vector3){1, 1, 0}, (Vector3){-1, 1, 0}, (Vector3){-1, -1, 0}, (Vector3){1, -1, 0},
@@ -2,7 +2,9 @@
 #define PRINT3_SCENE_H_
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "dsa.h"
@@ -23,11 +25,28 @@ typedef struct Colors {
     size_t capacity;
 } Colors;
 
+typedef struct Indices {
+    uint32_t *items;  // 3 per triangle, refer to vertices and colors
+    size_t length;
+    size_t capacity;
+} Indices;
+
+// Either a triangle soup, where every 3 consecutive vertices form a triangle and indices is empty,
+// or an indexed mesh with unique vertices, one color per vertex and 3 indices per triangle
 typedef struct Object {
     Vertices vertices;
     Colors colors;
+    Indices indices;
+    bool borrowed_vertices;  // Vertices belong to the caller, they are neither modified nor freed
 } Object;
 
+#define object_is_indexed(obj) ((obj).indices.length > 0)
+
+#define object_triangle_count(obj) (object_is_indexed(obj) ? (obj).indices.length / 3 : (obj).vertices.length / 9)
+
+// Index into vertices and colors of the corner-th triangle corner (3 corners per triangle)
+#define object_corner_vertex(obj, corner) (object_is_indexed(obj) ? (size_t)(obj).indices.items[corner] : (size_t)(corner))
+
 typedef struct Objects {
     Object *items;
     size_t length;
@@ -40,6 +59,24 @@ typedef struct Scene {
 
 void scene_free_members(Scene *scene);
 
+// Distance of the farthest vertex from the origin plus one, the camera keeps at least this distance
+float scene_get_radius(const Scene *scene);
+
+// Triangles of the objects from first_object to the end
+size_t scene_count_triangles(const Scene *scene, size_t first_object);
+
+// Add a triangle soup with 9 floats per triangle in a single color.
+// Borrowed vertices are not copied, they must outlive the scene.
+void scene_add_triangles(Scene *scene, const float *vertices, size_t triangle_count, Color color, bool borrow);
+
+void object_get_triangle(const Object *obj, size_t triangle, Vector3 vertices[3]);
+
+// Append triangles with 9 floats and 12 color bytes each to a triangle soup, growing it geometrically
+void object_append_triangles(Object *obj, const float *vertices, const unsigned char *colors, size_t triangle_count);
+
+// Repeat the color over length bytes of colors, 4 per color
+void scene_fill_colors(Color color, unsigned char *colors, size_t length);
+
 void scene_add_demo_object(Scene *scene);
 
 #endif
@@ -0,0 +1,257 @@
+#include "shm.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SHM_MAGIC 0x3142524d48535033ULL  // "3PSHMRB1"
+#define MIN_CAPACITY 4096
+
+// An idle side yields a few times before it sleeps, so a busy peer is followed without delay
+#define SPIN_COUNT 64
+#define WAIT_NANOSECONDS 50000
+
+// Layout at the start of the segment, the ring buffer follows.
+// Both indices count all bytes ever written or read, they live on separate cache lines.
+typedef struct ShmRingHeader {
+    _Atomic uint64_t magic;  // Stored last by the producer, once the header is valid
+    uint64_t capacity;
+    alignas(64) _Atomic uint64_t head;  // Written by the producer
+    alignas(64) _Atomic uint64_t tail;  // Written by the consumer
+    alignas(64) _Atomic uint32_t closed;
+} ShmRingHeader;
+
+struct ShmRing {
+    ShmRingHeader *header;
+    unsigned char *data;
+    size_t mapped_size;
+    uint64_t mask;
+    uint64_t peer;  // Last seen index of the other side, reloaded only when it limits the transfer
+    char *name;     // Only set for the producer, which removes the segment
+};
+
+#if !defined(_WIN32)
+static char *get_segment_name(const char *name);
+static ShmRing *map_ring(int fd, size_t size);
+#endif
+static void wait_for_peer(unsigned *spins);
+
+#if defined(_WIN32)
+
+ShmRing *shm_ring_create(const char *name, size_t capacity) {
+    (void)capacity;
+    fprintf(stderr, "[ERR] Shared memory segment \"%s\" can not be created, it is not supported on Windows.\n", name);
+    exit(1);
+}
+
+ShmRing *shm_ring_open(const char *name) {
+    fprintf(stderr, "[ERR] Shared memory segment \"%s\" can not be opened, it is not supported on Windows.\n", name);
+    exit(1);
+}
+
+void shm_ring_free(ShmRing *ring) { (void)ring; }
+
+#else
+
+ShmRing *shm_ring_create(const char *name, size_t capacity) {
+    uint64_t rounded = MIN_CAPACITY;
+    while (rounded < capacity) rounded *= 2;
+
+    // A segment left behind by a crashed producer is replaced
+    char *segment = get_segment_name(name);
+    shm_unlink(segment);
+
+    int fd = shm_open(segment, O_CREAT | O_EXCL | O_RDWR, 0600);
+    size_t size = sizeof(ShmRingHeader) + rounded;
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        fprintf(stderr, "[ERR] Could not create the shared memory segment %s of %zu bytes.\n", segment, size);
+        exit(1);
+    }
+
+    ShmRing *ring = map_ring(fd, size);
+    ring->name = segment;
+    ring->header->capacity = rounded;
+    ring->mask = rounded - 1;
+    atomic_store_explicit(&ring->header->magic, SHM_MAGIC, memory_order_release);
+
+    return ring;
+}
+
+ShmRing *shm_ring_open(const char *name) {
+    char *segment = get_segment_name(name);
+
+    struct stat st;
+    int fd = shm_open(segment, O_RDWR, 0);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "[ERR] Could not open the shared memory segment %s. The producer must be started first.\n",
+                segment);
+        exit(1);
+    }
+
+    if (st.st_size < 0 || (size_t)st.st_size <= sizeof(ShmRingHeader)) {
+        fprintf(stderr, "[ERR] The shared memory segment %s is too small for a ring.\n", segment);
+        exit(1);
+    }
+
+    // The capacity is only published together with the magic number
+    ShmRing *ring = map_ring(fd, st.st_size);
+    bool has_magic = atomic_load_explicit(&ring->header->magic, memory_order_acquire) == SHM_MAGIC;
+    uint64_t capacity = ring->header->capacity;
+    if (!has_magic || capacity == 0 || capacity != (size_t)st.st_size - sizeof(ShmRingHeader) ||
+        (capacity & (capacity - 1))) {
+        fprintf(stderr, "[ERR] The shared memory segment %s does not contain a print3 ring.\n", segment);
+        exit(1);
+    }
+
+    ring->mask = capacity - 1;
+    ring->peer = atomic_load_explicit(&ring->header->head, memory_order_acquire);
+
+    free(segment);
+    return ring;
+}
+
+void shm_ring_free(ShmRing *ring) {
+    munmap(ring->header, ring->mapped_size);
+
+    // Mappings of the consumer stay valid after the name is removed
+    if (ring->name) {
+        shm_unlink(ring->name);
+        free(ring->name);
+    }
+
+    free(ring);
+}
+
+char *get_segment_name(const char *name) {
+    // Portable segment names consist of a leading slash and no further ones
+    size_t n = strlen(name);
+    char *segment = malloc(n + 2);
+    assert(segment && "Could not allocate the segment name.");
+
+    segment[0] = '/';
+    memcpy(&segment[1], name[0] == '/' ? &name[1] : name, name[0] == '/' ? n : n + 1);
+    return segment;
+}
+
+ShmRing *map_ring(int fd, size_t size) {
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "[ERR] Could not map the shared memory segment of %zu bytes.\n", size);
+        exit(1);
+    }
+
+    ShmRing *ring = calloc(1, sizeof(ShmRing));
+    assert(ring && "Could not allocate the ring.");
+    ring->header = mapping;
+    ring->data = (unsigned char *)mapping + sizeof(ShmRingHeader);
+    ring->mapped_size = size;
+    return ring;
+}
+
+#endif
+
+bool shm_ring_write(ShmRing *ring, const void *bytes, size_t size) {
+    ShmRingHeader *header = ring->header;
+    const unsigned char *source = bytes;
+    uint64_t head = atomic_load_explicit(&header->head, memory_order_relaxed);
+
+    unsigned spins = 0;
+    while (size) {
+        if (atomic_load_explicit(&header->closed, memory_order_acquire)) return false;
+
+        uint64_t free_size = header->capacity - (head - ring->peer);
+        if (!free_size) {
+            ring->peer = atomic_load_explicit(&header->tail, memory_order_acquire);
+            if (head - ring->peer == header->capacity) wait_for_peer(&spins);
+            continue;
+        }
+
+        // Publish every chunk right away, so objects larger than the ring flow through it
+        size_t n = size < free_size ? size : free_size;
+        size_t offset = head & ring->mask;
+        size_t first = n < header->capacity - offset ? n : header->capacity - offset;
+        memcpy(&ring->data[offset], source, first);
+        memcpy(ring->data, &source[first], n - first);
+
+        head += n;
+        source += n;
+        size -= n;
+        spins = 0;
+        atomic_store_explicit(&header->head, head, memory_order_release);
+    }
+
+    return true;
+}
+
+bool shm_ring_write_object(ShmRing *ring, const float *vertices, size_t triangle_count, const unsigned char color[4]) {
+    assert(triangle_count <= UINT32_MAX && "The triangle count of a frame is 32 bit.");
+
+    unsigned char header[12] = {'P', '3', 'T', 'F', color[0], color[1], color[2], color[3]};
+    for (size_t i = 0; i < 4; ++i) {
+        header[8 + i] = (triangle_count >> (8 * i)) & 0xff;
+    }
+
+    return shm_ring_write(ring, header, sizeof(header)) &&
+           shm_ring_write(ring, vertices, 9 * triangle_count * sizeof(float));
+}
+
+size_t shm_ring_read(ShmRing *ring, void *bytes, size_t size) {
+    ShmRingHeader *header = ring->header;
+    unsigned char *target = bytes;
+    uint64_t tail = atomic_load_explicit(&header->tail, memory_order_relaxed);
+
+    size_t read = 0;
+    unsigned spins = 0;
+    while (read < size) {
+        uint64_t available = ring->peer - tail;
+        if (!available) {
+            // Check for the end before reloading the head, so bytes written just before closing are not lost
+            bool closed = atomic_load_explicit(&header->closed, memory_order_acquire);
+            ring->peer = atomic_load_explicit(&header->head, memory_order_acquire);
+            if (ring->peer != tail) continue;
+            if (closed) break;
+
+            wait_for_peer(&spins);
+            continue;
+        }
+
+        size_t n = size - read < available ? size - read : available;
+        size_t offset = tail & ring->mask;
+        size_t first = n < header->capacity - offset ? n : header->capacity - offset;
+        memcpy(&target[read], &ring->data[offset], first);
+        memcpy(&target[read + first], ring->data, n - first);
+
+        tail += n;
+        read += n;
+        spins = 0;
+        atomic_store_explicit(&header->tail, tail, memory_order_release);
+    }
+
+    return read;
+}
+
+void shm_ring_close(ShmRing *ring) { atomic_store_explicit(&ring->header->closed, 1, memory_order_release); }
+
+void wait_for_peer(unsigned *spins) {
+    if (*spins < SPIN_COUNT) {
+        ++*spins;
+        thrd_yield();
+        return;
+    }
+
+    thrd_sleep(&(struct timespec){.tv_nsec = WAIT_NANOSECONDS}, NULL);
+}
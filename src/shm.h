@@ -0,0 +1,33 @@
+#ifndef PRINT3_SHM_H_
+#define PRINT3_SHM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Lock-free single producer, single consumer byte ring in a named POSIX shared memory segment.
+// Objects are written in the binary stdin framing, but with the floats in the byte order of the host.
+typedef struct ShmRing ShmRing;
+
+// Producer side. An existing segment of the same name is replaced.
+// The capacity is rounded up to a power of two.
+ShmRing *shm_ring_create(const char *name, size_t capacity);
+
+// Consumer side. The producer must have created the segment before.
+ShmRing *shm_ring_open(const char *name);
+
+// Block while the ring is full. Returns false if the ring was closed before all bytes were written.
+bool shm_ring_write(ShmRing *ring, const void *bytes, size_t size);
+
+// Write one object as a frame: "P3TF", color, triangle count and the 9 floats per triangle
+bool shm_ring_write_object(ShmRing *ring, const float *vertices, size_t triangle_count, const unsigned char color[4]);
+
+// Block until size bytes are read. Fewer bytes are only returned once the ring is closed.
+size_t shm_ring_read(ShmRing *ring, void *bytes, size_t size);
+
+// End the transmission, either side may close the ring. Bytes already written can still be read.
+void shm_ring_close(ShmRing *ring);
+
+// Unmap the ring, the producer also removes the name of the segment
+void shm_ring_free(ShmRing *ring);
+
+#endif
@@ -0,0 +1,138 @@
+#include "stats.h"
+
+#include <float.h>
+#include <stdio.h>
+
+#include "deserialize/file.h"
+#include "deserialize/stdin.h"
+#include "timer.h"
+
+#define EMPTY_BOUNDS \
+    (Bounds) { {FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX} }
+
+// Axis aligned bounding box, empty while min > max
+typedef struct Bounds {
+    Vector3 min;
+    Vector3 max;
+} Bounds;
+
+static void print_objects(const Scene *scene, size_t first_object, Bounds *scene_bounds);
+static size_t object_allocated_bytes(const Object *obj);
+static void add_object_to_bounds(const Object *obj, Bounds *bounds);
+static void print_bounds(const char *indent, const Bounds *bounds);
+
+void stats_run(const Args *args) {
+    Scene scene = {0};
+    Bounds scene_bounds = EMPTY_BOUNDS;
+    double total_start = timer_now();
+
+    for (int i = 0; i < args->stdin_object_count; ++i) {
+        size_t first_object = scene.objects.length;
+
+        double start = timer_now();
+        if (args->binary_stdin) {
+            stdin_add_binary_to_scene(stdin, &scene);
+        } else {
+            stdin_add_to_scene(stdin, &scene);
+        }
+
+        printf("STDIN %d\n", i + 1);
+        printf("  read + parse: %.3f ms\n", 1e3 * (timer_now() - start));
+        print_objects(&scene, first_object, &scene_bounds);
+    }
+
+    // Files are loaded one after another so their timings do not overlap, every deserializer still uses all jobs
+    for (size_t i = 0; i < args->files.length; ++i) {
+        size_t first_object = scene.objects.length;
+
+        FileTiming timing;
+        file_add_to_scene_timed(args->files.items[i], args->fallback_color, &scene, &timing);
+
+        printf("%s\n", args->files.items[i]);
+        if (timing.cache_hit) {
+            printf("  cache load:   %.3f ms\n", 1e3 * timing.cache);
+        } else {
+            printf("  read:         %.3f ms\n", 1e3 * timing.read);
+            printf("  parse:        %.3f ms\n", 1e3 * timing.parse);
+            if (timing.triangulate < 0.0) {
+                printf("  triangulate:  n/a\n");
+            } else {
+                printf("  triangulate:  %.3f ms\n", 1e3 * timing.triangulate);
+            }
+            printf("  cache store:  %.3f ms\n", 1e3 * timing.cache);
+        }
+        print_objects(&scene, first_object, &scene_bounds);
+    }
+
+    size_t triangle_count = 0;
+    size_t vertex_count = 0;
+    size_t allocated_bytes = 0;
+    for (size_t i = 0; i < scene.objects.length; ++i) {
+        const Object *obj = &scene.objects.items[i];
+        triangle_count += object_triangle_count(*obj);
+        vertex_count += obj->vertices.length / 3;
+        allocated_bytes += object_allocated_bytes(obj);
+    }
+
+    printf("Scene\n");
+    printf("  total time:   %.3f ms\n", 1e3 * (timer_now() - total_start));
+    printf("  objects:      %zu\n", scene.objects.length);
+    printf("  triangles:    %zu\n", triangle_count);
+    printf("  vertices:     %zu\n", vertex_count);
+    printf("  allocated:    %zu bytes\n", allocated_bytes);
+    print_bounds("  ", &scene_bounds);
+    printf("  radius:       %g\n", scene_get_radius(&scene));
+
+    scene_free_members(&scene);
+}
+
+void print_objects(const Scene *scene, size_t first_object, Bounds *scene_bounds) {
+    for (size_t i = first_object; i < scene->objects.length; ++i) {
+        const Object *obj = &scene->objects.items[i];
+
+        Bounds bounds = EMPTY_BOUNDS;
+        add_object_to_bounds(obj, &bounds);
+        add_object_to_bounds(obj, scene_bounds);
+
+        printf("  object %zu\n", i);
+        const char *layout = object_is_indexed(*obj) ? "indexed" : "soup";
+        printf("    triangles:    %zu (%s)\n", object_triangle_count(*obj), layout);
+        printf("    vertices:     %zu\n", obj->vertices.length / 3);
+        printf("    allocated:    %zu bytes\n", object_allocated_bytes(obj));
+        print_bounds("    ", &bounds);
+    }
+}
+
+size_t object_allocated_bytes(const Object *obj) {
+    // Borrowed vertices belong to the caller
+    size_t bytes = obj->colors.capacity * sizeof(obj->colors.items[0]);
+    bytes += obj->indices.capacity * sizeof(obj->indices.items[0]);
+    if (!obj->borrowed_vertices) bytes += obj->vertices.capacity * sizeof(obj->vertices.items[0]);
+
+    return bytes;
+}
+
+void add_object_to_bounds(const Object *obj, Bounds *bounds) {
+    for (size_t i = 0; i < obj->vertices.length; i += 3) {
+        float x = obj->vertices.items[i];
+        float y = obj->vertices.items[i + 1];
+        float z = obj->vertices.items[i + 2];
+
+        if (x < bounds->min.x) bounds->min.x = x;
+        if (y < bounds->min.y) bounds->min.y = y;
+        if (z < bounds->min.z) bounds->min.z = z;
+        if (x > bounds->max.x) bounds->max.x = x;
+        if (y > bounds->max.y) bounds->max.y = y;
+        if (z > bounds->max.z) bounds->max.z = z;
+    }
+}
+
+void print_bounds(const char *indent, const Bounds *bounds) {
+    if (bounds->min.x > bounds->max.x) {
+        printf("%sbounds:       none\n", indent);
+        return;
+    }
+
+    printf("%sbounds:       (%g, %g, %g) .. (%g, %g, %g)\n", indent, bounds->min.x, bounds->min.y, bounds->min.z,
+           bounds->max.x, bounds->max.y, bounds->max.z);
+}
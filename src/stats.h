@@ -0,0 +1,10 @@
+#ifndef PRINT3_STATS_H_
+#define PRINT3_STATS_H_
+
+#include "args.h"
+
+// Load the inputs with the same deserializers as the viewer and print the timing of every file and the size and
+// extent of every object to stdout, without opening a window
+void stats_run(const Args *args);
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef PRINT3_TIMER_H_
+#define PRINT3_TIMER_H_
+
+// Seconds on a monotonic clock from an unspecified origin, only differences are meaningful
+double timer_now(void);
+
+#endif
@@ -0,0 +1,161 @@
+#include "trace.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include "dsa.h"
+#include "timer.h"
+
+// Keep long viewer sessions from growing the trace without bound
+#define TRACE_MAX_EVENTS (1 << 20)
+
+typedef struct TraceEvent {
+    TraceScope scope;
+    double end;
+    unsigned thread_id;
+} TraceEvent;
+
+typedef struct TraceEvents {
+    TraceEvent *items;
+    size_t length;
+    size_t capacity;
+} TraceEvents;
+
+static once_flag init_flag = ONCE_FLAG_INIT;
+static mtx_t lock;
+static bool recording = false;
+static const char *output_path = NULL;
+static TraceEvents events = {0};
+static size_t dropped_count = 0;
+
+static atomic_uint next_thread_id = 1;
+static thread_local unsigned thread_id = 0;
+
+static void init_lock(void);
+static unsigned get_thread_id(void);
+static void write_event(FILE *file, const TraceEvent *event, double origin);
+
+void trace_set_output(const char *path) {
+    call_once(&init_flag, init_lock);
+    mtx_lock(&lock);
+
+    output_path = path;
+    recording = path != NULL;
+    if (!recording) {
+        free(events.items);
+        events = (TraceEvents){0};
+    }
+
+    mtx_unlock(&lock);
+}
+
+void trace_write(void) {
+    call_once(&init_flag, init_lock);
+    mtx_lock(&lock);
+
+    if (!output_path) {
+        mtx_unlock(&lock);
+        return;
+    }
+
+    FILE *file = fopen(output_path, "w");
+    if (!file) {
+        fprintf(stderr, "[ERR] Could not open the trace \"%s\".\n", output_path);
+        exit(1);
+    }
+
+    // Timestamps start at the first event
+    double origin = events.length ? events.items[0].scope.start : 0.0;
+    for (size_t i = 1; i < events.length; ++i) {
+        if (events.items[i].scope.start < origin) origin = events.items[i].scope.start;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t i = 0; i < events.length; ++i) {
+        write_event(file, &events.items[i], origin);
+        fprintf(file, i + 1 < events.length ? ",\n" : "\n");
+    }
+    fprintf(file, "]}\n");
+
+    if (fclose(file)) {
+        fprintf(stderr, "[ERR] Could not write the trace \"%s\".\n", output_path);
+        exit(1);
+    }
+
+    printf("[INFO] Wrote %zu trace events to \"%s\".\n", events.length, output_path);
+    if (dropped_count) {
+        printf("[WARN] Dropped %zu trace events after the first %d.\n", dropped_count, TRACE_MAX_EVENTS);
+    }
+
+    free(events.items);
+    events = (TraceEvents){0};
+    recording = false;
+
+    mtx_unlock(&lock);
+}
+
+TraceScope trace_begin(const char *name) { return (TraceScope){.name = name, .start = timer_now()}; }
+
+void trace_count(TraceScope *scope, const char *name, uint64_t value) {
+    assert(scope->counter_count < TRACE_MAX_COUNTERS && "Too many counters for one trace scope.");
+    scope->counter_names[scope->counter_count] = name;
+    scope->counter_values[scope->counter_count] = value;
+    scope->counter_count += 1;
+}
+
+void trace_end(const TraceScope *scope) {
+    TraceEvent event = {
+        .scope = *scope,
+        .end = timer_now(),
+        .thread_id = get_thread_id(),
+    };
+
+    call_once(&init_flag, init_lock);
+    mtx_lock(&lock);
+
+    if (recording) {
+        if (events.length < TRACE_MAX_EVENTS) {
+            da_add(events, event);
+        } else {
+            dropped_count += 1;
+        }
+    }
+
+    mtx_unlock(&lock);
+}
+
+void init_lock(void) {
+    if (mtx_init(&lock, mtx_plain) != thrd_success) {
+        fprintf(stderr, "[ERR] Could not create a mutex for the trace.\n");
+        exit(1);
+    }
+}
+
+unsigned get_thread_id(void) {
+    // Small sequential IDs in the order the threads first end a scope, the main thread usually gets 1
+    if (!thread_id) thread_id = atomic_fetch_add(&next_thread_id, 1);
+    return thread_id;
+}
+
+void write_event(FILE *file, const TraceEvent *event, double origin) {
+    // Complete events hold the start and duration in microseconds
+    fprintf(file, "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f",
+            event->scope.name, event->thread_id, 1e6 * (event->scope.start - origin),
+            1e6 * (event->end - event->scope.start));
+
+    if (event->scope.counter_count) {
+        fprintf(file, ", \"args\": {");
+        for (int i = 0; i < event->scope.counter_count; ++i) {
+            fprintf(file, "%s\"%s\": %" PRIu64, i ? ", " : "", event->scope.counter_names[i],
+                    event->scope.counter_values[i]);
+        }
+        fprintf(file, "}");
+    }
+
+    fprintf(file, "}");
+}
@@ -0,0 +1,52 @@
+#ifndef PRINT3_TRACE_H_
+#define PRINT3_TRACE_H_
+
+#include <stdint.h>
+
+// Scoped timings of the pipeline written in the Chrome trace event format, viewable in Perfetto or chrome://tracing.
+// Configure with -DPRINT3_TRACE=ON to record them, otherwise every macro compiles to nothing and its arguments are
+// not evaluated. Scopes are opened and closed in the same block:
+//
+//     TRACE_BEGIN(read, "read");
+//     ...
+//     TRACE_COUNT(read, "bytes", size);
+//     TRACE_END(read);
+
+#define TRACE_MAX_COUNTERS 2
+
+#if defined(PRINT3_TRACE)
+
+typedef struct TraceScope {
+    const char *name;
+    double start;
+    const char *counter_names[TRACE_MAX_COUNTERS];
+    uint64_t counter_values[TRACE_MAX_COUNTERS];
+    int counter_count;
+} TraceScope;
+
+// Events are recorded once an output is set, a NULL path stops recording and drops them.
+// Scopes which began earlier but end afterwards are still recorded.
+void trace_set_output(const char *path);
+void trace_write(void);
+
+TraceScope trace_begin(const char *name);
+void trace_count(TraceScope *scope, const char *name, uint64_t value);
+void trace_end(const TraceScope *scope);
+
+#define TRACE_BEGIN(scope, name) TraceScope scope = trace_begin(name)
+#define TRACE_COUNT(scope, name, value) trace_count(&(scope), name, value)
+#define TRACE_END(scope) trace_end(&(scope))
+#define TRACE_SET_OUTPUT(path) trace_set_output(path)
+#define TRACE_WRITE() trace_write()
+
+#else
+
+#define TRACE_BEGIN(scope, name) ((void)0)
+#define TRACE_COUNT(scope, name, value) ((void)0)
+#define TRACE_END(scope) ((void)0)
+#define TRACE_SET_OUTPUT(path) ((void)0)
+#define TRACE_WRITE() ((void)0)
+
+#endif
+
+#endif
@@ -3,12 +3,23 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
+#include "bvh.h"
+#include "lod.h"
+#include "parallel.h"
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
+#include "trace.h"
 
 #define TARGET_FPS 60
 
+// Frames without an event to wait for are polled at this rate while there is no input,
+// and at the target rate for a while after the last input
+#define IDLE_FPS 10
+#define INPUT_ACTIVE_SECONDS 1.0
+
 #define COS_VIEW_WIDTH 200
 #define COS_VIEW_HEIGHT 200
 
@@ -16,6 +27,41 @@
 #define PAN_SENEITIVITY 1.8
 #define ZOOM_SENSITIVITY 0.3
 
+// Indices of raylib meshes are 16 bit
+#define MAX_MESH_VERTICES 65535
+
+// The scene is drawn in clusters of spatially close triangles, each one mesh, which are culled against the view
+#define MAX_CLUSTER_TRIANGLES (1 << 14)
+static_assert(3 * MAX_CLUSTER_TRIANGLES <= MAX_MESH_VERTICES, "The corners of a cluster must fit into one mesh.");
+
+// Marks the clusters with the triangles of all objects without levels of detail
+#define SMALL_OBJECTS SIZE_MAX
+
+// Objects are drawn at the finest level of detail with at least this many pixels per triangle,
+// counted in the square over the projected diagonal of their bounds
+#define LOD_PIXELS_PER_TRIANGLE 2.0f
+// While the camera is dragged, the objects get coarser to keep the frame rate up
+#define LOD_INTERACTION_FACTOR 16.0f
+
+// Streamed triangles are uploaded into meshes of fixed capacity, with a limit per frame to keep the frame rate
+#define STREAM_MESH_VERTICES (3 * (1 << 16))
+#define STREAM_UPLOAD_VERTICES_PER_FRAME (3 * (1 << 16))
+
+// The benchmark camera path: frames before measuring, then an orbit, a zoom in and out and a circular pan
+#define BENCHMARK_WARMUP_FRAMES 30
+#define BENCHMARK_PHASE_FRAMES 360
+#define BENCHMARK_FRAME_COUNT (BENCHMARK_WARMUP_FRAMES + 3 * BENCHMARK_PHASE_FRAMES)
+#define BENCHMARK_ZOOM_FACTOR 4.0f
+#define BENCHMARK_PAN_PIXELS_PER_FRAME 4.0f
+
+// Fragment shader for the wireframe pass, the edge color is passed as diffuse color of the material.
+// It is combined with the default vertex shader of raylib.
+static const char *EDGE_FRAGMENT_SHADER =
+    "#version 330\n"
+    "uniform vec4 colDiffuse;\n"
+    "out vec4 finalColor;\n"
+    "void main() { finalColor = colDiffuse; }\n";
+
 typedef struct SurfaceSelection {
     bool active;
     Vector3 point;
@@ -23,29 +69,146 @@ typedef struct SurfaceSelection {
     Vector3 vertices[3];
 } SurfaceSelection;
 
+// Consecutive triangles of the scene or of a level of detail, which are drawn as one mesh
+typedef struct Cluster {
+    BoundingBox bounds;
+    size_t first;  // Into the triangles of all objects in scene order or of the level
+    size_t count;
+    size_t object;  // Only triangles of this object belong to the cluster, or of all objects without levels
+    size_t level;   // 0 for the object itself, level i is level i - 1 of the build
+    bool visible;   // Intersects the view frustum of the current frame and its level is the one drawn
+} Cluster;
+
+typedef struct Clusters {
+    Cluster *items;  // Cluster i is drawn by mesh i of the scene model
+    size_t length;
+    size_t capacity;
+} Clusters;
+
+typedef struct ClusterMeshes {
+    const Scene *scene;
+    const size_t *offsets;  // First triangle of every object, followed by the total triangle count
+    Clusters *clusters;
+    Mesh *meshes;
+} ClusterMeshes;
+
+typedef struct LevelMeshes {
+    const LodBuild *build;
+    Clusters *clusters;
+    Mesh *meshes;
+} LevelMeshes;
+
+typedef struct ObjectIndices {
+    size_t *items;
+    size_t length;
+    size_t capacity;
+} ObjectIndices;
+
+// Collects triangles into one mesh, vertices shared by triangles of indexed objects are stored once
+typedef struct MeshBuilder {
+    Mesh mesh;
+    size_t table_size;
+    uint64_t *keys;          // Object and vertex offset by one, 0 marks empty slots
+    unsigned short *values;  // Mesh vertex of the key
+} MeshBuilder;
+
+typedef struct LodObject {
+    BoundingBox bounds;  // Of its first level
+    size_t level;        // Drawn level, 0 for the object itself
+} LodObject;
+
+// Triangles received from a stream while the viewer is running
+typedef struct StreamedTriangles {
+    StdinStream *stream;  // NULL if nothing is streamed
+    bool active;
+    Object object;  // Triangle soup of all received triangles
+    size_t uploaded_vertex_count;
+    Model model;  // Dynamic meshes, all but the last one are full
+} StreamedTriangles;
+
+// Render texture of the coordinate system view, rendered again only when the camera orientation changes
+typedef struct CosView {
+    RenderTexture texture;
+    bool rendered;
+    Vector3 direction;  // Camera orientation of the rendered texture
+    Vector3 up;
+} CosView;
+
+typedef struct FrameTimes {
+    double *items;  // Seconds per frame
+    size_t length;
+    size_t capacity;
+} FrameTimes;
+
+// Frame times of the scripted camera path, only recorded with a benchmark path in the options
+typedef struct Benchmark {
+    size_t frame;
+    FrameTimes cpu;    // Updating the viewer and issuing the draw calls, until EndDrawing
+    FrameTimes total;  // Including EndDrawing, which flushes the draw calls and swaps the buffers
+} Benchmark;
+
 typedef struct ViewerContext {
     const ViewerOptions *options;
     float scene_radius;
+    BvhBuild bvh_build;  // Accelerates the surface selection, built in the background
+    Clusters clusters;
+    LodBuild lod_build;  // Levels of detail of the large objects, built in the background
+    bool lod_uploaded;
+    Model lod_model;  // Meshes of all levels
+    Clusters lod_clusters;
+    LodObject *lod_objects;  // One per object of the scene
+    StreamedTriangles streamed;
     bool display_hud;
     bool display_cos;
     SurfaceSelection surface_selection;
+    Benchmark benchmark;
+    double last_input_time;
 } ViewerContext;
 
 // Scene
-static float get_scene_radius(const Scene *scene);
-static void set_empty_mesh_with_scene(const Scene *scene, Mesh *mesh);
-static void invert_normals_mesh(Mesh *mesh);
-static void set_mesh_color(Color color, Mesh *mesh);
+static void set_empty_model_with_scene(const Scene *scene, Clusters *clusters, Model *model);
+static void set_empty_model(size_t mesh_count, Model *model);
+static void add_clusters(const Scene *scene, const size_t *offsets, Clusters *clusters);
+static void build_cluster_mesh_task(void *context, size_t index);
+static void set_cluster_bounds(Cluster *cluster, const Mesh *mesh);
+static MeshBuilder begin_mesh(size_t max_triangle_count);
+static void add_mesh_triangle(MeshBuilder *builder, const Object *obj, size_t object_index, size_t triangle);
+static Mesh end_mesh(MeshBuilder *builder);
+static void upload_model(Model *model);
+static void update_levels_of_detail(const Scene *scene, const Camera *camera, ViewerContext *context);
+static void set_model_with_levels(const LodBuild *build, Clusters *clusters, LodObject *objects, Model *model);
+static void build_level_mesh_task(void *context, size_t index);
+static void cull_clusters(Clusters *clusters, const LodObject *objects);
+static bool is_box_in_frustum(const float planes[6][4], BoundingBox box);
+static void draw_model(const ViewerOptions *options, Model model, const Clusters *clusters, Shader edge_shader);
+static void draw_meshes(Model model, const Clusters *clusters, Color tint);
+static void receive_streamed_triangles(ViewerContext *context);
+static void upload_streamed_triangles(StreamedTriangles *streamed);
+static void add_stream_mesh(Model *model);
 static void draw_surface_selection(const ViewerContext *context);
-static void create_screenshot();
+static void create_screenshot(const ViewerContext *context);
 
 // Viewer context
 static void update_context(const Scene *scene, const Camera *camera, ViewerContext *context);
-static void set_surface_selection(const Scene *scene, const Camera *camera, SurfaceSelection *surface_selection);
+static bool is_stream_pending(const StreamedTriangles *streamed);
+static void pace_frames(ViewerContext *context, bool is_stop_requestable);
+static bool has_input(void);
+static void set_surface_selection(const Scene *scene, BvhBuild *bvh_build, const Object *streamed,
+                                  const Camera *camera, SurfaceSelection *surface_selection);
 
 // Camera control
 static void reset_camera(const ViewerContext *context, Camera *camera);
 static void update_camera(const ViewerContext *context, Camera *camera);
+static void rotate_camera(Vector2 mouse_delta, Camera *camera);
+static void pan_camera(Vector2 mouse_delta, Camera *camera);
+static void zoom_camera(float mouse_wheel_move, Camera *camera);
+
+// Benchmark
+static void update_benchmark_camera(size_t frame, Camera *camera);
+static bool record_benchmark_frame(Benchmark *benchmark, double cpu_seconds, double total_seconds);
+static void write_benchmark_report(const char *path, const Benchmark *benchmark);
+static void write_percentiles(FILE *file, const char *name, const FrameTimes *times);
+static int compare_seconds(const void *a, const void *b);
 
 // HUD
 static void draw_control_info(const ViewerContext *context);
@@ -54,53 +217,90 @@ static void draw_fps(const ViewerContext *context);
 // Visualization of the coordinate system
 static void draw_arrow(Vector3 start, Vector3 dir_normalized, float line_length, float line_radius, float tip_length,
                        float tip_radius, int sides, Color color);
-static void render_cos_view(const ViewerContext *context, Camera *camera, RenderTexture *cos_view);
-static void draw_rendered_cos_view(const ViewerContext *context, const RenderTexture *cos_view);
+static void render_cos_view(const ViewerContext *context, const Camera *camera, CosView *cos_view);
+static void draw_rendered_cos_view(const ViewerContext *context, const CosView *cos_view);
+
+ViewerOptions viewer_get_default_options(void) {
+    return (ViewerOptions){
+        .window_title = "print3",
+        .initial_window_width = 1600,
+        .initial_window_height = 900,
+        .true_no_hud = false,
+        .background = WHITE,
+        .render_facets_both_sides = false,
+        .edge_color = (Color){0, 0, 0, 0},
+        .benchmark_path = NULL,
+    };
+}
 
-void viewer_run(const ViewerOptions *options, const Scene *scene, const bool *should_run) {
+void viewer_run(const ViewerOptions *options, const Scene *scene, StdinStream *stream, const bool *should_run) {
     ViewerContext context = {
         .options = options,
-        .scene_radius = get_scene_radius(scene),
+        .scene_radius = scene_get_radius(scene),
+        .streamed = {.stream = stream, .active = stream != NULL},
         .display_hud = true,
         .display_cos = true,
+        .lod_objects = calloc(scene->objects.length, sizeof(LodObject)),
     };
 
+    // The hierarchy is only needed for the surface selection, so the window does not wait for it
+    bvh_build_start(scene, &context.bvh_build);
+
     // Create a resizable window
+    TRACE_BEGIN(init_window, "init window");
     SetTraceLogLevel(LOG_WARNING);
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(options->initial_window_width, options->initial_window_height, options->window_title);
-
-    // Create all models of the scene
-    Mesh mesh = {0};
-    Mesh inverted_mesh = {0};
-    Mesh wireframe_mesh = {0};
-    set_empty_mesh_with_scene(scene, &mesh);
-    set_empty_mesh_with_scene(scene, &inverted_mesh);
-    invert_normals_mesh(&inverted_mesh);
-    set_empty_mesh_with_scene(scene, &wireframe_mesh);
-    set_mesh_color(options->edge_color, &wireframe_mesh);
-    UploadMesh(&mesh, false);
-    UploadMesh(&inverted_mesh, false);
-    UploadMesh(&wireframe_mesh, false);
-    Model model = LoadModelFromMesh(mesh);
-    Model inverted_model = LoadModelFromMesh(inverted_mesh);
-    Model wireframe_model = LoadModelFromMesh(wireframe_mesh);
+    TRACE_END(init_window);
+
+    // Create the model of the scene, all render passes share its buffers
+    Model model = {0};
+    TRACE_BEGIN(build_model, "build model");
+    set_empty_model_with_scene(scene, &context.clusters, &model);
+    TRACE_COUNT(build_model, "meshes", model.meshCount);
+    TRACE_END(build_model);
+    upload_model(&model);
+    Shader edge_shader = LoadShaderFromMemory(NULL, EDGE_FRAGMENT_SHADER);
+
+    // Large objects are drawn in full detail until their levels are built
+    lod_build_start(scene, &context.lod_build);
+
+    // Streamed triangles get a model of their own, which grows while the viewer is running
+    context.streamed.model.transform = MatrixIdentity();
+    context.streamed.model.materialCount = 1;
+    context.streamed.model.materials = (Material *)MemAlloc(sizeof(Material));
+    context.streamed.model.materials[0] = LoadMaterialDefault();
 
     // Create a render texture for the coordinate system view
-    RenderTexture cos_view = LoadRenderTexture(COS_VIEW_WIDTH, COS_VIEW_HEIGHT);
+    CosView cos_view = {.texture = LoadRenderTexture(COS_VIEW_WIDTH, COS_VIEW_HEIGHT)};
 
     // Set up the camera for the scene
     Camera camera = {0};
     reset_camera(&context, &camera);
 
-    SetTargetFPS(TARGET_FPS);
+    // The benchmark measures how fast frames can be drawn, so it does not wait for the next frame
+    bool benchmark = options->benchmark_path != NULL;
+    SetTargetFPS(benchmark ? 0 : TARGET_FPS);
 
     // Check for ending signal from cancelation token and GUI events
-    while (*should_run && !WindowShouldClose()) {
+    while ((!should_run || *should_run) && !WindowShouldClose()) {
+        double frame_start = GetTime();
+        TRACE_BEGIN(frame, "frame");
+
         // Update the state of the viewer
+        TRACE_BEGIN(update, "update");
+        receive_streamed_triangles(&context);
+        upload_streamed_triangles(&context.streamed);
         update_context(scene, &camera, &context);
-        update_camera(&context, &camera);
+        if (benchmark) {
+            update_benchmark_camera(context.benchmark.frame, &camera);
+        } else {
+            update_camera(&context, &camera);
+        }
+        update_levels_of_detail(scene, &camera, &context);
+        TRACE_END(update);
 
+        TRACE_BEGIN(draw, "draw");
         render_cos_view(&context, &camera, &cos_view);
 
         BeginDrawing();
@@ -108,9 +308,13 @@ void viewer_run(const ViewerOptions *options, const Scene *scene, const bool *sh
         ClearBackground(options->background);
 
         BeginMode3D(camera);
-        DrawModel(model, (Vector3){0, 0, 0}, 1, WHITE);
-        if (options->render_facets_both_sides) DrawModel(inverted_model, (Vector3){0, 0, 0}, 1, WHITE);
-        if (options->edge_color.a) DrawModelWires(wireframe_model, (Vector3){0, 0, 0}, 1, WHITE);
+        cull_clusters(&context.clusters, context.lod_objects);
+        draw_model(options, model, &context.clusters, edge_shader);
+        if (context.lod_uploaded) {
+            cull_clusters(&context.lod_clusters, context.lod_objects);
+            draw_model(options, context.lod_model, &context.lod_clusters, edge_shader);
+        }
+        draw_model(options, context.streamed.model, NULL, edge_shader);
         draw_surface_selection(&context);
         EndMode3D();
 
@@ -119,93 +323,455 @@ void viewer_run(const ViewerOptions *options, const Scene *scene, const bool *sh
         draw_control_info(&context);
         draw_fps(&context);
 
+        double cpu_seconds = GetTime() - frame_start;
+        TRACE_END(draw);
+
+        pace_frames(&context, should_run != NULL);
+
+        // Flushes the batched draw calls and swaps the buffers, which waits for the GPU when it falls behind
+        TRACE_BEGIN(end_drawing, "end drawing");
         EndDrawing();
+        TRACE_END(end_drawing);
+
+        create_screenshot(&context);
+        TRACE_END(frame);
 
-        create_screenshot();
+        // The benchmark ends with its camera path, which starts once the levels of detail are drawn
+        double total_seconds = GetTime() - frame_start;
+        if (benchmark && context.lod_uploaded &&
+            !record_benchmark_frame(&context.benchmark, cpu_seconds, total_seconds)) {
+            write_benchmark_report(options->benchmark_path, &context.benchmark);
+            break;
+        }
     }
 
     // De-initialize resources
-    UnloadRenderTexture(cos_view);
-    UnloadModel(wireframe_model);
-    UnloadModel(inverted_model);
+    UnloadRenderTexture(cos_view.texture);
+    UnloadShader(edge_shader);
+    UnloadModel(context.streamed.model);
     UnloadModel(model);
+    if (context.lod_uploaded) UnloadModel(context.lod_model);
     CloseWindow();
+
+    lod_build_stop(&context.lod_build);
+    bvh_build_stop(&context.bvh_build);
+
+    free(context.streamed.object.vertices.items);
+    free(context.streamed.object.colors.items);
+    free(context.benchmark.cpu.items);
+    free(context.benchmark.total.items);
+    free(context.clusters.items);
+    free(context.lod_clusters.items);
+    free(context.lod_objects);
 }
 
 // ****************************************************************************
 // Scene
 // ****************************************************************************
 
-float get_scene_radius(const Scene *scene) {
-    // Compare the squares for the max length cos length needs sqrt to compute
-    // only compute the sqrt of the maximum
-    // Add one to the found radius to ensure a little distance is always kept
-    // Scene radius is only used to prevent clipping through objects for zooming the fov can be modified
-    float max_length_sqr = 0.0f;
+void set_empty_model_with_scene(const Scene *scene, Clusters *clusters, Model *model) {
+    // Triangles are numbered over all objects
+    size_t *offsets = malloc((scene->objects.length + 1) * sizeof(size_t));
+    assert(offsets && "Could not allocate the triangle offsets.");
+    offsets[0] = 0;
+    for (size_t i = 0; i < scene->objects.length; ++i) {
+        offsets[i + 1] = offsets[i] + object_triangle_count(scene->objects.items[i]);
+    }
 
-    for (size_t i_obj = 0; i_obj < scene->objects.length; ++i_obj) {
-        Object obj = scene->objects.items[i_obj];
+    add_clusters(scene, offsets, clusters);
 
-        for (size_t i_ver = 0; i_ver < obj.vertices.length; i_ver += 3) {
-            Vector3 v = {obj.vertices.items[i_ver], obj.vertices.items[i_ver + 1], obj.vertices.items[i_ver + 2]};
-            float length_sqr = Vector3LengthSqr(v);
+    set_empty_model(clusters->length, model);
+    ClusterMeshes cluster_meshes = {.scene = scene, .offsets = offsets, .clusters = clusters, .meshes = model->meshes};
+    parallel_for(clusters->length, build_cluster_mesh_task, &cluster_meshes);
 
-            if (length_sqr > max_length_sqr) {
-                max_length_sqr = length_sqr;
+    free(offsets);
+}
+
+void set_empty_model(size_t mesh_count, Model *model) {
+    // All meshes share the default material
+    *model = (Model){0};
+    model->transform = MatrixIdentity();
+    model->meshCount = mesh_count;
+    model->meshes = (Mesh *)MemAlloc(mesh_count * sizeof(Mesh));
+    model->materialCount = 1;
+    model->materials = (Material *)MemAlloc(sizeof(Material));
+    model->materials[0] = LoadMaterialDefault();
+    model->meshMaterial = (int *)MemAlloc(mesh_count * sizeof(int));
+}
+
+void add_clusters(const Scene *scene, const size_t *offsets, Clusters *clusters) {
+    // Clusters follow the order of the triangles, in which files mostly list neighboring triangles close together.
+    // Ordering them by the hierarchy would keep the window waiting for it.
+    Cluster small = {.object = SMALL_OBJECTS, .visible = true};
+    for (size_t i = 0; i < scene->objects.length; ++i) {
+        // Consecutive objects without levels of detail share clusters
+        if (!lod_has_levels(scene->objects.items[i])) {
+            for (size_t first = offsets[i]; first < offsets[i + 1];) {
+                if (!small.count) small.first = first;
+                size_t count = offsets[i + 1] - first;
+                if (count > MAX_CLUSTER_TRIANGLES - small.count) count = MAX_CLUSTER_TRIANGLES - small.count;
+
+                small.count += count;
+                first += count;
+                if (small.count == MAX_CLUSTER_TRIANGLES) {
+                    da_add(*clusters, small);
+                    small.count = 0;
+                }
             }
+            continue;
+        }
+
+        // Objects with levels of detail get clusters of their own, so they can be hidden while a level is drawn
+        if (small.count) {
+            da_add(*clusters, small);
+            small.count = 0;
+        }
+        for (size_t first = offsets[i]; first < offsets[i + 1]; first += MAX_CLUSTER_TRIANGLES) {
+            size_t count = offsets[i + 1] - first;
+            if (count > MAX_CLUSTER_TRIANGLES) count = MAX_CLUSTER_TRIANGLES;
+
+            Cluster cluster = {.first = first, .count = count, .object = i, .visible = true};
+            da_add(*clusters, cluster);
         }
     }
 
-    return 1.0f + sqrtf(max_length_sqr);
+    if (small.count) da_add(*clusters, small);
 }
 
-void set_empty_mesh_with_scene(const Scene *scene, Mesh *mesh) {
-    size_t vertex_count = 0;
-    for (size_t i = 0; i < scene->objects.length; ++i) {
-        size_t obj_vertex_count = scene->objects.items[i].vertices.length / 3;
+void build_cluster_mesh_task(void *context, size_t index) {
+    ClusterMeshes *cluster_meshes = context;
+    Cluster *cluster = &cluster_meshes->clusters->items[index];
+    const size_t *offsets = cluster_meshes->offsets;
+    const Objects *objects = &cluster_meshes->scene->objects;
+
+    // Find the object of the first triangle
+    size_t lower = 0;
+    size_t upper = objects->length;
+    while (upper - lower > 1) {
+        size_t middle = (lower + upper) / 2;
+        if (offsets[middle] <= cluster->first) {
+            lower = middle;
+        } else {
+            upper = middle;
+        }
+    }
+
+    MeshBuilder builder = begin_mesh(cluster->count);
+    size_t i_obj = lower;
+    for (size_t i = cluster->first; i < cluster->first + cluster->count; ++i) {
+        while (i >= offsets[i_obj + 1]) ++i_obj;
+        add_mesh_triangle(&builder, &objects->items[i_obj], i_obj, i - offsets[i_obj]);
+    }
+    cluster_meshes->meshes[index] = end_mesh(&builder);
+
+    set_cluster_bounds(cluster, &cluster_meshes->meshes[index]);
+}
+
+void set_cluster_bounds(Cluster *cluster, const Mesh *mesh) {
+    const float *vertices = mesh->vertices;
+    cluster->bounds = (BoundingBox){{vertices[0], vertices[1], vertices[2]}, {vertices[0], vertices[1], vertices[2]}};
+    for (int i = 1; i < mesh->vertexCount; ++i) {
+        Vector3 v = {vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]};
+        cluster->bounds.min = Vector3Min(cluster->bounds.min, v);
+        cluster->bounds.max = Vector3Max(cluster->bounds.max, v);
+    }
+}
+
+MeshBuilder begin_mesh(size_t max_triangle_count) {
+    // The open addressing table maps object and vertex to the mesh vertex, it is at most half full
+    MeshBuilder builder = {.table_size = 1};
+    while (builder.table_size < 6 * max_triangle_count) builder.table_size *= 2;
+    builder.keys = calloc(builder.table_size, sizeof(uint64_t));
+    builder.values = malloc(builder.table_size * sizeof(unsigned short));
+    assert(builder.keys && builder.values && "Could not allocate the vertex table of a mesh.");
+
+    builder.mesh.vertices = (float *)MemAlloc(9 * max_triangle_count * sizeof(float));
+    builder.mesh.colors = (unsigned char *)MemAlloc(12 * max_triangle_count * sizeof(unsigned char));
+    builder.mesh.indices = (unsigned short *)MemAlloc(3 * max_triangle_count * sizeof(unsigned short));
+    return builder;
+}
 
-        assert(obj_vertex_count * 4 == scene->objects.items[i].colors.length &&
-               "Dimension mismatch between colors and vertices");
+void add_mesh_triangle(MeshBuilder *builder, const Object *obj, size_t object_index, size_t triangle) {
+    Mesh *mesh = &builder->mesh;
+    unsigned short *indices = &mesh->indices[3 * mesh->triangleCount++];
 
-        vertex_count += obj_vertex_count;
+    for (size_t k = 0; k < 3; ++k) {
+        size_t vertex = object_corner_vertex(*obj, 3 * triangle + k);
+
+        // Vertices of triangle soups are never shared
+        if (object_is_indexed(*obj)) {
+            uint64_t key = ((uint64_t)object_index << 32 | vertex) + 1;
+            size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 40) & (builder->table_size - 1);
+            while (builder->keys[slot] && builder->keys[slot] != key) slot = (slot + 1) & (builder->table_size - 1);
+
+            if (builder->keys[slot]) {
+                indices[k] = builder->values[slot];
+                continue;
+            }
+            builder->keys[slot] = key;
+            builder->values[slot] = mesh->vertexCount;
+        }
+
+        memcpy(&mesh->vertices[3 * mesh->vertexCount], &obj->vertices.items[3 * vertex], 3 * sizeof(float));
+        memcpy(&mesh->colors[4 * mesh->vertexCount], &obj->colors.items[4 * vertex], 4 * sizeof(unsigned char));
+        indices[k] = mesh->vertexCount++;
+    }
+}
+
+Mesh end_mesh(MeshBuilder *builder) {
+    // Release the space reserved for unshared vertices and for triangles of other objects
+    Mesh mesh = builder->mesh;
+    mesh.vertices = (float *)MemRealloc(mesh.vertices, mesh.vertexCount * 3 * sizeof(float));
+    mesh.colors = (unsigned char *)MemRealloc(mesh.colors, mesh.vertexCount * 4 * sizeof(unsigned char));
+    mesh.indices = (unsigned short *)MemRealloc(mesh.indices, mesh.triangleCount * 3 * sizeof(unsigned short));
+
+    free(builder->values);
+    free(builder->keys);
+    return mesh;
+}
+
+void upload_model(Model *model) {
+    TRACE_BEGIN(upload, "upload model");
+    for (int i = 0; i < model->meshCount; ++i) {
+        UploadMesh(&model->meshes[i], false);
     }
+    TRACE_COUNT(upload, "meshes", model->meshCount);
+    TRACE_END(upload);
+}
 
-    mesh->triangleCount = vertex_count / 3;
-    mesh->vertexCount = vertex_count;
+void update_levels_of_detail(const Scene *scene, const Camera *camera, ViewerContext *context) {
+    // A finished build is picked up with the next frame, idle windows draw the objects in full detail anyway
+    if (!context->lod_uploaded) {
+        if (!lod_build_is_finished(&context->lod_build)) return;
+
+        TRACE_BEGIN(build_lod_model, "build lod model");
+        set_model_with_levels(&context->lod_build, &context->lod_clusters, context->lod_objects, &context->lod_model);
+        TRACE_COUNT(build_lod_model, "meshes", context->lod_model.meshCount);
+        TRACE_END(build_lod_model);
+        upload_model(&context->lod_model);
+        context->lod_uploaded = true;
+    }
 
-    mesh->vertices = (float *)MemAlloc(vertex_count * 3 * sizeof(float));
-    mesh->colors = (unsigned char *)MemAlloc(vertex_count * 4 * sizeof(unsigned));
+    // Orthographic cameras show fovy units over the height of the screen
+    float pixels_per_unit = GetScreenHeight() / camera->fovy;
+    bool is_dragged = !context->options->benchmark_path &&
+                      (IsMouseButtonDown(MOUSE_BUTTON_LEFT) || IsMouseButtonDown(MOUSE_BUTTON_RIGHT));
 
-    size_t vertex_offset = 0;
     for (size_t i = 0; i < scene->objects.length; ++i) {
-        size_t obj_vertex_count = scene->objects.items[i].vertices.length / 3;
+        const LodLevels *levels = &context->lod_build.levels[i];
+        LodObject *obj = &context->lod_objects[i];
+        if (!levels->length) continue;
+
+        float pixels = Vector3Distance(obj->bounds.min, obj->bounds.max) * pixels_per_unit;
+        float budget = pixels * pixels / LOD_PIXELS_PER_TRIANGLE;
+        if (is_dragged) budget /= LOD_INTERACTION_FACTOR;
+
+        // The finest level within the budget, or the coarsest level
+        size_t triangle_count = object_triangle_count(scene->objects.items[i]);
+        obj->level = 0;
+        while (obj->level < levels->length && triangle_count > budget) {
+            triangle_count = object_triangle_count(levels->items[obj->level]);
+            ++obj->level;
+        }
+    }
+}
 
-        memcpy(&mesh->vertices[3 * vertex_offset], scene->objects.items[i].vertices.items,
-               obj_vertex_count * 3 * sizeof(float));
-        memcpy(&mesh->colors[4 * vertex_offset], scene->objects.items[i].colors.items,
-               obj_vertex_count * 4 * sizeof(unsigned char));
+void set_model_with_levels(const LodBuild *build, Clusters *clusters, LodObject *objects, Model *model) {
+    // Levels are split into meshes in the order of their triangles, which follows the order of the object
+    for (size_t i = 0; i < build->scene->objects.length; ++i) {
+        const LodLevels *levels = &build->levels[i];
+
+        for (size_t i_level = 0; i_level < levels->length; ++i_level) {
+            size_t triangle_count = object_triangle_count(levels->items[i_level]);
+
+            for (size_t first = 0; first < triangle_count; first += MAX_CLUSTER_TRIANGLES) {
+                Cluster cluster = {
+                    .first = first,
+                    .count = triangle_count - first < MAX_CLUSTER_TRIANGLES ? triangle_count - first
+                                                                            : MAX_CLUSTER_TRIANGLES,
+                    .object = i,
+                    .level = i_level + 1,
+                };
+                da_add(*clusters, cluster);
+            }
+        }
+    }
+
+    set_empty_model(clusters->length, model);
+    LevelMeshes level_meshes = {.build = build, .clusters = clusters, .meshes = model->meshes};
+    parallel_for(clusters->length, build_level_mesh_task, &level_meshes);
+
+    // The bounds of the finest level decide which level an object is drawn at
+    for (size_t i = 0; i < build->scene->objects.length; ++i) {
+        objects[i].bounds = (BoundingBox){{INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY}};
+    }
+    for (size_t i = 0; i < clusters->length; ++i) {
+        const Cluster *cluster = &clusters->items[i];
+        if (cluster->level != 1) continue;
 
-        vertex_offset += obj_vertex_count;
+        BoundingBox *bounds = &objects[cluster->object].bounds;
+        bounds->min = Vector3Min(bounds->min, cluster->bounds.min);
+        bounds->max = Vector3Max(bounds->max, cluster->bounds.max);
     }
 }
 
-void invert_normals_mesh(Mesh *mesh) {
-    for (size_t i = 0; i < mesh->vertexCount * 3; i += 9) {
-        for (size_t i_comp = 0; i_comp < 3; ++i_comp) {
-            float temp = mesh->vertices[i + 3 + i_comp];
-            mesh->vertices[i + 3 + i_comp] = mesh->vertices[i + 6 + i_comp];
-            mesh->vertices[i + 6 + i_comp] = temp;
+void build_level_mesh_task(void *context, size_t index) {
+    LevelMeshes *level_meshes = context;
+    Cluster *cluster = &level_meshes->clusters->items[index];
+    const Object *level = &level_meshes->build->levels[cluster->object].items[cluster->level - 1];
+
+    MeshBuilder builder = begin_mesh(cluster->count);
+    for (size_t i = cluster->first; i < cluster->first + cluster->count; ++i) {
+        add_mesh_triangle(&builder, level, cluster->object, i);
+    }
+    level_meshes->meshes[index] = end_mesh(&builder);
+
+    set_cluster_bounds(cluster, &level_meshes->meshes[index]);
+}
+
+void cull_clusters(Clusters *clusters, const LodObject *objects) {
+    // Planes of the view frustum in world space from the matrices set up by BeginMode3D.
+    // The rows of the combined matrix map to clip space, a point is inside when -w <= x, y, z <= w.
+    Matrix m = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+    float rows[4][4] = {
+        {m.m0, m.m4, m.m8, m.m12},
+        {m.m1, m.m5, m.m9, m.m13},
+        {m.m2, m.m6, m.m10, m.m14},
+        {m.m3, m.m7, m.m11, m.m15},
+    };
+
+    float planes[6][4];
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t k = 0; k < 4; ++k) {
+            planes[2 * i][k] = rows[3][k] + rows[i][k];
+            planes[2 * i + 1][k] = rows[3][k] - rows[i][k];
         }
     }
+
+    // Clusters of objects with levels of detail are only drawn at the level selected for their object
+    for (size_t i = 0; i < clusters->length; ++i) {
+        Cluster *cluster = &clusters->items[i];
+        bool is_drawn_level = cluster->object == SMALL_OBJECTS || objects[cluster->object].level == cluster->level;
+        cluster->visible = is_drawn_level && is_box_in_frustum(planes, cluster->bounds);
+    }
+}
+
+bool is_box_in_frustum(const float planes[6][4], BoundingBox box) {
+    // The box is outside when even its corner farthest along the normal of a plane is behind that plane.
+    // Boxes near the edges of the frustum may be kept although they are outside, they are clipped when drawn.
+    for (size_t i = 0; i < 6; ++i) {
+        float x = planes[i][0] > 0 ? box.max.x : box.min.x;
+        float y = planes[i][1] > 0 ? box.max.y : box.min.y;
+        float z = planes[i][2] > 0 ? box.max.z : box.min.z;
+        if (planes[i][0] * x + planes[i][1] * y + planes[i][2] * z + planes[i][3] < 0) return false;
+    }
+
+    return true;
+}
+
+void draw_model(const ViewerOptions *options, Model model, const Clusters *clusters, Shader edge_shader) {
+    // Back faces are rendered by disabling the culling instead of a second model with inverted normals
+    if (options->render_facets_both_sides) rlDisableBackfaceCulling();
+    draw_meshes(model, clusters, WHITE);
+    if (options->render_facets_both_sides) rlEnableBackfaceCulling();
+
+    if (!options->edge_color.a) return;
+
+    // The edge shader ignores the vertex colors and uses the tint as color for all edges
+    Shader face_shader = model.materials[0].shader;
+    model.materials[0].shader = edge_shader;
+    rlEnableWireMode();
+    draw_meshes(model, clusters, options->edge_color);
+    rlDisableWireMode();
+    model.materials[0].shader = face_shader;
+}
+
+void draw_meshes(Model model, const Clusters *clusters, Color tint) {
+    // Same as DrawModel at the origin, but only meshes of visible clusters are drawn when clusters are given
+    Color color = model.materials[0].maps[MATERIAL_MAP_DIFFUSE].color;
+    model.materials[0].maps[MATERIAL_MAP_DIFFUSE].color = tint;
+
+    for (int i = 0; i < model.meshCount; ++i) {
+        if (clusters && !clusters->items[i].visible) continue;
+        DrawMesh(model.meshes[i], model.materials[model.meshMaterial[i]], model.transform);
+    }
+
+    model.materials[0].maps[MATERIAL_MAP_DIFFUSE].color = color;
+}
+
+void receive_streamed_triangles(ViewerContext *context) {
+    StreamedTriangles *streamed = &context->streamed;
+    if (!streamed->active) return;
+
+    Object taken;
+    streamed->active = stdin_stream_take(streamed->stream, &taken);
+
+    // Keep the scene radius up to date, so the camera does not clip through the new triangles
+    for (size_t i = 0; i < taken.vertices.length; i += 3) {
+        Vector3 v = {taken.vertices.items[i], taken.vertices.items[i + 1], taken.vertices.items[i + 2]};
+        float radius = 1.0f + Vector3Length(v);
+        if (radius > context->scene_radius) context->scene_radius = radius;
+    }
+
+    object_append_triangles(&streamed->object, taken.vertices.items, taken.colors.items, taken.vertices.length / 9);
+
+    free(taken.vertices.items);
+    free(taken.colors.items);
 }
 
-void set_mesh_color(Color color, Mesh *mesh) {
-    for (size_t i = 0; i < mesh->vertexCount * 4; i += 4) {
-        mesh->colors[i] = color.r;
-        mesh->colors[i + 1] = color.g;
-        mesh->colors[i + 2] = color.b;
-        mesh->colors[i + 3] = color.a;
+void upload_streamed_triangles(StreamedTriangles *streamed) {
+    size_t budget = STREAM_UPLOAD_VERTICES_PER_FRAME;
+    TRACE_BEGIN(upload, "upload stream");
+
+    // Only the new part of the vertex buffers is updated, already uploaded triangles stay untouched
+    while (budget && streamed->uploaded_vertex_count < streamed->object.vertices.length / 3) {
+        Model *model = &streamed->model;
+        if (!model->meshCount || model->meshes[model->meshCount - 1].vertexCount == STREAM_MESH_VERTICES) {
+            add_stream_mesh(model);
+        }
+        Mesh *mesh = &model->meshes[model->meshCount - 1];
+
+        size_t count = streamed->object.vertices.length / 3 - streamed->uploaded_vertex_count;
+        if (count > budget) count = budget;
+        size_t mesh_free = (size_t)(STREAM_MESH_VERTICES - mesh->vertexCount);
+        if (count > mesh_free) count = mesh_free;
+
+        UpdateMeshBuffer(*mesh, 0, &streamed->object.vertices.items[3 * streamed->uploaded_vertex_count],
+                         count * 3 * sizeof(float), mesh->vertexCount * 3 * sizeof(float));
+        UpdateMeshBuffer(*mesh, 3, &streamed->object.colors.items[4 * streamed->uploaded_vertex_count],
+                         count * 4 * sizeof(unsigned char), mesh->vertexCount * 4 * sizeof(unsigned char));
+
+        mesh->vertexCount += count;
+        mesh->triangleCount = mesh->vertexCount / 3;
+        streamed->uploaded_vertex_count += count;
+        budget -= count;
     }
+
+    // Only frames which uploaded anything are traced
+    TRACE_COUNT(upload, "vertices", STREAM_UPLOAD_VERTICES_PER_FRAME - budget);
+    if (budget < STREAM_UPLOAD_VERTICES_PER_FRAME) TRACE_END(upload);
+}
+
+void add_stream_mesh(Model *model) {
+    // Allocate the buffers for the full capacity once, only the filled vertices are drawn
+    Mesh mesh = {0};
+    mesh.vertexCount = STREAM_MESH_VERTICES;
+    mesh.vertices = (float *)MemAlloc(STREAM_MESH_VERTICES * 3 * sizeof(float));
+    mesh.colors = (unsigned char *)MemAlloc(STREAM_MESH_VERTICES * 4 * sizeof(unsigned char));
+    UploadMesh(&mesh, true);
+
+    // The streamed object keeps the triangles on the CPU side
+    MemFree(mesh.vertices);
+    MemFree(mesh.colors);
+    mesh.vertices = NULL;
+    mesh.colors = NULL;
+    mesh.vertexCount = 0;
+
+    model->meshCount++;
+    model->meshes = (Mesh *)MemRealloc(model->meshes, model->meshCount * sizeof(Mesh));
+    model->meshMaterial = (int *)MemRealloc(model->meshMaterial, model->meshCount * sizeof(int));
+    model->meshes[model->meshCount - 1] = mesh;
+    model->meshMaterial[model->meshCount - 1] = 0;
 }
 
 void draw_surface_selection(const ViewerContext *context) {
@@ -222,10 +788,19 @@ void draw_surface_selection(const ViewerContext *context) {
     DrawLine3D(context->surface_selection.point, end, RED);
 }
 
-void create_screenshot() {
+void create_screenshot(const ViewerContext *context) {
     // <CTRL> + "P" to amek a screenshot
     bool is_any_ctrl_down = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
     if (is_any_ctrl_down && IsKeyPressed(KEY_P)) {
+        // Stdin belongs to the stream, so the filename can not be asked for
+        if (context->streamed.stream && !context->streamed.stream->ring) {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "print3_%lld.png", (long long)time(NULL));
+            printf("[SCREENSHOT] Stdin is streamed, the screenshot is saved as %s.\n", filename);
+            TakeScreenshot(filename);
+            return;
+        }
+
         printf("[SCREENSHOT] Enter the filename for the screenshot (leave blank to cancel): ");
 
         char filename[2048];
@@ -267,39 +842,82 @@ void update_context(const Scene *scene, const Camera *camera, ViewerContext *con
 
     // Select normal by pressing "S"
     if (IsKeyPressed(KEY_S)) {
-        set_surface_selection(scene, camera, &context->surface_selection);
+        set_surface_selection(scene, &context->bvh_build, &context->streamed.object, camera,
+                              &context->surface_selection);
     }
 }
 
-void set_surface_selection(const Scene *scene, const Camera *camera, SurfaceSelection *surface_selection) {
+bool is_stream_pending(const StreamedTriangles *streamed) {
+    return streamed->active || streamed->uploaded_vertex_count < streamed->object.vertices.length / 3;
+}
+
+void pace_frames(ViewerContext *context, bool is_stop_requestable) {
+    // The benchmark draws as fast as it can
+    if (context->options->benchmark_path) {
+        DisableEventWaiting();
+        return;
+    }
+
+    // Received triangles have no event of their own, so the frames are polled while a stream delivers them
+    if (is_stream_pending(&context->streamed)) {
+        DisableEventWaiting();
+        SetTargetFPS(TARGET_FPS);
+        return;
+    }
+
+    // A finished level of detail build and a caller clearing should_run have no event either, they are polled.
+    // Without recent input the polled frames come at the idle rate, so an idle window stays cheap.
+    if (!context->lod_uploaded || is_stop_requestable) {
+        if (has_input()) context->last_input_time = GetTime();
+        bool is_active = GetTime() - context->last_input_time < INPUT_ACTIVE_SECONDS;
+        DisableEventWaiting();
+        SetTargetFPS(is_active ? TARGET_FPS : IDLE_FPS);
+        return;
+    }
+
+    // Idle windows sleep in EndDrawing until the next input or window event instead of redrawing the same frame
+    EnableEventWaiting();
+    SetTargetFPS(TARGET_FPS);
+}
+
+bool has_input(void) {
+    // Anything the viewer reacts to since the last frame, queued key presses are consumed but not used elsewhere
+    Vector2 mouse_delta = GetMouseDelta();
+    return mouse_delta.x || mouse_delta.y || GetMouseWheelMove() || IsMouseButtonDown(MOUSE_BUTTON_LEFT) ||
+           IsMouseButtonDown(MOUSE_BUTTON_RIGHT) || GetKeyPressed() || IsWindowResized();
+}
+
+void set_surface_selection(const Scene *scene, BvhBuild *bvh_build, const Object *streamed, const Camera *camera,
+                           SurfaceSelection *surface_selection) {
     *surface_selection = (SurfaceSelection){0};  // Reset selection
 
+    // A selection right after the start waits for the rest of the hierarchy build
+    const Bvh *bvh = bvh_build_wait(bvh_build);
+
     Vector2 pos = GetMousePosition();
     Ray ray = GetMouseRay(pos, *camera);
 
-    RayCollision nearest_collision = {0};
-    for (size_t i_obj = 0; i_obj < scene->objects.length; ++i_obj) {
-        Object obj = scene->objects.items[i_obj];
-
-        for (size_t i_ver = 0; i_ver < obj.vertices.length; i_ver += 9) {
-            Vector3 v1 = {obj.vertices.items[i_ver], obj.vertices.items[i_ver + 1], obj.vertices.items[i_ver + 2]};
-            Vector3 v2 = {obj.vertices.items[i_ver + 3], obj.vertices.items[i_ver + 4], obj.vertices.items[i_ver + 5]};
-            Vector3 v3 = {obj.vertices.items[i_ver + 6], obj.vertices.items[i_ver + 7], obj.vertices.items[i_ver + 8]};
+    BvhCollision collision = {0};
+    if (bvh_get_ray_collision(bvh, scene, ray, &collision)) {
+        surface_selection->active = true;
+        surface_selection->point = collision.collision.point;
+        surface_selection->normal = collision.collision.normal;
+        object_get_triangle(&scene->objects.items[collision.object], collision.triangle, surface_selection->vertices);
+    }
 
-            RayCollision collision = GetRayCollisionTriangle(ray, v1, v2, v3);
+    // Streamed triangles are not part of the hierarchy and come after the scene
+    for (size_t i_tri = 0; i_tri < object_triangle_count(*streamed); ++i_tri) {
+        Vector3 vertices[3];
+        object_get_triangle(streamed, i_tri, vertices);
 
-            if (!collision.hit) continue;
+        RayCollision hit = GetRayCollisionTriangle(ray, vertices[0], vertices[1], vertices[2]);
+        if (!hit.hit || (surface_selection->active && hit.distance >= collision.collision.distance)) continue;
 
-            if (!nearest_collision.hit || collision.distance < nearest_collision.distance) {
-                nearest_collision = collision;
-                surface_selection->active = true;
-                surface_selection->point = collision.point;
-                surface_selection->normal = collision.normal;
-                surface_selection->vertices[0] = v1;
-                surface_selection->vertices[1] = v2;
-                surface_selection->vertices[2] = v3;
-            }
-        }
+        collision.collision = hit;
+        surface_selection->active = true;
+        surface_selection->point = hit.point;
+        surface_selection->normal = hit.normal;
+        memcpy(surface_selection->vertices, vertices, sizeof(vertices));
     }
 }
 
@@ -318,55 +936,16 @@ void reset_camera(const ViewerContext *context, Camera *camera) {
 void update_camera(const ViewerContext *context, Camera *camera) {
     // Rotate via left mouse button down + drag
     if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
-        Vector2 mouse_delta = GetMouseDelta();
-
-        // Transform camera orientation representation from (pos, tar, up) -> (view, up, right)
-        Vector3 view = Vector3Subtract(camera->target, camera->position);
-        Vector3 up = camera->up;
-        Vector3 right = Vector3CrossProduct(view, up);
-
-        // Handle up - down (rotation along right)
-        float up_down_angle = -ROTATION_SENSITIVITY * mouse_delta.y;
-        view = Vector3RotateByAxisAngle(view, right, up_down_angle);
-        up = Vector3RotateByAxisAngle(up, right, up_down_angle);
-
-        // Handle left - right (rotation along up)
-        float left_right_angle = -ROTATION_SENSITIVITY * mouse_delta.x;
-        view = Vector3RotateByAxisAngle(view, up, left_right_angle);
-
-        // Transform back while keeping target fixed
-        camera->up = up;
-        camera->position = Vector3Subtract(camera->target, view);
+        rotate_camera(GetMouseDelta(), camera);
     }
 
     // Pan via right mouse down + drag
     if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
-        Vector2 mouse_delta = GetMouseDelta();
-
-        // Get unit vectors along the cameras up and right direction
-        Vector3 view = Vector3Subtract(camera->target, camera->position);
-        Vector3 up_unit = Vector3Normalize(camera->up);
-        Vector3 right_unit = Vector3Normalize(Vector3CrossProduct(view, up_unit));
-
-        // Get relative pan vectors
-        float pan_factor = PAN_SENEITIVITY * camera->fovy / GetScreenWidth();
-        float up_distance = pan_factor * mouse_delta.y;
-        Vector3 up_pan = Vector3Scale(up_unit, up_distance);
-
-        float right_distance = -pan_factor * mouse_delta.x;
-        Vector3 right_pan = Vector3Scale(right_unit, right_distance);
-
-        Vector3 pan = Vector3Add(up_pan, right_pan);
-
-        // Apply pan tranlation to camera position and target
-        camera->position = Vector3Add(camera->position, pan);
-        camera->target = Vector3Add(camera->target, pan);
+        pan_camera(GetMouseDelta(), camera);
     }
 
     // Zooming via mouse wheel
-    float mouse_wheel_move = GetMouseWheelMove();
-    float zoom_factor = powf(1.0f + ZOOM_SENSITIVITY, mouse_wheel_move);
-    camera->fovy *= zoom_factor;
+    zoom_camera(GetMouseWheelMove(), camera);
 
     // Reset camera via pressing "R"
     if (IsKeyPressed(KEY_R)) {
@@ -404,6 +983,141 @@ void update_camera(const ViewerContext *context, Camera *camera) {
     }
 }
 
+void rotate_camera(Vector2 mouse_delta, Camera *camera) {
+    // Transform camera orientation representation from (pos, tar, up) -> (view, up, right)
+    Vector3 view = Vector3Subtract(camera->target, camera->position);
+    Vector3 up = camera->up;
+    Vector3 right = Vector3CrossProduct(view, up);
+
+    // Handle up - down (rotation along right)
+    float up_down_angle = -ROTATION_SENSITIVITY * mouse_delta.y;
+    view = Vector3RotateByAxisAngle(view, right, up_down_angle);
+    up = Vector3RotateByAxisAngle(up, right, up_down_angle);
+
+    // Handle left - right (rotation along up)
+    float left_right_angle = -ROTATION_SENSITIVITY * mouse_delta.x;
+    view = Vector3RotateByAxisAngle(view, up, left_right_angle);
+
+    // Transform back while keeping target fixed
+    camera->up = up;
+    camera->position = Vector3Subtract(camera->target, view);
+}
+
+void pan_camera(Vector2 mouse_delta, Camera *camera) {
+    // Get unit vectors along the cameras up and right direction
+    Vector3 view = Vector3Subtract(camera->target, camera->position);
+    Vector3 up_unit = Vector3Normalize(camera->up);
+    Vector3 right_unit = Vector3Normalize(Vector3CrossProduct(view, up_unit));
+
+    // Get relative pan vectors
+    float pan_factor = PAN_SENEITIVITY * camera->fovy / GetScreenWidth();
+    float up_distance = pan_factor * mouse_delta.y;
+    Vector3 up_pan = Vector3Scale(up_unit, up_distance);
+
+    float right_distance = -pan_factor * mouse_delta.x;
+    Vector3 right_pan = Vector3Scale(right_unit, right_distance);
+
+    Vector3 pan = Vector3Add(up_pan, right_pan);
+
+    // Apply pan tranlation to camera position and target
+    camera->position = Vector3Add(camera->position, pan);
+    camera->target = Vector3Add(camera->target, pan);
+}
+
+void zoom_camera(float mouse_wheel_move, Camera *camera) {
+    float zoom_factor = powf(1.0f + ZOOM_SENSITIVITY, mouse_wheel_move);
+    camera->fovy *= zoom_factor;
+}
+
+// ****************************************************************************
+// Benchmark
+// ****************************************************************************
+
+void update_benchmark_camera(size_t frame, Camera *camera) {
+    if (frame < BENCHMARK_WARMUP_FRAMES) return;
+
+    // Every phase returns the camera to where it started, using the math of the mouse controls
+    size_t phase = (frame - BENCHMARK_WARMUP_FRAMES) / BENCHMARK_PHASE_FRAMES;
+    size_t step = (frame - BENCHMARK_WARMUP_FRAMES) % BENCHMARK_PHASE_FRAMES;
+
+    if (phase == 0) {
+        // Orbit once around the up axis
+        float angle = 2.0f * PI / BENCHMARK_PHASE_FRAMES;
+        rotate_camera((Vector2){-angle / ROTATION_SENSITIVITY, 0.0f}, camera);
+    } else if (phase == 1) {
+        // Zoom in during the first half and out again during the second
+        float wheel_move = logf(BENCHMARK_ZOOM_FACTOR) / logf(1.0f + ZOOM_SENSITIVITY) / (BENCHMARK_PHASE_FRAMES / 2);
+        zoom_camera(step < BENCHMARK_PHASE_FRAMES / 2 ? -wheel_move : wheel_move, camera);
+    } else {
+        // Pan along a circle
+        float angle = 2.0f * PI * step / BENCHMARK_PHASE_FRAMES;
+        Vector2 delta = {cosf(angle) * BENCHMARK_PAN_PIXELS_PER_FRAME, sinf(angle) * BENCHMARK_PAN_PIXELS_PER_FRAME};
+        pan_camera(delta, camera);
+    }
+}
+
+bool record_benchmark_frame(Benchmark *benchmark, double cpu_seconds, double total_seconds) {
+    // Frames of the warmup upload buffers and compile shaders, they are not representative
+    if (benchmark->frame >= BENCHMARK_WARMUP_FRAMES) {
+        da_add(benchmark->cpu, cpu_seconds);
+        da_add(benchmark->total, total_seconds);
+    }
+
+    return ++benchmark->frame < BENCHMARK_FRAME_COUNT;
+}
+
+void write_benchmark_report(const char *path, const Benchmark *benchmark) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "[ERR] Could not open the benchmark report \"%s\" for writing.\n", path);
+        return;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"frames\": %zu,\n", benchmark->total.length);
+    fprintf(file, "  \"width\": %d,\n", GetScreenWidth());
+    fprintf(file, "  \"height\": %d,\n", GetScreenHeight());
+    write_percentiles(file, "cpu", &benchmark->cpu);
+    fprintf(file, ",\n");
+    write_percentiles(file, "total", &benchmark->total);
+    fprintf(file, "\n}\n");
+    fclose(file);
+
+    printf("[INFO] Wrote the frame times of %zu frames to %s.\n", benchmark->total.length, path);
+}
+
+void write_percentiles(FILE *file, const char *name, const FrameTimes *times) {
+    FrameTimes sorted = {0};
+    double sum = 0.0;
+    for (size_t i = 0; i < times->length; ++i) {
+        da_add(sorted, times->items[i]);
+        sum += times->items[i];
+    }
+    qsort(sorted.items, sorted.length, sizeof(sorted.items[0]), compare_seconds);
+
+    // Nearest rank percentiles in milliseconds
+    double percentiles[3] = {0.50, 0.95, 0.99};
+    double values[3] = {0};
+    for (size_t i = 0; i < 3 && sorted.length; ++i) {
+        size_t rank = (size_t)ceil(percentiles[i] * sorted.length);
+        values[i] = 1e3 * sorted.items[rank ? rank - 1 : 0];
+    }
+    double mean = sorted.length ? 1e3 * sum / sorted.length : 0.0;
+
+    fprintf(file, "  \"%s_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f}", name, mean, values[0],
+            values[1], values[2]);
+    printf("[INFO] %-5s mean %8.3f ms, p50 %8.3f ms, p95 %8.3f ms, p99 %8.3f ms\n", name, mean, values[0], values[1],
+           values[2]);
+
+    free(sorted.items);
+}
+
+int compare_seconds(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
 // ****************************************************************************
 // HUD
 // ****************************************************************************
@@ -458,9 +1172,18 @@ void draw_arrow(Vector3 start, Vector3 dir_normalized, float line_length, float
     DrawCylinderEx(mid, tip, tip_radius, 0.0, sides, color);             // Tip
 }
 
-void render_cos_view(const ViewerContext *context, Camera *camera, RenderTexture *cos_view) {
+void render_cos_view(const ViewerContext *context, const Camera *camera, CosView *cos_view) {
     if (!context->display_cos) return;
 
+    // Panning and zooming keep the orientation, the arrows only change when the camera rotates
+    Vector3 direction = Vector3Normalize(Vector3Subtract(camera->position, camera->target));
+    bool is_same_orientation = Vector3Equals(direction, cos_view->direction) && Vector3Equals(camera->up, cos_view->up);
+    if (cos_view->rendered && is_same_orientation) return;
+
+    cos_view->rendered = true;
+    cos_view->direction = direction;
+    cos_view->up = camera->up;
+
     // Options of the arrow geometries
     int sides = 10;
     float line_length = 1.0;
@@ -471,12 +1194,12 @@ void render_cos_view(const ViewerContext *context, Camera *camera, RenderTexture
 
     // Use camera with same orientation but fixed target and fov
     Camera view_camera = {0};
-    view_camera.position = Vector3Scale(Vector3Normalize(Vector3Subtract(camera->position, camera->target)), 3.0);
+    view_camera.position = Vector3Scale(direction, 3.0);
     view_camera.up = camera->up;
     view_camera.fovy = 4.0f;
     view_camera.projection = CAMERA_ORTHOGRAPHIC;
 
-    BeginTextureMode(*cos_view);
+    BeginTextureMode(cos_view->texture);
 
     // Set transparent background
     ClearBackground((Color){0, 0, 0, 0});
@@ -493,14 +1216,16 @@ void render_cos_view(const ViewerContext *context, Camera *camera, RenderTexture
     EndTextureMode();
 }
 
-void draw_rendered_cos_view(const ViewerContext *context, const RenderTexture *cos_view) {
+void draw_rendered_cos_view(const ViewerContext *context, const CosView *cos_view) {
     if (!context->display_cos) return;
 
+    const Texture *texture = &cos_view->texture.texture;
+
     // Draw the texture in the bottom left corner
-    Vector2 position = {0, GetScreenHeight() - cos_view->texture.height};
+    Vector2 position = {0, GetScreenHeight() - texture->height};
 
     // Build the flipped rectangle of the cos view for drawing
-    Rectangle source = {0, 0, cos_view->texture.width, -cos_view->texture.height};
+    Rectangle source = {0, 0, texture->width, -texture->height};
 
-    DrawTextureRec(cos_view->texture, source, position, WHITE);
+    DrawTextureRec(*texture, source, position, WHITE);
 }
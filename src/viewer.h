@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 
+#include "deserialize/stdin.h"
 #include "scene.h"
 
 typedef struct ViewerOptions {
@@ -13,8 +14,15 @@ typedef struct ViewerOptions {
     Color background;
     bool render_facets_both_sides;
     Color edge_color;
+    const char *benchmark_path;  // Replay a camera path and write the frame times to this file, NULL if interactive
 } ViewerOptions;
 
-void viewer_run(const ViewerOptions *options, const Scene *scene, const bool *should_run);
+// Options of a viewer without command line arguments
+ViewerOptions viewer_get_default_options(void);
+
+// Triangles of the stream are added to the scene while the viewer is running, stream may be NULL.
+// The viewer runs until its window is closed or the caller clears should_run, which may be NULL if it never does.
+// Idle viewers only redraw on input and window events, with should_run they wake up 10 times per second to check it.
+void viewer_run(const ViewerOptions *options, const Scene *scene, StdinStream *stream, const bool *should_run);
 
 #endif